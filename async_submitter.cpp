@@ -0,0 +1,241 @@
+/*  AsyncSubmitter: I/O thread that submits queued requests through a NetworkManager.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "async_submitter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rclient{
+
+  /** Constructor starts the I/O thread
+   * Throws runtime_error if the thread cannot be created
+   * @param[in] netman NetworkManager to submit requests through. Must outlive the AsyncSubmitter
+   * @param[in] netMutex Mutex held by the I/O thread while it uses netman
+   */
+  AsyncSubmitter::AsyncSubmitter(NetworkManager &netman, Mutex &netMutex):m_NetMan(netman), m_netMutex(netMutex),
+    m_iMaxInFlight(std::max(netman.getOptions().maxInFlight, 1)), m_pHead(NULL), m_bStopping(false){
+    if(pthread_create(&m_thread, NULL, &AsyncSubmitter::run, this) != 0)
+      throw std::runtime_error("ERROR:: Failed to start asynchronous I/O thread.");
+  }
+
+  /** Destructor waits for the queued requests to complete, then stops the I/O thread
+   */
+  AsyncSubmitter::~AsyncSubmitter(){
+    {
+      ScopedLock lock(m_mutex);
+      m_bStopping = true;
+      m_wakeup.signal();
+    }
+    pthread_join(m_thread, NULL);
+  }
+
+
+  /** Queues a request to be sent to Rserve by the I/O thread
+   * @param[in] packet request to send. Must not be modified until the request completes
+   * @param[in] callback notified on the I/O thread when the request completes. May be null
+   * @param[in] handler receives the REXPs in the response on the I/O thread, which are then left out of the response.
+   *  May be null. Must stay valid until the request completes, and only throw exceptions derived from std::exception
+   * @return future that receives the response
+   */
+  RSHARED_PTR<RFuture> AsyncSubmitter::submit(const RSHARED_PTR<RPacket> &packet, const RSHARED_PTR<RCallback> &callback, REXPHandler *handler){
+    Request *request = new Request;
+    request->packet = packet;
+    request->handler = handler;
+    request->future = RMAKE_SHARED<RFuture>(callback);
+    RSHARED_PTR<RFuture> future = request->future;
+    push(request);
+    return future;
+  }
+
+
+  /** Pushes a request onto the submission queue. Only wakes the I/O thread if the queue was empty
+   * @param[in] request request to push, owned by the queue
+   */
+  void AsyncSubmitter::push(Request *request){
+    Request *old_head;
+#if defined(__GNUC__)
+    do{
+      old_head = m_pHead;
+      request->next = old_head;
+    } while(!__sync_bool_compare_and_swap(&m_pHead, old_head, request));
+#else
+    {
+      ScopedLock lock(m_mutex);
+      old_head = m_pHead;
+      request->next = old_head;
+      m_pHead = request;
+    }
+#endif
+    if(old_head == NULL){
+      ScopedLock lock(m_mutex);
+      m_wakeup.signal();
+    }
+  }
+
+  /** Removes every request from the submission queue
+   * @return queued requests, oldest first
+   */
+  AsyncSubmitter::Request* AsyncSubmitter::takeAll(){
+    Request *list;
+#if defined(__GNUC__)
+    list = __sync_lock_test_and_set(&m_pHead, (Request*) NULL);
+#else
+    {
+      ScopedLock lock(m_mutex);
+      list = m_pHead;
+      m_pHead = NULL;
+    }
+#endif
+    // queue is newest first, reverse it to keep submission order
+    Request *ordered = NULL;
+    while(list){
+      Request *next = list->next;
+      list->next = ordered;
+      ordered = list;
+      list = next;
+    }
+    return ordered;
+  }
+
+
+  /** Entry point for the I/O thread
+   * @param[in] submitter AsyncSubmitter that owns the thread
+   */
+  void* AsyncSubmitter::run(void *submitter){
+    static_cast<AsyncSubmitter*>(submitter)->process();
+    return NULL;
+  }
+
+  /** Submits queued requests until the AsyncSubmitter is stopping and the queue is empty
+   * Up to m_iMaxInFlight requests are sent before their responses are read. Rserve answers in order,
+   * so responses are matched to the in-flight requests oldest first.
+   */
+  void AsyncSubmitter::process(){
+    while(true){
+      {
+        ScopedLock lock(m_mutex);
+        while(m_pHead == NULL && !m_bStopping)
+          m_wakeup.wait(m_mutex);
+        if(m_pHead == NULL)
+          return;
+      }
+
+      ScopedLock lock(m_netMutex);
+      Request *pending = takeAll(); // requests not yet sent, oldest first
+      Request *inFlight = NULL; // requests awaiting their response, oldest first
+      Request *inFlightTail = NULL;
+      size_t inFlightCount = 0;
+
+      while(pending || inFlight){
+        if(pending && inFlightCount < m_iMaxInFlight){
+          // send the next request
+          Request *request = pending;
+          pending = request->next;
+          request->next = NULL;
+          try{
+            m_NetMan.sendRequest(*request->packet);
+          }
+          catch(const NetworkError &e){
+            // connection was dropped, so responses to requests already in flight are lost too
+            fail(inFlight, e);
+            fail(request, e);
+            inFlight = inFlightTail = NULL;
+            inFlightCount = 0;
+            continue;
+          }
+          catch(const std::exception &e){
+            // the request may be partly sent, so the connection cannot be used for the requests that follow
+            m_NetMan.disconnect();
+            fail(inFlight, e.what());
+            fail(request, e.what());
+            inFlight = inFlightTail = NULL;
+            inFlightCount = 0;
+            continue;
+          }
+          if(inFlightTail)
+            inFlightTail->next = request;
+          else
+            inFlight = request;
+          inFlightTail = request;
+          ++inFlightCount;
+
+          // keep the pipeline full with requests submitted in the meantime
+          if(!pending)
+            pending = takeAll();
+          continue;
+        }
+
+        // read the response to the oldest request in flight
+        Request *request = inFlight;
+        RSHARED_PTR<const RPacket> response;
+        try{
+          if(request->handler)
+            response = m_NetMan.receiveResponse(*request->handler);
+          else
+            response = m_NetMan.receiveResponse();
+        }
+        catch(const NetworkError &e){
+          fail(inFlight, e);
+          inFlight = inFlightTail = NULL;
+          inFlightCount = 0;
+          continue;
+        }
+        catch(const std::exception &e){
+          // the rest of the response may be unread, so the responses that follow cannot be matched to their requests
+          m_NetMan.disconnect();
+          fail(inFlight, e.what());
+          inFlight = inFlightTail = NULL;
+          inFlightCount = 0;
+          continue;
+        }
+        inFlight = request->next;
+        if(!inFlight)
+          inFlightTail = NULL;
+        --inFlightCount;
+        request->future->setResponse(response);
+        delete request;
+      }
+    }
+  }
+
+  /** Completes a list of requests with the given network error and deletes them
+   * @param[in] list requests to fail, linked by next. May be null
+   * @param[in] error error to report to each request
+   */
+  void AsyncSubmitter::fail(Request *list, const NetworkError &error){
+    while(list){
+      Request *next = list->next;
+      list->future->setError(error);
+      delete list;
+      list = next;
+    }
+  }
+
+  /** Completes a list of requests with the given error message and deletes them
+   * @param[in] list requests to fail, linked by next. May be null
+   * @param[in] error message to report to each request
+   */
+  void AsyncSubmitter::fail(Request *list, const RSTRINGTYPE &error){
+    while(list){
+      Request *next = list->next;
+      list->future->setError(error);
+      delete list;
+      list = next;
+    }
+  }
+
+} // close namespace
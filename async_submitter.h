@@ -0,0 +1,77 @@
+/*  AsyncSubmitter: I/O thread that submits queued requests through a NetworkManager.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_ASYNC_SUBMITTER_H_INCLUDED
+#define RCLIENT_ASYNC_SUBMITTER_H_INCLUDED
+
+#include "config.h"
+#include "network_manager.h"
+#include "rfuture.h"
+#include "rexp_handler.h"
+#include "thread_sync.h"
+
+namespace rclient{
+
+  /** Owns a dedicated I/O thread for one NetworkManager.
+   * Any thread may submit requests; they are pushed onto a lock-free queue and sent to Rserve in submission order.
+   * Up to ConnectionOptions::maxInFlight requests are pipelined on the connection, and each gets its own response.
+   * The I/O thread holds netMutex while it uses the NetworkManager, so the owner can lock it to use the
+   * NetworkManager directly between requests.
+   * The destructor completes every queued request before it returns.
+   */
+  class RCLIENT_API AsyncSubmitter{
+
+  public:
+    AsyncSubmitter(NetworkManager &netman, Mutex &netMutex);
+    ~AsyncSubmitter();
+
+    RSHARED_PTR<RFuture> submit(const RSHARED_PTR<RPacket> &packet, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>(),
+                                REXPHandler *handler = NULL);
+
+  private:
+    AsyncSubmitter(const AsyncSubmitter &no_copy); // non construction-copyable
+    AsyncSubmitter& operator=(const AsyncSubmitter&); // non-copyable
+
+    /** queued request, linked into the submission queue
+     */
+    struct Request{
+      RSHARED_PTR<RPacket> packet;
+      RSHARED_PTR<RFuture> future;
+      REXPHandler *handler; // decodes the REXPs in the response if set
+      Request *next;
+    };
+
+    static void* run(void *submitter);
+    void process();
+    void push(Request *request);
+    Request* takeAll();
+    static void fail(Request *list, const NetworkError &error);
+    static void fail(Request *list, const RSTRINGTYPE &error);
+
+    NetworkManager &m_NetMan; // connection the requests are submitted through
+    Mutex &m_netMutex; // held while m_NetMan is in use
+    const size_t m_iMaxInFlight; // requests sent ahead of their responses
+
+    Request * volatile m_pHead; // submission queue, most recent request first
+    Mutex m_mutex; // guards m_bStopping, and sleeping/waking the I/O thread
+    Condition m_wakeup; // signalled when the queue becomes non-empty or on shutdown
+    bool m_bStopping;
+    pthread_t m_thread;
+  };
+
+} // close namespace
+
+#endif
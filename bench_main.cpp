@@ -0,0 +1,448 @@
+/*  rclient_bench: Microbenchmarks for encoding, decoding and NA translation of every REXP type.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h> // for gettimeofday
+
+#include "endian_converter.h"
+#include "rarena.h"
+#include "rexp_class_hierarchy.h"
+#include "rpacket.h"
+
+using namespace std;
+using namespace rclient;
+
+// allocations made through operator new, counted to report allocations per operation
+static size_t g_allocations = 0;
+
+void* operator new(size_t size){
+  ++g_allocations;
+  void *p = malloc(size ? size : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size){
+  ++g_allocations;
+  void *p = malloc(size ? size : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) throw(){
+  free(p);
+}
+
+void operator delete[](void *p) throw(){
+  free(p);
+}
+
+// benchmarks write their results here so the compiler cannot drop the work
+static volatile size_t g_sink = 0;
+
+// every string and list element is a separate allocation, so their sweeps stop early to stay within memory
+static const size_t StringMax = 10000000;
+static const size_t ListMax = 1000000;
+
+/** Work to time: an operation on n elements, repeated by the Runner
+ */
+class Benchmark{
+public:
+  virtual ~Benchmark(){}
+  virtual void run() = 0; // performs the operation once
+  virtual size_t bytes() const = 0; // bytes processed by one operation, in the network encoding
+};
+
+/** @return seconds since an arbitrary start
+ */
+double now(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/** Times benchmarks and prints one line per benchmark
+ */
+class Runner{
+public:
+  Runner(const string &filter, const double minSeconds):m_sFilter(filter), m_dMinSeconds(minSeconds){}
+
+  /** @param[in] name name of the benchmark
+   * @return whether the benchmark was selected on the command line
+   */
+  bool selected(const string &name) const{
+    return m_sFilter.empty() || name.find(m_sFilter) != string::npos;
+  }
+
+  /** Runs a benchmark until it has taken at least the minimum time, and prints its rate
+   * @param[in] name name of the benchmark
+   * @param[in] n number of elements processed by one operation
+   * @param[in] benchmark benchmark to run
+   */
+  void time(const string &name, const size_t n, Benchmark &benchmark){
+    if(!selected(name)) return;
+    benchmark.run(); // warm up caches and let vectors reach their size
+
+    size_t iterations = 0;
+    size_t allocations = g_allocations;
+    const double start = now();
+    double elapsed = 0;
+    do{
+      benchmark.run();
+      ++iterations;
+      elapsed = now() - start;
+    } while(elapsed < m_dMinSeconds);
+    allocations = g_allocations - allocations;
+
+    cout << left << setw(22) << name << right << setw(11) << n << setw(10) << iterations
+         << fixed << setprecision(2) << setw(12) << elapsed * 1e9 / ((double) iterations * n)
+         << setw(12) << benchmark.bytes() * iterations / elapsed / 1e6
+         << setw(12) << (double) allocations / iterations << endl;
+  }
+
+  /** prints the column headings
+   */
+  void printHeader() const{
+    cout << left << setw(22) << "benchmark" << right << setw(11) << "elements" << setw(10) << "runs"
+         << setw(12) << "ns/element" << setw(12) << "MB/s" << setw(12) << "allocs/run" << endl;
+  }
+
+private:
+  const string m_sFilter; // substring of the benchmarks to run, empty for all
+  const double m_dMinSeconds; // time each benchmark runs for
+};
+
+
+/** Serializes an REXP into a packet entry, as RClient does for assignAsync
+ */
+class Encode : public Benchmark{
+public:
+  explicit Encode(const REXP &rexp):m_rexp(rexp), m_iBytes(RPacket::PacketEntry(rexp).getLength()){}
+  void run(){
+    RPacket::PacketEntry entry(m_rexp);
+    g_sink += entry.getLength();
+  }
+  size_t bytes() const{ return m_iBytes; }
+private:
+  const REXP &m_rexp;
+  const size_t m_iBytes;
+};
+
+/** Parses a packet entry into an REXP, as RClient does for eval, optionally allocating the REXPs from a new RArena
+ */
+class Decode : public Benchmark{
+public:
+  Decode(const RPacket::PacketEntry &entry, const bool arena):m_entry(entry), m_bArena(arena){}
+  void run(){
+    RSHARED_PTR<const REXP> rexp = m_entry.toREXP(m_bArena ? RArena::create() : RSHARED_PTR<RArena>());
+    g_sink += rexp->getType();
+  }
+  size_t bytes() const{ return m_entry.getLength(); }
+private:
+  const RPacket::PacketEntry &m_entry;
+  const bool m_bArena;
+};
+
+/** Builds an REXP vector from consumer values, translating the consumer NA value to R's
+ */
+template<typename T_REXP, typename T_VAL>
+class Init : public Benchmark{
+public:
+  Init(const RVECTORTYPE<T_VAL> &vals, const T_VAL &na, const size_t bytes):m_vals(vals), m_na(na), m_iBytes(bytes){}
+  void run(){
+    T_REXP rexp(m_vals, m_na);
+    g_sink += rexp.length();
+  }
+  size_t bytes() const{ return m_iBytes; }
+private:
+  const RVECTORTYPE<T_VAL> &m_vals;
+  const T_VAL m_na;
+  const size_t m_iBytes;
+};
+
+/** Copies the values out of an REXP vector with getData, translating R's NA value to the consumer's
+ */
+template<typename T_REXP, typename T_VAL>
+class GetData : public Benchmark{
+public:
+  GetData(const T_REXP &rexp, const T_VAL &na, const size_t bytes):m_rexp(rexp), m_na(na), m_iBytes(bytes){}
+  void run(){
+    RVECTORTYPE<T_VAL> vals = m_rexp.getData(m_na);
+    g_sink += vals.size();
+  }
+  size_t bytes() const{ return m_iBytes; }
+private:
+  const T_REXP &m_rexp;
+  const T_VAL m_na;
+  const size_t m_iBytes;
+};
+
+/** Copies the values out of an REXP vector with fillData into a buffer that is reused between runs
+ */
+template<typename T_REXP, typename T_VAL>
+class FillData : public Benchmark{
+public:
+  FillData(const T_REXP &rexp, const T_VAL &na, const size_t bytes):m_rexp(rexp), m_na(na), m_iBytes(bytes){}
+  void run(){
+    m_rexp.fillData(m_buf, m_na);
+    g_sink += m_buf.size();
+  }
+  size_t bytes() const{ return m_iBytes; }
+private:
+  const T_REXP &m_rexp;
+  const T_VAL m_na;
+  const size_t m_iBytes;
+  RVECTORTYPE<T_VAL> m_buf;
+};
+
+/** Writes integers into a little-endian buffer one at a time with EndianConverter::serialize
+ */
+class Serialize : public Benchmark{
+public:
+  explicit Serialize(const size_t n):m_buf(n * sizeof(uint32_t)), m_iCount(n){}
+  void run(){
+    size_t pos = 0;
+    for(size_t i = 0; i < m_iCount; ++i)
+      m_converter.serialize<uint32_t>(m_buf, pos, (uint32_t) i);
+    g_sink += pos;
+  }
+  size_t bytes() const{ return m_buf.size(); }
+private:
+  EndianConverter m_converter;
+  RVECTORTYPE<uint8_t> m_buf;
+  const size_t m_iCount;
+};
+
+/** Reads integers from a little-endian buffer one at a time with EndianConverter::deserialize
+ */
+class Deserialize : public Benchmark{
+public:
+  explicit Deserialize(const size_t n):m_buf(n * sizeof(uint32_t), 1), m_iCount(n){}
+  void run(){
+    size_t pos = 0;
+    uint32_t sum = 0;
+    for(size_t i = 0; i < m_iCount; ++i)
+      sum += m_converter.deserialize<uint32_t>(m_buf, pos);
+    g_sink += sum;
+  }
+  size_t bytes() const{ return m_buf.size(); }
+private:
+  EndianConverter m_converter;
+  RVECTORTYPE<uint8_t> m_buf;
+  const size_t m_iCount;
+};
+
+/** Converts a vector of doubles to little-endian with EndianConverter::swap_endian
+ */
+class SwapDoubles : public Benchmark{
+public:
+  explicit SwapDoubles(const size_t n):m_vals(n, 1.5){}
+  void run(){
+    RVECTORTYPE<double> swapped = m_converter.swap_endian(m_vals);
+    g_sink += swapped.size();
+  }
+  size_t bytes() const{ return m_vals.size() * sizeof(double); }
+private:
+  EndianConverter m_converter;
+  RVECTORTYPE<double> m_vals;
+};
+
+
+/** Runs the encode and decode benchmarks of an REXP
+ * @param[in] runner times the benchmarks
+ * @param[in] prefix name of the REXP type
+ * @param[in] n number of elements in rexp
+ * @param[in] rexp value to encode and decode
+ */
+void runCodec(Runner &runner, const string &prefix, const size_t n, const REXP &rexp){
+  if(runner.selected(prefix + "_encode")){
+    Encode encode(rexp);
+    runner.time(prefix + "_encode", n, encode);
+  }
+  if(runner.selected(prefix + "_decode")){
+    RPacket::PacketEntry entry(rexp);
+    Decode decode(entry, false);
+    runner.time(prefix + "_decode", n, decode);
+  }
+  if(runner.selected(prefix + "_decode_arena")){
+    RPacket::PacketEntry entry(rexp);
+    Decode decode(entry, true);
+    runner.time(prefix + "_decode_arena", n, decode);
+  }
+}
+
+/** Runs the benchmarks of a numeric vector type, with one NA in every 100 values
+ * @param[in] runner times the benchmarks
+ * @param[in] prefix name of the REXP type
+ * @param[in] n number of elements
+ */
+template<typename T_REXP, typename T_VAL>
+void runNumeric(Runner &runner, const string &prefix, const size_t n){
+  const string names[] = {"_init", "_encode", "_decode", "_decode_arena", "_getData", "_fillData"};
+  bool any = false;
+  for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    any = any || runner.selected(prefix + names[i]);
+  if(!any) return;
+
+  const T_VAL na = (T_VAL) -999;
+  const size_t bytes = n * sizeof(T_VAL);
+  RSHARED_PTR<T_REXP> rexp;
+  {
+    RVECTORTYPE<T_VAL> vals(n);
+    for(size_t i = 0; i < n; ++i)
+      vals[i] = (i % 100 == 99 ? na : (T_VAL) i);
+    Init<T_REXP, T_VAL> init(vals, na, bytes);
+    runner.time(prefix + "_init", n, init);
+    rexp = RMAKE_SHARED<T_REXP>(vals, na);
+  }
+  runCodec(runner, prefix, n, *rexp);
+  GetData<T_REXP, T_VAL> getData(*rexp, na, bytes);
+  runner.time(prefix + "_getData", n, getData);
+  FillData<T_REXP, T_VAL> fillData(*rexp, na, bytes);
+  runner.time(prefix + "_fillData", n, fillData);
+}
+
+/** Runs the benchmarks of REXPString, with one NA in every 100 strings
+ * @param[in] runner times the benchmarks
+ * @param[in] n number of strings
+ */
+void runString(Runner &runner, const size_t n){
+  if(!runner.selected("string_")) return;
+  const RSTRINGTYPE na = "NA";
+  RSHARED_PTR<REXPString> rexp;
+  size_t bytes = 0;
+  {
+    RVECTORTYPE<RSTRINGTYPE> vals(n);
+    for(size_t i = 0; i < n; ++i){
+      ostringstream str;
+      str << "value" << i;
+      vals[i] = (i % 100 == 99 ? na : str.str());
+      bytes += vals[i].size() + 1;
+    }
+    Init<REXPString, RSTRINGTYPE> init(vals, na, bytes);
+    runner.time("string_init", n, init);
+    rexp = RMAKE_SHARED<REXPString>(vals, na);
+  }
+  runCodec(runner, "string", n, *rexp);
+  GetData<REXPString, RSTRINGTYPE> getData(*rexp, na, bytes);
+  runner.time("string_getData", n, getData);
+  FillData<REXPString, RSTRINGTYPE> fillData(*rexp, na, bytes);
+  runner.time("string_fillData", n, fillData);
+}
+
+/** Runs the benchmarks of REXPList and REXPPairList holding n single integers, as in a data frame row
+ * @param[in] runner times the benchmarks
+ * @param[in] n number of list elements
+ */
+void runLists(Runner &runner, const size_t n){
+  if(!runner.selected("list_") && !runner.selected("pairlist_")) return;
+  REXPList::RVector values(n);
+  REXPPairList::RPairVector pairs(n);
+  for(size_t i = 0; i < n; ++i){
+    values[i] = RMAKE_SHARED<REXPInteger>((int32_t) i);
+    ostringstream tag;
+    tag << "col" << i;
+    pairs[i] = REXPPairList::RPair(values[i], tag.str());
+  }
+  if(runner.selected("list_")){
+    REXPList list(values);
+    runCodec(runner, "list", n, list);
+  }
+  if(runner.selected("pairlist_")){
+    REXPPairList pairlist(pairs);
+    runCodec(runner, "pairlist", n, pairlist);
+  }
+}
+
+/** Runs the EndianConverter benchmarks
+ * @param[in] runner times the benchmarks
+ * @param[in] n number of values
+ */
+void runEndian(Runner &runner, const size_t n){
+  if(runner.selected("endian_serialize")){
+    Serialize serialize(n);
+    runner.time("endian_serialize", n, serialize);
+  }
+  if(runner.selected("endian_deserialize")){
+    Deserialize deserialize(n);
+    runner.time("endian_deserialize", n, deserialize);
+  }
+  if(runner.selected("endian_swap_doubles")){
+    SwapDoubles swap(n);
+    runner.time("endian_swap_doubles", n, swap);
+  }
+}
+
+/** prints the command line options
+ * @param[in] name name the program was run as
+ */
+void printUsage(const char *name){
+  cerr << "usage: " << name << " [-m max] [-b benchmark] [-t seconds]" << endl
+       << "  -m  largest number of elements, default 100000000. Sizes go up from 1 by factors of 10" << endl
+       << "      the largest sizes need several GB of memory. Strings stop at 10000000 elements and lists at 1000000" << endl
+       << "  -b  only run benchmarks whose name contains this string, e.g. double_ or _decode" << endl
+       << "  -t  minimum time to run each benchmark for, default 0.2 seconds" << endl;
+}
+
+int main(int argc, char **argv){
+  size_t max = 100000000;
+  string filter;
+  double seconds = 0.2;
+
+  int option;
+  while((option = getopt(argc, argv, "m:b:t:h")) != -1){
+    switch(option){
+    case 'm':
+      max = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      filter = optarg;
+      break;
+    case 't':
+      seconds = atof(optarg);
+      break;
+    default:
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  Runner runner(filter, seconds);
+  runner.printHeader();
+  try{
+    for(size_t n = 1; n <= max; n *= 10){
+      runNumeric<REXPDouble, double>(runner, "double", n);
+      runNumeric<REXPInteger, int32_t>(runner, "integer", n);
+      if(n <= StringMax)
+        runString(runner, n);
+      if(n <= ListMax)
+        runLists(runner, n);
+      runEndian(runner, n);
+    }
+  }
+  catch(const std::exception &e){
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
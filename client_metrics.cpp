@@ -0,0 +1,183 @@
+/*  ClientMetrics: Lock-free counters and latency histograms for the traffic of one or more connections.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "client_metrics.h"
+
+#include <string.h>
+
+namespace{
+
+  /** @param[in] counter counter updated by other threads
+   * @return value of the counter
+   */
+  uint64_t load(const uint64_t &counter){
+    return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+  }
+
+  /** @param[in] latencyUs latency in microseconds
+   * @return histogram bucket counting the latency
+   */
+  size_t bucketOf(const uint64_t latencyUs){
+    if(latencyUs == 0) return 0;
+    // number of significant bits, so that 1 goes in bucket 1, 2-3 in bucket 2, 4-7 in bucket 3...
+    size_t bucket = 64 - __builtin_clzll(latencyUs);
+    return (bucket < rclient::ClientMetrics::HistogramBuckets ? bucket : rclient::ClientMetrics::HistogramBuckets - 1);
+  }
+
+} // close namespace
+
+
+namespace rclient{
+
+  /** @return average latency in microseconds, 0 if there were no responses
+   */
+  double ClientMetrics::Histogram::meanUs() const{
+    return (count > 0 ? (double) totalUs / count : 0);
+  }
+
+  /** Estimates a percentile of the latency from the histogram
+   * @param[in] percentile percentile between 0 and 100
+   * @return upper bound in microseconds of the bucket holding the percentile, capped at the largest latency
+   */
+  uint64_t ClientMetrics::Histogram::percentileUs(const double percentile) const{
+    const double rank = count * percentile / 100;
+    uint64_t seen = 0;
+    for(size_t i = 0; i < HistogramBuckets; ++i){
+      seen += buckets[i];
+      if(seen > 0 && seen >= rank){
+        uint64_t bound = (i == 0 ? 0 : ((uint64_t) 1 << i) - 1);
+        return (i + 1 < HistogramBuckets && bound < maxUs ? bound : maxUs);
+      }
+    }
+    return maxUs;
+  }
+
+
+  /** constructor starts every counter at 0
+   */
+  ClientMetrics::ClientMetrics():m_iRequests(0), m_iResponses(0), m_iBytesSent(0), m_iBytesReceived(0), m_iEntriesSent(0),
+                                 m_iEntriesReceived(0), m_iConnects(0), m_iReconnects(0){
+    memset(m_apLatency, 0, sizeof(m_apLatency));
+    memset(m_aErrors, 0, sizeof(m_aErrors));
+  }
+
+  /** destructor
+   */
+  ClientMetrics::~ClientMetrics(){
+    for(size_t i = 0; i < CommandSlots; ++i)
+      delete m_apLatency[i];
+  }
+
+
+  /** Counts a request sent, or queued to be sent
+   * @param[in] bytes size of the request, including its header
+   * @param[in] entries number of entries in the request
+   */
+  void ClientMetrics::recordRequest(const uint64_t bytes, const size_t entries){
+    __sync_fetch_and_add(&m_iRequests, 1);
+    __sync_fetch_and_add(&m_iBytesSent, bytes);
+    __sync_fetch_and_add(&m_iEntriesSent, (uint64_t) entries);
+  }
+
+  /** Counts a response received, and adds its latency to the command's histogram
+   * @param[in] command RPacket::eCMD of the request the response answers
+   * @param[in] latencyUs microseconds from sending the request to receiving the whole response
+   * @param[in] bytes size of the response, including its header
+   * @param[in] entries number of entries in the response
+   */
+  void ClientMetrics::recordResponse(const uint32_t command, const uint64_t latencyUs, const uint64_t bytes, const size_t entries){
+    __sync_fetch_and_add(&m_iResponses, 1);
+    __sync_fetch_and_add(&m_iBytesReceived, bytes);
+    __sync_fetch_and_add(&m_iEntriesReceived, (uint64_t) entries);
+
+    Counters *latency = counters(command);
+    __sync_fetch_and_add(&latency->count, 1);
+    __sync_fetch_and_add(&latency->totalUs, latencyUs);
+    __sync_fetch_and_add(&latency->buckets[bucketOf(latencyUs)], 1);
+    uint64_t max = load(latency->maxUs);
+    while(latencyUs > max && !__sync_bool_compare_and_swap(&latency->maxUs, max, latencyUs))
+      max = load(latency->maxUs);
+  }
+
+  /** Counts a connection established
+   * @param[in] reconnect whether an earlier connection was lost
+   */
+  void ClientMetrics::recordConnect(const bool reconnect){
+    __sync_fetch_and_add(&m_iConnects, 1);
+    if(reconnect)
+      __sync_fetch_and_add(&m_iReconnects, 1);
+  }
+
+  /** Counts a network error
+   * @param[in] error_num errno of the error, 0 if it has none
+   */
+  void ClientMetrics::recordError(const int error_num){
+    const size_t slot = (error_num >= 0 && error_num < ErrnoSlots ? error_num : ErrnoSlots);
+    __sync_fetch_and_add(&m_aErrors[slot], 1);
+  }
+
+
+  /** @return copy of the counters
+   */
+  ClientMetrics::Snapshot ClientMetrics::snapshot() const{
+    Snapshot snap;
+    for(size_t i = 0; i < CommandSlots; ++i){
+      const Counters *latency = __atomic_load_n(&m_apLatency[i], __ATOMIC_ACQUIRE);
+      if(!latency) continue;
+      Histogram histogram;
+      histogram.command = i;
+      histogram.count = load(latency->count);
+      histogram.totalUs = load(latency->totalUs);
+      histogram.maxUs = load(latency->maxUs);
+      for(size_t j = 0; j < HistogramBuckets; ++j)
+        histogram.buckets[j] = load(latency->buckets[j]);
+      snap.latency.push_back(histogram);
+    }
+    snap.requests = load(m_iRequests);
+    snap.responses = load(m_iResponses);
+    snap.bytesSent = load(m_iBytesSent);
+    snap.bytesReceived = load(m_iBytesReceived);
+    snap.entriesSent = load(m_iEntriesSent);
+    snap.entriesReceived = load(m_iEntriesReceived);
+    snap.connects = load(m_iConnects);
+    snap.reconnects = load(m_iReconnects);
+    for(int i = 0; i <= ErrnoSlots; ++i){
+      uint64_t errors = load(m_aErrors[i]);
+      if(errors > 0)
+        snap.errors[i] = errors;
+    }
+    return snap;
+  }
+
+
+  /** @param[in] command RPacket::eCMD
+   * @return latency counters of the command, allocated if this is its first response
+   */
+  ClientMetrics::Counters* ClientMetrics::counters(const uint32_t command){
+    Counters **slot = &m_apLatency[command % CommandSlots];
+    Counters *latency = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if(latency) return latency;
+
+    // threads answering the same command for the first time race to install their counters, and the losers free theirs
+    Counters *created = new Counters();
+    memset(created, 0, sizeof(Counters));
+    if(__sync_bool_compare_and_swap(slot, (Counters*) NULL, created))
+      return created;
+    delete created;
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  }
+
+} // close namespace
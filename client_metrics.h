@@ -0,0 +1,113 @@
+/*  ClientMetrics: Lock-free counters and latency histograms for the traffic of one or more connections.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_CLIENT_METRICS_H_INCLUDED
+#define RCLIENT_CLIENT_METRICS_H_INCLUDED
+
+#include "config.h"
+
+#include <map>
+#include <stddef.h>
+#include <inttypes.h>
+
+namespace rclient{
+
+  /** Counts the requests, responses, bytes, connects and network errors of the connections it is given to,
+   * and keeps a latency histogram per command, from sending a request to receiving its whole response.
+   * Every NetworkManager records into a ClientMetrics, its own unless ConnectionOptions::metrics shares one between connections.
+   * Recording only uses atomic additions, so it never blocks; snapshot may be called from any thread at any time.
+   * The counters in a snapshot are each read atomically, but not all at the same instant.
+   */
+  class RCLIENT_API ClientMetrics{
+
+  public:
+    enum {
+      // bucket 0 counts latencies under 1 microsecond, bucket i those from 2^(i-1) up to 2^i microseconds, and the last bucket the rest
+      HistogramBuckets = 32,
+      // commands are told apart by their low 8 bits, which covers every Rserve command
+      CommandSlots = 256,
+      // errno values of network errors are counted up to this value, larger ones are counted as ErrnoSlots
+      ErrnoSlots = 256
+    };
+
+    /** latency histogram of one command
+     */
+    struct RCLIENT_API Histogram{
+      uint32_t command; // RPacket::eCMD
+      uint64_t count; // responses received
+      uint64_t totalUs; // sum of the latencies, in microseconds
+      uint64_t maxUs; // largest latency, in microseconds
+      uint64_t buckets[HistogramBuckets];
+
+      double meanUs() const;
+      uint64_t percentileUs(const double percentile) const;
+    };
+
+    /** counters at the time snapshot was called
+     */
+    struct RCLIENT_API Snapshot{
+      RVECTORTYPE<Histogram> latency; // one histogram per command that has been answered, in order of command
+      uint64_t requests; // requests sent
+      uint64_t responses; // responses received
+      uint64_t bytesSent; // bytes of the requests sent, including their headers
+      uint64_t bytesReceived; // bytes of the responses received, including their headers
+      uint64_t entriesSent; // entries in the requests sent
+      uint64_t entriesReceived; // entries in the responses received, not counting REXPs passed to an REXPHandler
+      uint64_t connects; // connections established
+      uint64_t reconnects; // connections established after an earlier one was lost
+      std::map<int, uint64_t> errors; // network errors by errno, 0 for errors without an errno and ErrnoSlots for larger ones
+    };
+
+    ClientMetrics();
+    ~ClientMetrics();
+
+    void recordRequest(const uint64_t bytes, const size_t entries);
+    void recordResponse(const uint32_t command, const uint64_t latencyUs, const uint64_t bytes, const size_t entries);
+    void recordConnect(const bool reconnect);
+    void recordError(const int error_num);
+
+    Snapshot snapshot() const;
+
+  private:
+    ClientMetrics(const ClientMetrics &no_copy); // non construction-copyable
+    ClientMetrics& operator=(const ClientMetrics&); // non-copyable
+
+    /** live counters of one command, allocated the first time the command is answered
+     */
+    struct Counters{
+      uint64_t count;
+      uint64_t totalUs;
+      uint64_t maxUs;
+      uint64_t buckets[HistogramBuckets];
+    };
+
+    Counters* counters(const uint32_t command);
+
+    Counters *m_apLatency[CommandSlots]; // latency counters by command, null until the command is first answered
+    uint64_t m_iRequests;
+    uint64_t m_iResponses;
+    uint64_t m_iBytesSent;
+    uint64_t m_iBytesReceived;
+    uint64_t m_iEntriesSent;
+    uint64_t m_iEntriesReceived;
+    uint64_t m_iConnects;
+    uint64_t m_iReconnects;
+    uint64_t m_aErrors[ErrnoSlots + 1]; // network errors by errno
+  };
+
+} // close namespace
+
+#endif
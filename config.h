@@ -42,6 +42,11 @@ typedef std::string RSTRINGTYPE;
 
 #include <boost/make_shared.hpp>
 #define RMAKE_SHARED boost::make_shared
+#define RALLOCATE_SHARED boost::allocate_shared
+
+// passes an argument by reference through RMAKE_SHARED and RALLOCATE_SHARED
+#include <boost/ref.hpp>
+#define RREF boost::ref
 
 #define RPTR_CAST boost::dynamic_pointer_cast
 
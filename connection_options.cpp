@@ -0,0 +1,32 @@
+/*  ConnectionOptions: Socket settings applied by NetworkManager when connecting to the server.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "connection_options.h"
+
+namespace rclient{
+
+  /** constructor leaves every socket setting at the system default, and does not pipeline requests
+   */
+  ConnectionOptions::ConnectionOptions():tcpNoDelay(false), tcpQuickAck(false), sendBufferSize(0), receiveBufferSize(0),
+                                         keepAlive(false), keepAliveIdle(0), keepAliveInterval(0), keepAliveCount(0),
+                                         connectTimeout(0), connectStagger(250), maxInFlight(1), zeroCopyThreshold(0), decodeArenaSize(0),
+                                         maxResponseLength((uint64_t) 1 << 32){}
+
+  /** destructor
+   */
+  ConnectionOptions::~ConnectionOptions(){}
+
+} // close namespace
@@ -0,0 +1,61 @@
+/*  ConnectionOptions: Socket settings applied by NetworkManager when connecting to the server.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_CONNECTION_OPTIONS_H_INCLUDED
+#define RCLIENT_CONNECTION_OPTIONS_H_INCLUDED
+
+#include "config.h"
+#include <inttypes.h>
+
+namespace rclient{
+
+  class ClientMetrics;
+  class RequestTracer;
+  class TrafficRecorder;
+
+  /** Socket and connection tuning for the connection to Rserve.
+   * The default constructed options leave every setting at the system default and disable pipelining.
+   * NetworkManager applies the options each time it (re)connects.
+   * Settings that are not supported by the platform are ignored.
+   */
+  class RCLIENT_API ConnectionOptions{
+
+  public:
+    ConnectionOptions();
+    ~ConnectionOptions();
+
+    bool tcpNoDelay;        // disable Nagle's algorithm (TCP_NODELAY)
+    bool tcpQuickAck;       // acknowledge responses immediately (TCP_QUICKACK, Linux only)
+    int sendBufferSize;     // SO_SNDBUF in bytes, 0 for system default
+    int receiveBufferSize;  // SO_RCVBUF in bytes, 0 for system default
+    bool keepAlive;         // send keepalive probes on an idle connection (SO_KEEPALIVE)
+    int keepAliveIdle;      // seconds of idle time before the first probe (TCP_KEEPIDLE), 0 for system default
+    int keepAliveInterval;  // seconds between probes (TCP_KEEPINTVL), 0 for system default
+    int keepAliveCount;     // unanswered probes before the connection is dropped (TCP_KEEPCNT), 0 for system default
+    int connectTimeout;     // milliseconds allowed for establishing the connection and receiving the ID string of Rserve, 0 for no limit
+    int connectStagger;     // milliseconds to wait on a connection attempt before also trying the next address
+    int maxInFlight;        // asynchronous requests sent ahead of their responses, 1 to wait for each response before the next request
+    int zeroCopyThreshold;  // requests of at least this many bytes are sent with MSG_ZEROCOPY (TCP on Linux only), 0 to always copy
+    int decodeArenaSize;    // bytes in the first chunk of an RArena that the REXPs of each response are allocated from, 0 to allocate each REXP separately
+    uint64_t maxResponseLength; // longest response data section accepted, in bytes. A longer response closes the connection
+    RSHARED_PTR<ClientMetrics> metrics; // counts the traffic of every connection given the same instance, null for a connection to count its own
+    RSHARED_PTR<RequestTracer> tracer; // notified of the time spent in each phase of a request, null to time nothing
+    RSHARED_PTR<TrafficRecorder> recorder; // records every frame sent and received, null to record nothing
+  };
+
+} // close namespace
+
+#endif
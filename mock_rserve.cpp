@@ -0,0 +1,620 @@
+/*  MockRserve: In-process stand-in for Rserve that speaks QAP1, for benchmarks and tests without R.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "mock_rserve.h"
+#include "network_writer.h"
+#include "rpacket.h"
+#include "rexp_double.h"
+#include "rexp_integer.h"
+#include "rexp_string.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm> // for std::min
+#include <sstream>
+#include <stdexcept>
+
+// MSG_NOSIGNAL is not defined on VMS, so define it to be an empty flag
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace{
+
+  /** response commands: OK, or error with the status in the top byte
+   */
+  const uint32_t RESP_OK = 0x10001;
+  const uint32_t RESP_ERR = 0x10002;
+
+  /** size of the buffer responses are serialized into while they are sent
+   */
+  const size_t ResponseChunkLength = 262144;
+
+  /** entry in the data section of a request
+   */
+  struct Entry{
+    uint32_t type; // data type, without the DT_LARGE flag
+    const unsigned char *begin; // entry header
+    const unsigned char *data; // entry data, following the header
+    size_t length; // bytes of data
+  };
+
+  /** sends all of buf
+   * Throws runtime_error if the connection failed
+   * @param[in] sock connected socket
+   * @param[in] buf data to send
+   * @param[in] len number of bytes in buf
+   */
+  void sendAll(const int sock, const unsigned char *buf, const size_t len){
+    size_t i = 0;
+    while(i < len){
+      ssize_t n = ::send(sock, &buf[i], len - i, MSG_NOSIGNAL);
+      if(n <= 0){
+        if(n < 0 && errno == EINTR) continue;
+        throw std::runtime_error("ERROR:: Mock Rserve failed to send a response.");
+      }
+      i += n;
+    }
+  }
+
+  /** receives exactly len bytes
+   * @param[in] sock connected socket
+   * @param[out] buf buffer to fill
+   * @param[in] len number of bytes to receive
+   * @return False if the connection was closed or failed first
+   */
+  bool recvAll(const int sock, unsigned char *buf, const size_t len){
+    size_t i = 0;
+    while(i < len){
+      ssize_t n = ::recv(sock, &buf[i], len - i, 0);
+      if(n <= 0){
+        if(n < 0 && errno == EINTR) continue;
+        return false;
+      }
+      i += n;
+    }
+    return true;
+  }
+
+  /** @param[in] p 4 bytes holding a little-endian integer
+   * @return the integer
+   */
+  uint32_t readUint32(const unsigned char *p){
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+  }
+
+  /** @param[out] p 4 bytes to hold value as a little-endian integer
+   * @param[in] value integer to write
+   */
+  void writeUint32(unsigned char *p, const uint32_t value){
+    for(size_t i = 0; i < 4; ++i)
+      p[i] = (unsigned char) (value >> (i * 8));
+  }
+
+  /** Splits the data section of a request into its entries
+   * @param[in] body data section
+   * @param[out] entries entries found in body
+   * @return False if an entry runs past the end of body
+   */
+  bool parseEntries(const RVECTORTYPE<unsigned char> &body, RVECTORTYPE<Entry> &entries){
+    size_t pos = 0;
+    while(pos < body.size()){
+      const size_t header_length = (body[pos] & rclient::RPacket::PacketEntry::DT_LARGE ? 8 : 4);
+      if(body.size() - pos < header_length) return false;
+      // entry length is a little-endian 3 or 7 byte integer following the type
+      uint64_t length = 0;
+      for(size_t i = 1; i < header_length; ++i)
+        length |= (uint64_t) body[pos + i] << ((i - 1) * 8);
+      if(body.size() - pos - header_length < length) return false;
+
+      Entry entry;
+      entry.type = body[pos] & rclient::RPacket::PacketEntry::DT_TYPE_MASK;
+      entry.begin = &body[pos];
+      entry.data = &body[pos + header_length];
+      entry.length = length;
+      entries.push_back(entry);
+      pos += header_length + length;
+    }
+    return true;
+  }
+
+  /** @param[in] entry DT_STRING entry
+   * @return the string, without its terminating NULs and the newline clients append to expressions
+   */
+  RSTRINGTYPE entryString(const Entry &entry){
+    RSTRINGTYPE str((const char*) entry.data, entry.length);
+    size_t end = str.find('\0');
+    if(end != RSTRINGTYPE::npos) str.resize(end);
+    while(!str.empty() && str[str.size() - 1] == '\n') str.resize(str.size() - 1);
+    return str;
+  }
+
+  /** NetworkWriter that sends each chunk to a client as soon as it fills
+   */
+  class ResponseWriter : public rclient::NetworkWriter{
+  public:
+    explicit ResponseWriter(const int sock):NetworkWriter(ResponseChunkLength), m_iSock(sock){}
+  protected:
+    virtual void flushChunk(const unsigned char *data, const size_t length){
+      sendAll(m_iSock, data, length);
+    }
+  private:
+    const int m_iSock;
+  };
+
+  /** writes the QAP1 header of a response
+   * @param[out] writer receives the header
+   * @param[in] cmd response command
+   * @param[in] length number of bytes in the data section
+   */
+  void writeHeader(rclient::NetworkWriter &writer, const uint32_t cmd, const uint64_t length){
+    unsigned char header[16];
+    writeUint32(&header[0], cmd);
+    writeUint32(&header[4], (uint32_t) length);
+    writeUint32(&header[8], 0);
+    writeUint32(&header[12], (uint32_t) (length >> 32));
+    writer.write(header, sizeof(header));
+  }
+
+  /** sends a response without data
+   * @param[in] sock connected socket
+   * @param[in] status 0 for RESP_OK, otherwise the error status of RESP_ERR
+   */
+  void sendStatus(const int sock, const int status){
+    ResponseWriter writer(sock);
+    writeHeader(writer, (status == 0 ? RESP_OK : RESP_ERR | (uint32_t) (status & 127) << 24), 0);
+    writer.flush();
+  }
+
+  /** sends a response holding a REXP, serializing it while it is sent
+   * @param[in] sock connected socket
+   * @param[in] value REXP to send
+   */
+  void sendValue(const int sock, const rclient::REXP &value){
+    rclient::RPacket::PacketEntry entry = rclient::RPacket::PacketEntry::streaming(value);
+    ResponseWriter writer(sock);
+    writeHeader(writer, RESP_OK, entry.getLength());
+    entry.writeTo(writer);
+    writer.flush();
+  }
+
+  /** sends a response holding an entry as it was received
+   * @param[in] sock connected socket
+   * @param[in] entry DT_SEXP entry, including its header
+   */
+  void sendEntry(const int sock, const RVECTORTYPE<unsigned char> &entry){
+    ResponseWriter writer(sock);
+    writeHeader(writer, RESP_OK, entry.size());
+    writer.write(&entry[0], entry.size());
+    writer.flush();
+  }
+
+  /** Builds the synthetic vector requested by double(n), integer(n) or character(n)
+   * @param[in] expr expression to evaluate
+   * @return the vector, or null if expr does not request one
+   */
+  RSHARED_PTR<const rclient::REXP> syntheticValue(const RSTRINGTYPE &expr){
+    char kind[16];
+    unsigned long n = 0;
+    int end = 0;
+    if(sscanf(expr.c_str(), "%15[a-z](%lu)%n", kind, &n, &end) != 2 || end != (int) expr.size())
+      return RSHARED_PTR<const rclient::REXP>();
+
+    if(strcmp(kind, "double") == 0){
+      RVECTORTYPE<double> values(n);
+      for(size_t i = 0; i < n; ++i)
+        values[i] = i * 0.5;
+      return RSHARED_PTR<const rclient::REXP>(new rclient::REXPDouble(values, rclient::AdoptNAEncoded));
+    }
+    if(strcmp(kind, "integer") == 0){
+      RVECTORTYPE<int32_t> values(n);
+      for(size_t i = 0; i < n; ++i)
+        values[i] = (int32_t) i;
+      return RSHARED_PTR<const rclient::REXP>(new rclient::REXPInteger(values, rclient::AdoptNAEncoded));
+    }
+    if(strcmp(kind, "character") == 0){
+      RVECTORTYPE<RSTRINGTYPE> values(n);
+      for(size_t i = 0; i < n; ++i){
+        std::ostringstream str;
+        str << i;
+        values[i] = str.str();
+      }
+      return RSHARED_PTR<const rclient::REXP>(new rclient::REXPString(values, rclient::AdoptNAEncoded));
+    }
+    return RSHARED_PTR<const rclient::REXP>();
+  }
+
+} // close namespace
+
+
+namespace rclient{
+
+  /** constructor. Nothing is listened on until listen, start or run is called
+   * @param[in] port port to listen on, 0 to pick any free port (see getPort)
+   * @param[in] address IPv4 address to listen on
+   */
+  MockRserve::MockRserve(const int port, const RSTRINGTYPE &address):m_iRequestedPort(port), m_sAddress(address), m_iListen(-1), m_iPort(0),
+    m_iNextReplay(0), m_bStopping(false), m_bStarted(false){}
+
+  /** destructor stops serving, closing every connection
+   */
+  MockRserve::~MockRserve(){
+    stop();
+    if(m_iListen >= 0)
+      close(m_iListen);
+  }
+
+
+  /** Requires clients to log in with plain text authentication before any other command
+   * @param[in] user login username
+   * @param[in] pwd login password
+   */
+  void MockRserve::setLogin(const RSTRINGTYPE &user, const RSTRINGTYPE &pwd){
+    ScopedLock lock(m_mutex);
+    m_sUser = user;
+    m_sPwd = pwd;
+  }
+
+  /** Answers eval of an expression with a value, and voidEval of it with OK
+   * @param[in] expr expression, without the trailing newline
+   * @param[in] value value to return
+   */
+  void MockRserve::script(const RSTRINGTYPE &expr, const RSHARED_PTR<const REXP> &value){
+    ScopedLock lock(m_mutex);
+    Script &entry = m_scripts[expr];
+    entry.value = value;
+    entry.status = 0;
+  }
+
+  /** Answers eval and voidEval of an expression with an error
+   * @param[in] expr expression, without the trailing newline
+   * @param[in] status error status, see RPacket::eStat
+   */
+  void MockRserve::scriptError(const RSTRINGTYPE &expr, const int status){
+    ScopedLock lock(m_mutex);
+    Script &entry = m_scripts[expr];
+    entry.value.reset();
+    entry.status = status;
+  }
+
+  /** Replays a recorded trace instead of serving requests. The n-th accepted connection replays the n-th connection in the trace:
+   * it is sent the recorded ID string, then each request it sends is answered with the next recorded response, whatever the request.
+   * The connection is closed once its recorded responses run out. Connections beyond those in the trace are closed straight away.
+   * @param[in] trace trace to replay
+   */
+  void MockRserve::replay(const RSHARED_PTR<const TrafficTrace> &trace){
+    ScopedLock lock(m_mutex);
+    m_pReplay = trace;
+    m_iNextReplay = 0;
+  }
+
+
+  /** Starts listening, so that clients can connect before start or run is called
+   * Throws runtime_error if the address cannot be listened on
+   * @return port being listened on
+   */
+  int MockRserve::listen(){
+    if(m_iListen >= 0) return m_iPort;
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(m_iRequestedPort);
+    if(inet_pton(AF_INET, m_sAddress.c_str(), &address.sin_addr) != 1)
+      throw std::runtime_error("ERROR:: Invalid mock Rserve address.");
+
+    int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+    if(sock < 0)
+      throw std::runtime_error("ERROR:: Mock Rserve failed to obtain socket.");
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t length = sizeof(address);
+    if(::bind(sock, (struct sockaddr*) &address, sizeof(address)) != 0 || ::listen(sock, SOMAXCONN) != 0 ||
+       getsockname(sock, (struct sockaddr*) &address, &length) != 0){
+      close(sock);
+      throw std::runtime_error("ERROR:: Mock Rserve failed to listen.");
+    }
+    m_iPort = ntohs(address.sin_port);
+    m_iListen = sock;
+    return m_iPort;
+  }
+
+  /** Serves clients on a background thread until stop is called or a client sends CMD_shutdown
+   * Throws runtime_error if the address cannot be listened on
+   */
+  void MockRserve::start(){
+    listen();
+    if(m_bStarted) return;
+    if(pthread_create(&m_thread, NULL, &MockRserve::accept_thread, this) != 0)
+      throw std::runtime_error("ERROR:: Failed to start mock Rserve thread.");
+    m_bStarted = true;
+  }
+
+  /** Serves clients on the calling thread until stop is called or a client sends CMD_shutdown
+   * Throws runtime_error if the address cannot be listened on
+   */
+  void MockRserve::run(){
+    listen();
+    while(true){
+      int sock = ::accept(m_iListen, NULL, NULL);
+      {
+        ScopedLock lock(m_mutex);
+        if(m_bStopping){
+          if(sock >= 0) close(sock);
+          break;
+        }
+        if(sock >= 0){
+          Connection *connection = new Connection();
+          connection->server = this;
+          connection->sock = sock;
+          connection->done = false;
+          if(pthread_create(&connection->thread, NULL, &MockRserve::connection_thread, connection) != 0){
+            close(sock);
+            delete connection;
+          }
+          else{
+            m_connections.push_back(connection);
+          }
+        }
+      }
+      // accept fails while the system is short of resources, so carry on after releasing finished connections
+      close_connections(false);
+    }
+    close_connections(true);
+  }
+
+  /** Stops serving and closes every connection. A stopped MockRserve cannot serve again
+   */
+  void MockRserve::stop(){
+    {
+      ScopedLock lock(m_mutex);
+      m_bStopping = true;
+      // wakes up accept
+      if(m_iListen >= 0)
+        ::shutdown(m_iListen, SHUT_RDWR);
+    }
+    if(m_bStarted){
+      pthread_join(m_thread, NULL);
+      m_bStarted = false;
+    }
+  }
+
+  /** @return port being listened on, 0 before listen, start or run is called
+   */
+  int MockRserve::getPort() const{
+    return m_iPort;
+  }
+
+
+  /** thread function running the accept loop
+   * @param[in] server MockRserve to run
+   * @return NULL
+   */
+  void* MockRserve::accept_thread(void *server){
+    static_cast<MockRserve*>(server)->run();
+    return NULL;
+  }
+
+  /** thread function serving one connection
+   * @param[in] connection Connection to serve
+   * @return NULL
+   */
+  void* MockRserve::connection_thread(void *connection){
+    Connection *c = static_cast<Connection*>(connection);
+    try{
+      c->server->serve(c->sock);
+    }
+    catch(...){
+      // a failed connection only ends its own session
+    }
+    ScopedLock lock(c->server->m_mutex);
+    c->done = true;
+    return NULL;
+  }
+
+  /** Serves requests on a connection until the client disconnects
+   * Throws runtime_error if a response cannot be sent
+   * @param[in] sock connected socket
+   */
+  void MockRserve::serve(const int sock){
+    RSTRINGTYPE user, pwd;
+    RSHARED_PTR<const TrafficTrace> trace;
+    size_t replayIndex = 0;
+    {
+      ScopedLock lock(m_mutex);
+      user = m_sUser;
+      pwd = m_sPwd;
+      trace = m_pReplay;
+      replayIndex = m_iNextReplay++;
+    }
+    if(trace){
+      const RVECTORTYPE<uint32_t> connections = trace->getConnections();
+      if(replayIndex < connections.size())
+        serve_replay(sock, *trace, connections[replayIndex]);
+      return;
+    }
+
+    // 32 byte ID string, announcing plain text authentication if a login is required
+    RSTRINGTYPE id = "Rsrv0103QAP1\r\n\r\n";
+    if(!user.empty())
+      id += "ARpt";
+    id.resize(30, '-');
+    id += "\r\n";
+    sendAll(sock, (const unsigned char*) id.data(), id.size());
+
+    bool loggedIn = user.empty();
+    std::map<RSTRINGTYPE, RVECTORTYPE<unsigned char> > variables; // assigned values, as the entries they were sent in
+    unsigned char header[16];
+    while(recvAll(sock, header, sizeof(header))){
+      const uint32_t cmd = readUint32(&header[0]);
+      const uint64_t length = readUint32(&header[4]) | (uint64_t) readUint32(&header[12]) << 32;
+      RVECTORTYPE<unsigned char> body(length);
+      if(length > 0 && !recvAll(sock, &body[0], length))
+        return;
+
+      RVECTORTYPE<Entry> entries;
+      if(!parseEntries(body, entries)){
+        sendStatus(sock, RPacket::ERR_inv_par);
+        continue;
+      }
+      if(!loggedIn && cmd != RPacket::CMD_login){
+        sendStatus(sock, RPacket::ERR_auth_failed);
+        continue;
+      }
+
+      switch(cmd){
+      case RPacket::CMD_login:
+        {
+          RSTRINGTYPE loginfo = (entries.empty() ? RSTRINGTYPE() : entryString(entries[0]));
+          size_t separator = loginfo.find('\n');
+          loggedIn = user.empty() || (separator != RSTRINGTYPE::npos && loginfo.substr(0, separator) == user && loginfo.substr(separator + 1) == pwd);
+          if(!loggedIn){
+            // Rserve closes the connection after a failed login
+            sendStatus(sock, RPacket::ERR_auth_failed);
+            return;
+          }
+          sendStatus(sock, 0);
+          break;
+        }
+
+      case RPacket::CMD_voideval:
+      case RPacket::CMD_eval:
+        {
+          if(entries.empty() || entries[0].type != RPacket::PacketEntry::DT_STRING){
+            sendStatus(sock, RPacket::ERR_inv_par);
+            break;
+          }
+          const RSTRINGTYPE expr = entryString(entries[0]);
+          Script scripted;
+          bool isScripted = false;
+          {
+            ScopedLock lock(m_mutex);
+            std::map<RSTRINGTYPE, Script>::const_iterator it = m_scripts.find(expr);
+            if(it != m_scripts.end()){
+              scripted = it->second;
+              isScripted = true;
+            }
+          }
+
+          if(isScripted && !scripted.value){
+            sendStatus(sock, scripted.status);
+          }
+          else if(cmd == RPacket::CMD_voideval){
+            sendStatus(sock, 0);
+          }
+          else if(isScripted){
+            sendValue(sock, *scripted.value);
+          }
+          else if(variables.count(expr)){
+            sendEntry(sock, variables[expr]);
+          }
+          else{
+            RSHARED_PTR<const REXP> value = syntheticValue(expr);
+            if(value)
+              sendValue(sock, *value);
+            else
+              sendValue(sock, REXPString(expr));
+          }
+          break;
+        }
+
+      case RPacket::CMD_setSEXP:
+      case RPacket::CMD_assignSEXP:
+        if(entries.size() != 2 || entries[0].type != RPacket::PacketEntry::DT_STRING || entries[1].type != RPacket::PacketEntry::DT_SEXP){
+          sendStatus(sock, RPacket::ERR_inv_par);
+          break;
+        }
+        variables[entryString(entries[0])].assign(entries[1].begin, entries[1].data + entries[1].length);
+        sendStatus(sock, 0);
+        break;
+
+      case RPacket::CMD_shutdown:
+        sendStatus(sock, 0);
+        {
+          ScopedLock lock(m_mutex);
+          m_bStopping = true;
+          ::shutdown(m_iListen, SHUT_RDWR);
+        }
+        return;
+
+      default:
+        sendStatus(sock, RPacket::ERR_unsupportedCmd);
+      }
+    }
+  }
+
+  /** Replays one recorded connection, see replay
+   * Throws runtime_error if a response cannot be sent
+   * @param[in] sock connected socket
+   * @param[in] trace trace being replayed
+   * @param[in] connection id of the recorded connection
+   */
+  void MockRserve::serve_replay(const int sock, const TrafficTrace &trace, const uint32_t connection){
+    const RVECTORTYPE<TrafficTrace::Record> hello = trace.getRecords(connection, TrafficRecorder::TR_HELLO);
+    const RVECTORTYPE<TrafficTrace::Record> responses = trace.getRecords(connection, TrafficRecorder::TR_RESPONSE);
+    for(size_t i = 0; i < hello.size(); ++i)
+      if(!hello[i].frame->empty())
+        sendAll(sock, &(*hello[i].frame)[0], hello[i].frame->size());
+
+    unsigned char header[16];
+    for(size_t i = 0; i < responses.size() && recvAll(sock, header, sizeof(header)); ++i){
+      // the request is read and dropped
+      uint64_t remaining = readUint32(&header[4]) | (uint64_t) readUint32(&header[12]) << 32;
+      unsigned char discard[4096];
+      while(remaining > 0){
+        const size_t n = (size_t) std::min(remaining, (uint64_t) sizeof(discard));
+        if(!recvAll(sock, discard, n))
+          return;
+        remaining -= n;
+      }
+      if(!responses[i].frame->empty())
+        sendAll(sock, &(*responses[i].frame)[0], responses[i].frame->size());
+    }
+  }
+
+  /** Joins the threads of finished connections and closes their sockets
+   * @param[in] all if set, every connection is closed first, so that all of them finish
+   */
+  void MockRserve::close_connections(const bool all){
+    std::list<Connection*> finished;
+    {
+      ScopedLock lock(m_mutex);
+      std::list<Connection*>::iterator it = m_connections.begin();
+      while(it != m_connections.end()){
+        if(all || (*it)->done){
+          // the socket stays open until the thread is joined, so it cannot be reused meanwhile
+          if(all) ::shutdown((*it)->sock, SHUT_RDWR);
+          finished.push_back(*it);
+          it = m_connections.erase(it);
+        }
+        else{
+          ++it;
+        }
+      }
+    }
+    for(std::list<Connection*>::iterator it = finished.begin(); it != finished.end(); ++it){
+      pthread_join((*it)->thread, NULL);
+      close((*it)->sock);
+      delete *it;
+    }
+  }
+
+} // close namespace
@@ -0,0 +1,105 @@
+/*  MockRserve: In-process stand-in for Rserve that speaks QAP1, for benchmarks and tests without R.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_MOCK_RSERVE_H_INCLUDED
+#define RCLIENT_MOCK_RSERVE_H_INCLUDED
+
+#include "config.h"
+#include "rexp.h"
+#include "thread_sync.h"
+#include "traffic_trace.h"
+
+#include <map>
+#include <list>
+#include <pthread.h>
+
+namespace rclient{
+
+  /** Serves the QAP1 protocol on a TCP port like Rserve 0103, without evaluating any R.
+   * Each connection is served on its own thread and keeps its own variables, like an Rserve session.
+   * login, eval, voidEval, assign (setSEXP and assignSEXP) and shutdown are supported. eval answers with:
+   *  - the value or error scripted for the expression with script or scriptError
+   *  - the value last assigned to the expression, if it names a variable
+   *  - a synthetic vector for double(n), integer(n) and character(n): n values counting up from 0 (0, 0.5, 1, ... for doubles,
+   *    "0", "1", ... for strings). Synthetic values are serialized while they are sent, so they may be large.
+   *  - otherwise the expression itself, as a string
+   * Alternatively, replay serves the connections of a trace recorded with TrafficRecorder instead.
+   * Settings must be made before start or run.
+   */
+  class RCLIENT_API MockRserve{
+
+  public:
+    explicit MockRserve(const int port = 0, const RSTRINGTYPE &address = "127.0.0.1");
+    ~MockRserve();
+
+    void setLogin(const RSTRINGTYPE &user, const RSTRINGTYPE &pwd);
+    void script(const RSTRINGTYPE &expr, const RSHARED_PTR<const REXP> &value);
+    void scriptError(const RSTRINGTYPE &expr, const int status);
+    void replay(const RSHARED_PTR<const TrafficTrace> &trace);
+
+    int listen();
+    void start();
+    void run();
+    void stop();
+    int getPort() const;
+
+  private:
+    MockRserve(const MockRserve &no_copy); // non construction-copyable
+    MockRserve& operator=(const MockRserve&); // non-copyable
+
+    /** connection being served
+     */
+    struct Connection{
+      MockRserve *server;
+      int sock;
+      pthread_t thread;
+      bool done; // set by the connection's thread as it finishes
+    };
+
+    /** scripted answer to an expression
+     */
+    struct Script{
+      RSHARED_PTR<const REXP> value; // null for an error
+      int status; // error status, used if value is null
+    };
+
+    static void* accept_thread(void *server);
+    static void* connection_thread(void *connection);
+    void serve(const int sock);
+    void serve_replay(const int sock, const TrafficTrace &trace, const uint32_t connection);
+    void close_connections(const bool all);
+
+    const int m_iRequestedPort; // port to listen on, 0 for any free port
+    const RSTRINGTYPE m_sAddress; // IPv4 address to listen on
+    int m_iListen; // listening socket, -1 until listen is called
+    int m_iPort; // port being listened on
+
+    RSTRINGTYPE m_sUser; // login username, empty if no login is required
+    RSTRINGTYPE m_sPwd; // login password
+    std::map<RSTRINGTYPE, Script> m_scripts; // scripted answers by expression
+    RSHARED_PTR<const TrafficTrace> m_pReplay; // trace to replay, null to serve requests
+    size_t m_iNextReplay; // index of the next recorded connection to replay
+
+    Mutex m_mutex; // guards the settings, m_iNextReplay, m_bStopping and m_connections
+    bool m_bStopping; // set by stop and by CMD_shutdown
+    std::list<Connection*> m_connections; // connections being served, or finished but not joined
+    bool m_bStarted; // whether start created m_thread
+    pthread_t m_thread; // runs the accept loop after start
+  };
+
+} // close namespace
+
+#endif
@@ -0,0 +1,77 @@
+/*  mock_rserve: Runs a MockRserve until a client sends CMD_shutdown.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mock_rserve.h"
+
+using namespace std;
+
+/** prints the command line options
+ * @param[in] name name the program was run as
+ */
+void printUsage(const char *name){
+  cerr << "usage: " << name << " [-p port] [-a address] [-l user:password]" << endl
+       << "  -p  port to listen on, default 6311. 0 picks a free port" << endl
+       << "  -a  IPv4 address to listen on, default 127.0.0.1" << endl
+       << "  -l  require a plain text login" << endl;
+}
+
+int main(int argc, char **argv){
+  int port = 6311;
+  string address = "127.0.0.1";
+  string login;
+
+  int option;
+  while((option = getopt(argc, argv, "p:a:l:h")) != -1){
+    switch(option){
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'a':
+      address = optarg;
+      break;
+    case 'l':
+      login = optarg;
+      break;
+    default:
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  try{
+    rclient::MockRserve server(port, address);
+    if(!login.empty()){
+      size_t separator = login.find(':');
+      if(separator == string::npos){
+        printUsage(argv[0]);
+        return 1;
+      }
+      server.setLogin(login.substr(0, separator), login.substr(separator + 1));
+    }
+    cout << "mock Rserve listening on " << address << ":" << server.listen() << endl;
+    server.run();
+  }
+  catch(const std::exception &e){
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,401 @@
+/*  NATranslator: Vectorized Replacement of NA Values in Integer and Double Arrays
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "na_translator.h"
+
+#include <string.h>
+#include <algorithm> // for std::min
+
+// SSE2 is used where the compiler targets it. AVX2 kernels are compiled per function and only called if the processor supports them
+#if !defined(RCLIENT_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__)
+#define RCLIENT_USE_SSE2
+#include <emmintrin.h>
+#if (defined(__x86_64__) || defined(__i386__)) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define RCLIENT_USE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace{
+
+  // number of values translated at a time, small enough that a block checked for NA is still cached when it is copied.
+  // The replace kernels return whether they found NA, and a block is only checked first if the previous block had none,
+  // so arrays without NA are copied with memcpy while arrays with many NA are blended in a single pass.
+  const size_t BlockLength = 2048;
+
+  /** Retrieves the bits of a double without passing it through a floating point register, which could quiet a signaling NaN
+   * @param[in] val pointer to the double
+   * @return bits of the double
+   */
+  inline uint64_t doubleBits(const double *val){
+    uint64_t bits;
+    memcpy(&bits, val, sizeof(bits));
+    return bits;
+  }
+
+  /** Checks integers for NA one at a time, stopping at the first
+   * @param[in] vals integers to check
+   * @param[in] count number of integers
+   * @param[in] na NA representation to look for
+   * @return true if any of the integers is NA
+   */
+  bool containsScalar(const int32_t *vals, const size_t count, const int32_t na){
+    for(size_t i = 0; i < count; ++i){
+      if(vals[i] == na)
+        return true;
+    }
+    return false;
+  }
+
+  /** Copies integers one at a time, replacing NA values. Also finishes the arrays the SIMD kernels leave a remainder of
+   * @param[out] dest array of count integers to fill, may be src
+   * @param[in] src integers to copy
+   * @param[in] count number of integers
+   * @param[in] na NA representation to replace
+   * @param[in] replacement value NA integers are replaced with
+   * @return true if any NA was replaced
+   */
+  bool replaceScalar(int32_t *dest, const int32_t *src, const size_t count, const int32_t na, const int32_t replacement){
+    bool found = false;
+    for(size_t i = 0; i < count; ++i){
+      bool isNA = (src[i] == na);
+      dest[i] = isNA ? replacement : src[i];
+      found |= isNA;
+    }
+    return found;
+  }
+
+  /** Checks doubles for NA one at a time by comparing their masked bits, stopping at the first
+   * @param[in] vals doubles to check
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @return true if any of the doubles is NA
+   */
+  bool containsScalar(const double *vals, const size_t count, const uint64_t mask, const uint64_t na){
+    for(size_t i = 0; i < count; ++i){
+      if((doubleBits(&vals[i]) & mask) == na)
+        return true;
+    }
+    return false;
+  }
+
+  /** Copies doubles one at a time bit for bit, replacing NA values
+   * @param[out] dest array of count doubles to fill, may be src
+   * @param[in] src doubles to copy
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @param[in] replacement value NA doubles are replaced with
+   * @return true if any NA was replaced
+   */
+  bool replaceScalar(double *dest, const double *src, const size_t count, const uint64_t mask, const uint64_t na, const double replacement){
+    const uint64_t replacementBits = doubleBits(&replacement);
+    bool found = false;
+    for(size_t i = 0; i < count; ++i){
+      uint64_t bits = doubleBits(&src[i]);
+      if((bits & mask) == na){
+        bits = replacementBits;
+        found = true;
+      }
+      memcpy(&dest[i], &bits, sizeof(bits));
+    }
+    return found;
+  }
+
+#ifdef RCLIENT_USE_SSE2
+  /** Checks integers for NA four at a time with SSE2
+   * @param[in] vals integers to check
+   * @param[in] count number of integers
+   * @param[in] na NA representation to look for
+   * @return true if any of the integers is NA
+   */
+  bool containsSSE2(const int32_t *vals, const size_t count, const int32_t na){
+    const __m128i vna = _mm_set1_epi32(na);
+    __m128i found = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+      found = _mm_or_si128(found, _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(vals + i)), vna));
+    return _mm_movemask_epi8(found) != 0 || containsScalar(vals + i, count - i, na);
+  }
+
+  /** Copies integers four at a time with SSE2, blending the replacement into the lanes that are NA
+   * @param[out] dest array of count integers to fill, may be src
+   * @param[in] src integers to copy
+   * @param[in] count number of integers
+   * @param[in] na NA representation to replace
+   * @param[in] replacement value NA integers are replaced with
+   * @return true if any NA was replaced
+   */
+  bool replaceSSE2(int32_t *dest, const int32_t *src, const size_t count, const int32_t na, const int32_t replacement){
+    const __m128i vna = _mm_set1_epi32(na);
+    const __m128i vreplacement = _mm_set1_epi32(replacement);
+    __m128i found = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+      __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m128i isNA = _mm_cmpeq_epi32(val, vna);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_and_si128(isNA, vreplacement), _mm_andnot_si128(isNA, val)));
+      found = _mm_or_si128(found, isNA);
+    }
+    return replaceScalar(dest + i, src + i, count - i, na, replacement) || _mm_movemask_epi8(found) != 0;
+  }
+
+  /** SSE2 has no 64 bit compare: two 64 bit lanes are equal if both of their 32 bit halves are
+   * @param[in] a first pair of 64 bit values
+   * @param[in] b second pair of 64 bit values
+   * @return all bits set in the lanes where a and b are equal, clear elsewhere
+   */
+  inline __m128i equal64SSE2(const __m128i &a, const __m128i &b){
+    __m128i eq = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+
+  /** Checks doubles for NA two at a time with SSE2
+   * @param[in] vals doubles to check
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @return true if any of the doubles is NA
+   */
+  bool containsSSE2(const double *vals, const size_t count, const uint64_t mask, const uint64_t na){
+    const __m128i vmask = _mm_set1_epi64x(static_cast<long long>(mask));
+    const __m128i vna = _mm_set1_epi64x(static_cast<long long>(na));
+    __m128i found = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2){
+      __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vals + i));
+      found = _mm_or_si128(found, equal64SSE2(_mm_and_si128(val, vmask), vna));
+    }
+    return _mm_movemask_epi8(found) != 0 || containsScalar(vals + i, count - i, mask, na);
+  }
+
+  /** Copies doubles two at a time with SSE2, blending the replacement into the lanes that are NA
+   * @param[out] dest array of count doubles to fill, may be src
+   * @param[in] src doubles to copy
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @param[in] replacement value NA doubles are replaced with
+   * @return true if any NA was replaced
+   */
+  bool replaceSSE2(double *dest, const double *src, const size_t count, const uint64_t mask, const uint64_t na, const double replacement){
+    const __m128i vmask = _mm_set1_epi64x(static_cast<long long>(mask));
+    const __m128i vna = _mm_set1_epi64x(static_cast<long long>(na));
+    const __m128i vreplacement = _mm_set1_epi64x(static_cast<long long>(doubleBits(&replacement)));
+    __m128i found = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2){
+      __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m128i isNA = equal64SSE2(_mm_and_si128(val, vmask), vna);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_and_si128(isNA, vreplacement), _mm_andnot_si128(isNA, val)));
+      found = _mm_or_si128(found, isNA);
+    }
+    return replaceScalar(dest + i, src + i, count - i, mask, na, replacement) || _mm_movemask_epi8(found) != 0;
+  }
+#endif
+
+#ifdef RCLIENT_USE_AVX2
+  /** Checks integers for NA eight at a time with AVX2. Only called once the processor is known to support AVX2
+   * @param[in] vals integers to check
+   * @param[in] count number of integers
+   * @param[in] na NA representation to look for
+   * @return true if any of the integers is NA
+   */
+  __attribute__((target("avx2")))
+  bool containsAVX2(const int32_t *vals, const size_t count, const int32_t na){
+    const __m256i vna = _mm256_set1_epi32(na);
+    __m256i found = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+      found = _mm256_or_si256(found, _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(vals + i)), vna));
+    return _mm256_movemask_epi8(found) != 0 || containsScalar(vals + i, count - i, na);
+  }
+
+  /** Copies integers eight at a time with AVX2, blending the replacement into the lanes that are NA
+   * @param[out] dest array of count integers to fill, may be src
+   * @param[in] src integers to copy
+   * @param[in] count number of integers
+   * @param[in] na NA representation to replace
+   * @param[in] replacement value NA integers are replaced with
+   * @return true if any NA was replaced
+   */
+  __attribute__((target("avx2")))
+  bool replaceAVX2(int32_t *dest, const int32_t *src, const size_t count, const int32_t na, const int32_t replacement){
+    const __m256i vna = _mm256_set1_epi32(na);
+    const __m256i vreplacement = _mm256_set1_epi32(replacement);
+    __m256i found = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+      __m256i val = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      __m256i isNA = _mm256_cmpeq_epi32(val, vna);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_blendv_epi8(val, vreplacement, isNA));
+      found = _mm256_or_si256(found, isNA);
+    }
+    return replaceScalar(dest + i, src + i, count - i, na, replacement) || _mm256_movemask_epi8(found) != 0;
+  }
+
+  /** Checks doubles for NA four at a time with AVX2
+   * @param[in] vals doubles to check
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @return true if any of the doubles is NA
+   */
+  __attribute__((target("avx2")))
+  bool containsAVX2(const double *vals, const size_t count, const uint64_t mask, const uint64_t na){
+    const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i vna = _mm256_set1_epi64x(static_cast<long long>(na));
+    __m256i found = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+      __m256i val = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vals + i));
+      found = _mm256_or_si256(found, _mm256_cmpeq_epi64(_mm256_and_si256(val, vmask), vna));
+    }
+    return _mm256_movemask_epi8(found) != 0 || containsScalar(vals + i, count - i, mask, na);
+  }
+
+  /** Copies doubles four at a time with AVX2, blending the replacement into the lanes that are NA
+   * @param[out] dest array of count doubles to fill, may be src
+   * @param[in] src doubles to copy
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @param[in] replacement value NA doubles are replaced with
+   * @return true if any NA was replaced
+   */
+  __attribute__((target("avx2")))
+  bool replaceAVX2(double *dest, const double *src, const size_t count, const uint64_t mask, const uint64_t na, const double replacement){
+    const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i vna = _mm256_set1_epi64x(static_cast<long long>(na));
+    const __m256i vreplacement = _mm256_set1_epi64x(static_cast<long long>(doubleBits(&replacement)));
+    __m256i found = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+      __m256i val = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      __m256i isNA = _mm256_cmpeq_epi64(_mm256_and_si256(val, vmask), vna);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_blendv_epi8(val, vreplacement, isNA));
+      found = _mm256_or_si256(found, isNA);
+    }
+    return replaceScalar(dest + i, src + i, count - i, mask, na, replacement) || _mm256_movemask_epi8(found) != 0;
+  }
+#endif
+
+  /** kernels for one instruction set
+   */
+  struct Kernels{
+    bool (*containsInteger)(const int32_t*, size_t, int32_t);
+    bool (*replaceInteger)(int32_t*, const int32_t*, size_t, int32_t, int32_t);
+    bool (*containsDouble)(const double*, size_t, uint64_t, uint64_t);
+    bool (*replaceDouble)(double*, const double*, size_t, uint64_t, uint64_t, double);
+  };
+
+  /** Picks the widest kernels this processor runs
+   * @return kernels to use
+   */
+  Kernels selectKernels(){
+#ifdef RCLIENT_USE_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+      Kernels avx2 = {containsAVX2, replaceAVX2, containsAVX2, replaceAVX2};
+      return avx2;
+    }
+#endif
+#ifdef RCLIENT_USE_SSE2
+    Kernels sse2 = {containsSSE2, replaceSSE2, containsSSE2, replaceSSE2};
+    return sse2;
+#else
+    Kernels scalar = {containsScalar, replaceScalar, containsScalar, replaceScalar};
+    return scalar;
+#endif
+  }
+
+  /** @return kernels selected on first use
+   */
+  const Kernels& kernels(){
+    static const Kernels selected = selectKernels();
+    return selected;
+  }
+
+} // close namespace
+
+
+namespace rclient{
+
+  /** Checks integers for NA
+   * @param[in] vals integers to check
+   * @param[in] count number of integers
+   * @param[in] na NA representation to look for
+   * @return true if any of the integers is NA
+   */
+  bool NATranslator::contains(const int32_t *vals, const size_t count, const int32_t na){
+    return kernels().containsInteger(vals, count, na);
+  }
+
+  /** Checks doubles for NA
+   * @param[in] vals doubles to check
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @return true if any of the doubles is NA
+   */
+  bool NATranslator::contains(const double *vals, const size_t count, const uint64_t mask, const uint64_t na){
+    return kernels().containsDouble(vals, count, mask, na);
+  }
+
+  /** Copies integers, replacing NA values
+   * @param[out] dest array of count integers to fill, may be src to translate in place
+   * @param[in] src integers to copy
+   * @param[in] count number of integers
+   * @param[in] na NA representation to replace
+   * @param[in] replacement value NA integers are replaced with
+   */
+  void NATranslator::translate(int32_t *dest, const int32_t *src, const size_t count, const int32_t na, const int32_t replacement){
+    const Kernels &simd = kernels();
+    const bool identity = (na == replacement);
+    bool sawNA = false;
+    for(size_t i = 0; i < count; i += BlockLength){
+      size_t n = std::min(BlockLength, count - i);
+      if(!identity && (sawNA || simd.containsInteger(src + i, n, na)))
+        sawNA = simd.replaceInteger(dest + i, src + i, n, na, replacement);
+      else if(dest != src)
+        memcpy(dest + i, src + i, n * sizeof(int32_t));
+    }
+  }
+
+  /** Copies doubles bit for bit, replacing NA values
+   * @param[out] dest array of count doubles to fill, may be src to translate in place
+   * @param[in] src doubles to copy
+   * @param[in] count number of doubles
+   * @param[in] mask bits of each double to compare
+   * @param[in] na masked bits of an NA double
+   * @param[in] replacement value NA doubles are replaced with
+   */
+  void NATranslator::translate(double *dest, const double *src, const size_t count, const uint64_t mask, const uint64_t na,
+                               const double replacement){
+    const Kernels &simd = kernels();
+    const bool identity = (mask == ~static_cast<uint64_t>(0) && na == doubleBits(&replacement));
+    bool sawNA = false;
+    for(size_t i = 0; i < count; i += BlockLength){
+      size_t n = std::min(BlockLength, count - i);
+      if(!identity && (sawNA || simd.containsDouble(src + i, n, mask, na)))
+        sawNA = simd.replaceDouble(dest + i, src + i, n, mask, na, replacement);
+      else if(dest != src)
+        memcpy(dest + i, src + i, n * sizeof(double));
+    }
+  }
+
+} // close namespace
@@ -0,0 +1,48 @@
+/*  NATranslator: Vectorized Replacement of NA Values in Integer and Double Arrays
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_NA_TRANSLATOR_H_INCLUDED
+#define RCLIENT_NA_TRANSLATOR_H_INCLUDED
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace rclient{
+
+  /** Finds and replaces NA values in whole arrays, for translating between R's and the consumer's NA representations.
+   * Doubles are matched on their bits rather than by value, since NA is a NaN: a value is NA if (bits & mask) == na.
+   * Arrays are processed in blocks; a block without NA is copied with memcpy, others are compared and blended.
+   * Uses AVX2 when the processor supports it, otherwise SSE2 where the compiler targets it, otherwise plain loops.
+   * Define RCLIENT_NO_SIMD to build only the plain loops.
+   */
+  class RCLIENT_API NATranslator{
+
+  public:
+    static bool contains(const int32_t *vals, const size_t count, const int32_t na);
+    static bool contains(const double *vals, const size_t count, const uint64_t mask, const uint64_t na);
+
+    static void translate(int32_t *dest, const int32_t *src, const size_t count, const int32_t na, const int32_t replacement);
+    static void translate(double *dest, const double *src, const size_t count, const uint64_t mask, const uint64_t na,
+                          const double replacement);
+
+  private:
+    NATranslator(); // static functions only
+  };
+
+} // close namespace
+#endif
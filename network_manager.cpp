@@ -17,52 +17,205 @@
 #include "network_manager.h"
 #include "endian_converter.h"
 #include "network_error.h"
+#include "network_writer.h"
+#include "rarena.h"
+#include "resolver_cache.h"
+#include "rexp_decoder.h"
+#include "thread_sync.h"
+#include "traffic_recorder.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h> // for TCP_NODELAY
+#include <sys/un.h> // for sockaddr_un
 #include <unistd.h>
+#include <poll.h>
+#include <fcntl.h> // for O_NONBLOCK
 #include <inttypes.h>
 #include <sstream>
 #include <string.h>
 #include <cerrno> // for errno
+#include <climits> // for IOV_MAX
+#include <algorithm> // for std::min
+#include <new> // for std::bad_alloc
 
 // MSG_NOSIGNAL is not defined on VMS, so define it to be an empty flag
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0
 #endif
 
+// IOV_MAX is not always defined, so fall back to the POSIX minimum
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+// EPROTO is not defined on every platform, so fall back to a generic error
+#ifndef EPROTO
+#define EPROTO EINVAL
+#endif
+
+// zero-copy sends are only available on Linux
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define RCLIENT_USE_ZEROCOPY
+#include <linux/errqueue.h> // for sock_extended_err
+#endif
+
 namespace{
  
-  /** traverses possible IPs in addrinfo, attempting to connect to one.
+  /** Orders resolved addresses so that address families alternate, starting with the family resolved first.
+   * A host that is unreachable over one family then only delays every other connection attempt.
    * @param[in] host addrinfo containing host IPs
-   * @param[in] sock socket to establish connection
-   */
-  bool findConnection(rclient_addrinfo *host, const int sock){
-    rclient_addrinfo *res = NULL;
-    // traverse possible IP's
-    for(res = host; res != NULL; res = res->ai_next){
-      // attempt to connect
-      if(! ::connect(sock, res->ai_addr, res->ai_addrlen)){
-	// connection succeeded
-	return true;
-      }
+   * @return addresses in the order they should be tried
+   */
+  RVECTORTYPE<const rclient_addrinfo*> interleaveFamilies(const rclient_addrinfo *host){
+    RVECTORTYPE<const rclient_addrinfo*> first, other;
+    for(const rclient_addrinfo *res = host; res != NULL; res = res->ai_next){
+      if(res->ai_family == host->ai_family)
+        first.push_back(res);
+      else
+        other.push_back(res);
     }
-    return false;
+    RVECTORTYPE<const rclient_addrinfo*> ordered;
+    for(size_t i = 0; i < first.size() || i < other.size(); ++i){
+      if(i < first.size()) ordered.push_back(first[i]);
+      if(i < other.size()) ordered.push_back(other[i]);
+    }
+    return ordered;
   }
 
-  /** Custom deleter for rclient_addrinfo calls freeaddrinfo
-   * @param[in] host addrinfo to be freed
+  /** Switches a socket between blocking and non-blocking mode
+   * @param[in] sock socket to change
+   * @param[in] blocking whether calls on the socket should block
+   * @return False if the mode could not be changed, with errno set
    */
-  void addrinfo_deleter(rclient_addrinfo *host){
-    freeaddrinfo(host);
+  bool setBlocking(const int sock, const bool blocking){
+    int flags = fcntl(sock, F_GETFL, 0);
+    if(flags < 0) return false;
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl(sock, F_SETFL, flags) == 0;
   }
 
+  /** Sockets of the connection attempts in progress. Closes the ones that are left when destroyed.
+   */
+  class ConnectAttempts{
+
+  public:
+    ConnectAttempts(){}
+    ~ConnectAttempts(){
+      for(size_t i = 0; i < fds.size(); ++i)
+        close(fds[i].fd);
+    }
+
+    /** starts watching a socket whose connection is in progress
+     * @param[in] sock socket to watch, closed by ConnectAttempts
+     */
+    void add(const int sock){
+      struct pollfd pfd;
+      pfd.fd = sock;
+      pfd.events = POLLOUT;
+      pfd.revents = 0;
+      fds.push_back(pfd);
+    }
+
+    /** closes the socket of a failed attempt
+     * @param[in] i position of the attempt in fds
+     */
+    void drop(const size_t i){
+      close(fds[i].fd);
+      fds.erase(fds.begin() + i);
+    }
+
+    /** hands the socket of an attempt over to the caller
+     * @param[in] i position of the attempt in fds
+     * @return socket, no longer closed by ConnectAttempts
+     */
+    int release(const size_t i){
+      int sock = fds[i].fd;
+      fds.erase(fds.begin() + i);
+      return sock;
+    }
+
+    RVECTORTYPE<struct pollfd> fds; // one per attempt, watched for the end of the connection attempt
+
+  private:
+    ConnectAttempts(const ConnectAttempts&); // non construction-copyable
+    ConnectAttempts& operator=(const ConnectAttempts&); // non-copyable
+  };
+
+  /** size of the buffer used to serialize streaming entries while they are sent
+   */
+  const size_t StreamChunkLength = 262144;
+
+  /** number of chunk buffers a zero-copy stream cycles through, so that serializing continues while the kernel holds earlier chunks
+   */
+  const size_t ZeroCopyChunks = 16;
+
+  /** send flag requesting a zero-copy send, 0 where unsupported
+   */
+#ifdef RCLIENT_USE_ZEROCOPY
+  const int ZeroCopyFlag = MSG_ZEROCOPY;
+#else
+  const int ZeroCopyFlag = 0;
+#endif
+
+  /** @param[in] entries entries of a request
+   * @return True if any of the entries is serialized while it is sent
+   */
+  bool hasStreamingEntry(const RVECTORTYPE<rclient::RPacket::PacketEntry> &entries){
+    for(size_t i = 0; i < entries.size(); ++i)
+      if(entries[i].isStreaming()) return true;
+    return false;
+  }
+
+  /** crypt() returns a static buffer, so only one thread may call it at a time
+   */
+  rclient::Mutex crypt_mutex;
+
+  /** host prefix selecting a unix domain socket, followed by the socket's path
+   */
+  const char UnixPrefix[] = "unix://";
+  const size_t UnixPrefixLength = sizeof(UnixPrefix) - 1;
+
   /** size of string initially sent from RServe
    */
   const int RserveIDLength = 32;
 
+  /** size of the buffer used to read ahead of the data requested from RServe
+   */
+  const size_t ReadAheadLength = 65536;
+
+
+  /** Deleter of the response bodies allocated by NetworkManager::allocate_response
+   * @param[in] body response body
+   */
+  void delete_response(unsigned char *body){
+    delete[] body;
+  }
+
+
+  /** Determines the total length of the packet entry starting at pos, including its 4 or 8 byte header
+   * @param[in] buf buffer holding the response body
+   * @param[in] size number of bytes in buf
+   * @param[in] pos position of the entry header in buf
+   * @param[out] length number of bytes in the entry, including header
+   * @return False if the entry header or data would run past the end of buf, True otherwise
+   */
+  bool parseEntryLength(const unsigned char *buf, const size_t size, const size_t pos, size_t &length){
+    size_t header_length = (buf[pos] & rclient::RPacket::PacketEntry::DT_LARGE ? 8:4);
+    if(size - pos < header_length) return false;
+
+    // entry length is a little-endian 3 or 7 byte integer following the type
+    uint64_t data_length = 0;
+    for(size_t i = 1; i < header_length; ++i)
+      data_length |= (uint64_t) buf[pos + i] << ((i - 1) * 8);
+
+    if(size - pos - header_length < data_length) return false;
+    length = header_length + data_length;
+    return true;
+  }
+
 
   /** Parse ID String sent from RServe and compare it to RClient's compatibility.
    * A flag can be set to accept any protocol, but the ID must contain "RSrv" and "QAP1"
@@ -89,12 +242,50 @@ namespace{
 
 namespace rclient{
 
+  /** NetworkWriter that sends each chunk to RServe as soon as it fills
+   * With zero-copy sends, each chunk stays untouched until the kernel releases it, while writing continues in a spare buffer.
+   */
+  class NetworkManager::SocketWriter : public NetworkWriter{
+  public:
+    SocketWriter(NetworkManager &netman, const bool zeroCopy):NetworkWriter(StreamChunkLength), m_NetMan(netman), m_bZeroCopy(zeroCopy), m_iNext(0){
+      if(zeroCopy){
+        m_vecSpares.resize(ZeroCopyChunks - 1);
+        m_vecReleasedAt.resize(ZeroCopyChunks - 1, netman.m_iZeroCopySent);
+      }
+    }
+  protected:
+    virtual void flushChunk(const unsigned char *data, const size_t length){
+      if(!m_bZeroCopy){
+        m_NetMan.send_to_rserve(data, length, MSG_NOSIGNAL, "Streamed RPacket Entry Data.");
+        return;
+      }
+      m_NetMan.send_to_rserve(data, length, MSG_NOSIGNAL | ZeroCopyFlag, "Streamed RPacket Entry Data.");
+      // continue in the oldest spare once the kernel has released it, keeping the chunk just sent as a spare
+      m_NetMan.wait_zero_copy(m_vecReleasedAt[m_iNext]);
+      swapBuffer(m_vecSpares[m_iNext]);
+      m_vecReleasedAt[m_iNext] = m_NetMan.m_iZeroCopySent;
+      m_iNext = (m_iNext + 1) % m_vecSpares.size();
+    }
+  private:
+    NetworkManager &m_NetMan;
+    const bool m_bZeroCopy; // whether chunks are sent with zero-copy sends
+    RVECTORTYPE<RVECTORTYPE<unsigned char> > m_vecSpares; // chunks that may still be held by the kernel
+    RVECTORTYPE<uint32_t> m_vecReleasedAt; // m_iZeroCopySent once each spare was sent
+    size_t m_iNext; // spare to continue in after the next chunk
+  };
+
+
   /** Constructor stores host IP and port and will connect on first submit call
-   * @param[in] host Rserve IP address
-   * @param[in] port Port that Rserve is listening on
+   * @param[in] host Rserve IP address, or "unix://" followed by the path of the unix socket Rserve is listening on
+   * @param[in] port Port that Rserve is listening on. Ignored for unix sockets
    * @param[in] allowAnyVersion Whether or not to allow connection to any version of RServe. Otherwise only version 0103 is permitted.
+   * @param[in] options socket settings to apply each time a connection is established
    */
-  NetworkManager::NetworkManager(const RSTRINGTYPE &server_host, const int server_port, const bool allowAnyVersion): m_sHost(server_host), m_iPort(server_port), m_iSock(-1), m_bAnyVersion(allowAnyVersion) {}
+  NetworkManager::NetworkManager(const RSTRINGTYPE &server_host, const int server_port, const bool allowAnyVersion, const ConnectionOptions &options):
+    m_sHost(server_host), m_iPort(server_port), m_bUnixSocket(server_host.compare(0, UnixPrefixLength, UnixPrefix) == 0),
+    m_iSock(-1), m_bAnyVersion(allowAnyVersion), m_options(options), m_iReadBegin(0), m_iReadEnd(0),
+    m_iSendBegin(0), m_iRecvHeaderLength(0), m_iRecvBodySize(0), m_iRecvBodyLength(0), m_bZeroCopy(false), m_iZeroCopySent(0), m_iZeroCopyDone(0), m_iTraceConnection(0),
+    m_pMetrics(options.metrics ? options.metrics : RMAKE_SHARED<ClientMetrics>()), m_bConnectedBefore(false) {}
 
 
   /** Destructor attempts to disconnect from Rserve using disconnect()
@@ -105,7 +296,8 @@ namespace rclient{
 
 
   /** Disconnects from the Rserver if the NetworkManager is connected
-   * If NetworkManager is connected and fails to disconnect, a NetworkError is thrown
+   * If NetworkManager is connected and fails to disconnect, a NetworkError is thrown.
+   * Queued requests and responses not yet received are discarded; the next request connects again
    */
   void NetworkManager::disconnect(){
     // return if already disconnected
@@ -114,6 +306,15 @@ namespace rclient{
     // close socket
     close(m_iSock);
     m_iSock = -1;
+    // discard anything read ahead from the old connection
+    m_iReadBegin = m_iReadEnd = 0;
+    // discard queued requests and partially received responses
+    m_vecSendQueue.clear();
+    m_iSendBegin = 0;
+    m_iRecvHeaderLength = m_iRecvBodySize = m_iRecvBodyLength = 0;
+    m_pRecvBody.reset();
+    // their responses will never arrive
+    m_inFlight.clear();
     // NetworkManager is disconnected
     return;
   }
@@ -125,6 +326,7 @@ namespace rclient{
    * @param[in] error_str String corresponding to error_num (used if error_num is not errno)
    */
   void NetworkManager::throw_network_error(const std::string &description, const int error_num, const RSTRINGTYPE &error_str){
+    m_pMetrics->recordError(error_str.empty() ? error_num : 0);
     disconnect();
     if(error_str.empty())
       throw NetworkError(description, error_num, error_str);
@@ -141,22 +343,81 @@ namespace rclient{
   void NetworkManager::send_to_rserve(const unsigned char *buf, const size_t len, const int flags, const std::string &description){
     ssize_t netStatus;
     size_t i = 0;
+    int sendFlags = flags;
     while(i < len){
-      netStatus = ::send(m_iSock, &buf[i], len-i, flags);
+      netStatus = ::send(m_iSock, &buf[i], len-i, sendFlags);
       if(netStatus <= 0){
         // if netStatus is 0, then errno was not set. Assume connection was reset by peer
         if(netStatus == 0)
           throw_network_error(std::string("Error occured while trying to send: " + description), ECONNRESET);
         // error occured, try again if it was EINTR
         if(errno == EINTR) continue;
+        // the kernel ran out of memory to track zero-copy sends, so copy instead
+        if(errno == ENOBUFS && (sendFlags & ZeroCopyFlag)){
+          sendFlags &= ~ZeroCopyFlag;
+          continue;
+        }
         // otherwise throw with errno
         throw_network_error(std::string("Error occured while trying to send: " + description), errno);
       }
+      if(sendFlags & ZeroCopyFlag)
+        ++m_iZeroCopySent;
       i += netStatus;
     }
   }
 
 
+  /** sends a list of buffers over connected socket with as few calls to sendmsg() as possible
+   * Partial writes are resumed from the first unsent byte. iov is consumed as data is sent.
+   * Throws exception if not all of the data could be sent.
+   * @param[in,out] iov buffers to be sent to RServe, in order
+   * @param[in] flags flags to use for sendmsg()
+   * @param[in] description string explaning what is being sent. Used for throwing exception if an error occurs.
+   */
+  void NetworkManager::send_to_rserve(RVECTORTYPE<struct iovec> &iov, const int flags, const std::string &description){
+    ssize_t netStatus;
+    size_t first = 0;
+    int sendFlags = flags;
+    while(true){
+      // skip over buffers that have been sent completely
+      while(first < iov.size() && iov[first].iov_len == 0) ++first;
+      if(first >= iov.size()) return;
+
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov[first];
+      msg.msg_iovlen = std::min(iov.size() - first, (size_t) IOV_MAX);
+
+      netStatus = ::sendmsg(m_iSock, &msg, sendFlags);
+      if(netStatus <= 0){
+        // if netStatus is 0, then errno was not set. Assume connection was reset by peer
+        if(netStatus == 0)
+          throw_network_error(std::string("Error occured while trying to send: " + description), ECONNRESET);
+        // error occured, try again if it was EINTR
+        if(errno == EINTR) continue;
+        // the kernel ran out of memory to track zero-copy sends, so copy instead
+        if(errno == ENOBUFS && (sendFlags & ZeroCopyFlag)){
+          sendFlags &= ~ZeroCopyFlag;
+          continue;
+        }
+        // otherwise throw with errno
+        throw_network_error(std::string("Error occured while trying to send: " + description), errno);
+      }
+      if(sendFlags & ZeroCopyFlag)
+        ++m_iZeroCopySent;
+
+      // advance past the bytes that were sent
+      size_t sent = netStatus;
+      for(size_t i = first; sent > 0; ++i){
+        size_t n = std::min(sent, iov[i].iov_len);
+        iov[i].iov_base = (char*) iov[i].iov_base + n;
+        iov[i].iov_len -= n;
+        sent -= n;
+      }
+    }
+  }
+
+
   /** sends data over connected socket and throws exception if bytes sent does not match expected size
    * @param[out] buf buffer to fill with data from RServe
    * @param[in] len length of buf to be sent
@@ -182,58 +443,383 @@ namespace rclient{
   }
 
 
-  /** Establishes a connection with a Rserve
-   * If connection fails, sock is set to -1 and a NetworkError is thrown
-   * Otherwise, the sock is set accordingly
+  /** reads data from the connected socket, waiting no later than deadline for it to arrive
+   * Throws a NetworkError with ETIMEDOUT if the data has not all arrived by the deadline
+   * @param[out] buf buffer to fill with data from RServe
+   * @param[in] len number of bytes to read into buf
+   * @param[in] deadline time in milliseconds (see RequestTracer::now) to give up at
+   * @param[in] description string explaning what is being read. Used for throwing exception if an error occurs.
    */
-  void NetworkManager::connect_to_rserve(){
-    // return if already connected
-    if(m_iSock >= 0) return;
+  void NetworkManager::recv_before(unsigned char *buf, const size_t len, const long long deadline, const std::string &description){
+    size_t i = 0;
+    while(i < len){
+      const long long remaining = deadline - RequestTracer::now() / 1000;
+      if(remaining <= 0)
+        throw_network_error(std::string("Timed out while receiving: " + description), ETIMEDOUT);
+      struct pollfd pfd;
+      pfd.fd = m_iSock;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int stat = ::poll(&pfd, 1, (int) std::min(remaining, (long long) INT_MAX));
+      if(stat < 0 && errno != EINTR)
+        throw_network_error(std::string("Error occured while receiving: " + description), errno);
+      if(stat <= 0) continue;
 
-    // bind socket
-    m_iSock = ::socket(AF_INET, SOCK_STREAM, 0);
-    if(m_iSock < 0){
-      throw_network_error("ERROR:: Failed to obtain socket.\n", errno);
+      // take only what has arrived, so that the next wait is bounded by the deadline as well
+      ssize_t netStatus = ::recv(m_iSock, &buf[i], len - i, MSG_DONTWAIT);
+      if(netStatus == 0)
+        throw_network_error(std::string("Error occured while receiving: " + description), ECONNRESET);
+      if(netStatus < 0){
+        if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+        throw_network_error(std::string("Error occured while receiving: " + description), errno);
+      }
+      i += netStatus;
     }
+  }
 
-    // resolve hostname and establish connection
-    rclient_addrinfo *host = NULL;
-    rclient_addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
 
-    std::stringstream port;
-    port << m_iPort;
-    int stat = getaddrinfo(m_sHost.c_str(), port.str().c_str(), &hints, &host);
-    if(stat != 0){
+  /** reads data from the connected socket, serving it from the read-ahead buffer where possible
+   * Small reads are satisfied by filling the read-ahead buffer with a single large recv().
+   * Reads larger than the read-ahead buffer go directly into buf once the buffered data is used up.
+   * @param[out] buf buffer to fill with data from RServe
+   * @param[in] len number of bytes to read into buf
+   * @param[in] description string explaning what is being read. Used for throwing exception if an error occurs.
+   * @return number of bytes read into buf
+   */
+  size_t NetworkManager::recv_buffered(unsigned char *buf, const size_t len, const std::string &description){
+    size_t i = 0;
+    while(i < len){
+      // serve from data that has already been read
+      size_t buffered = m_iReadEnd - m_iReadBegin;
+      if(buffered > 0){
+        size_t n = std::min(buffered, len - i);
+        memcpy(&buf[i], &m_vecReadAhead[m_iReadBegin], n);
+        m_iReadBegin += n;
+        i += n;
+        continue;
+      }
+
+      // large remainder, read straight into the destination
+      if(len - i >= ReadAheadLength){
+        i += recv_from_rserve(&buf[i], len - i, 0, description);
+        break;
+      }
+
+      // refill the read-ahead buffer with whatever is available, at least enough to finish this read
+      m_vecReadAhead.resize(ReadAheadLength);
+      m_iReadBegin = 0;
+      m_iReadEnd = recv_some(&m_vecReadAhead[0], ReadAheadLength, len - i, description);
+    }
+    return i;
+  }
+
+
+  /** reads up to len bytes without blocking, serving them from the read-ahead buffer where possible
+   * @param[out] buf buffer to fill with data from RServe
+   * @param[in] len size of buf
+   * @param[in] readSocket whether to read from the socket once the read-ahead buffer is empty
+   * @param[in] description string explaning what is being read. Used for throwing exception if an error occurs.
+   * @return number of bytes read into buf, 0 if no data is available yet
+   */
+  size_t NetworkManager::recv_available(unsigned char *buf, const size_t len, const bool readSocket, const std::string &description){
+    if(m_iReadEnd == m_iReadBegin){
+      if(!readSocket) return 0;
+      // large reads go straight into the destination
+      unsigned char *dest = buf;
+      size_t dest_len = len;
+      if(len < ReadAheadLength){
+        m_vecReadAhead.resize(ReadAheadLength);
+        dest = &m_vecReadAhead[0];
+        dest_len = ReadAheadLength;
+      }
+      ssize_t netStatus;
+      do{
+        netStatus = ::recv(m_iSock, dest, dest_len, MSG_DONTWAIT);
+      } while(netStatus < 0 && errno == EINTR);
+      if(netStatus == 0)
+        throw_network_error(std::string("Error occured while receiving: " + description), ECONNRESET);
+      if(netStatus < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        throw_network_error(std::string("Error occured while receiving: " + description), errno);
+      }
+      if(dest == buf) return netStatus;
+      m_iReadBegin = 0;
+      m_iReadEnd = netStatus;
+    }
+
+    size_t n = std::min(m_iReadEnd - m_iReadBegin, len);
+    memcpy(buf, &m_vecReadAhead[m_iReadBegin], n);
+    m_iReadBegin += n;
+    return n;
+  }
+
+
+  /** reads at least min_len and at most len bytes from the connected socket
+   * @param[out] buf buffer to fill with data from RServe
+   * @param[in] len size of buf
+   * @param[in] min_len minimum number of bytes to read before returning
+   * @param[in] description string explaning what is being read. Used for throwing exception if an error occurs.
+   * @return number of bytes read into buf
+   */
+  size_t NetworkManager::recv_some(unsigned char *buf, const size_t len, const size_t min_len, const std::string &description){
+    ssize_t netStatus;
+    size_t i = 0;
+    while (i < min_len){
+      netStatus = ::recv(m_iSock, &buf[i], len-i, 0);
+      if(netStatus <= 0){
+        // if netStatus is 0, then errno was not set. Assume connection was reset by peer
+        if(netStatus == 0)
+          throw_network_error(std::string("Error occured while receiving: " + description), ECONNRESET);
+        // error occured, try again if it was EINTR
+        if(errno == EINTR) continue;
+        // otherwise throw with errno
+        throw_network_error(std::string("Error occured while receiving: " + description), errno);
+      }
+      i += netStatus;
+    }
+    return i;
+  }
+
+
+  /** sets an integer socket option
+   * If the option cannot be set, the connection is closed and a NetworkError is thrown
+   * @param[in] sock socket to set the option on
+   * @param[in] level protocol level of the option (e.g. SOL_SOCKET, IPPROTO_TCP)
+   * @param[in] option option to set
+   * @param[in] value value of the option
+   * @param[in] description name of the option. Used for throwing exception if an error occurs.
+   */
+  void NetworkManager::set_socket_option(const int sock, const int level, const int option, const int value, const std::string &description){
+    if(::setsockopt(sock, level, option, &value, sizeof(value)) != 0)
+      throw_network_error(std::string("ERROR:: Failed to set socket option " + description + ".\n"), errno);
+  }
+
+
+  /** Applies m_options to a socket. Settings left at their defaults are not touched.
+   * Called before connecting so that buffer sizes are in effect for the TCP handshake.
+   * @param[in] sock socket to configure
+   */
+  void NetworkManager::apply_socket_options(const int sock){
+    if(m_options.sendBufferSize > 0)
+      set_socket_option(sock, SOL_SOCKET, SO_SNDBUF, m_options.sendBufferSize, "SO_SNDBUF");
+    if(m_options.receiveBufferSize > 0)
+      set_socket_option(sock, SOL_SOCKET, SO_RCVBUF, m_options.receiveBufferSize, "SO_RCVBUF");
+
+    // remaining settings only apply to TCP
+    if(m_bUnixSocket) return;
+    if(m_options.tcpNoDelay)
+      set_socket_option(sock, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+#ifdef TCP_QUICKACK
+    if(m_options.tcpQuickAck)
+      set_socket_option(sock, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+
+    if(!m_options.keepAlive) return;
+    set_socket_option(sock, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+#ifdef TCP_KEEPIDLE
+    if(m_options.keepAliveIdle > 0)
+      set_socket_option(sock, IPPROTO_TCP, TCP_KEEPIDLE, m_options.keepAliveIdle, "TCP_KEEPIDLE");
+#endif
+#ifdef TCP_KEEPINTVL
+    if(m_options.keepAliveInterval > 0)
+      set_socket_option(sock, IPPROTO_TCP, TCP_KEEPINTVL, m_options.keepAliveInterval, "TCP_KEEPINTVL");
+#endif
+#ifdef TCP_KEEPCNT
+    if(m_options.keepAliveCount > 0)
+      set_socket_option(sock, IPPROTO_TCP, TCP_KEEPCNT, m_options.keepAliveCount, "TCP_KEEPCNT");
+#endif
+  }
+
+
+  /** Opens a TCP socket and connects it to m_sHost:m_iPort
+   * Every resolved address is tried in parallel with non-blocking sockets, alternating address families. A new
+   * attempt starts every m_options.connectStagger milliseconds, or as soon as the others have failed. The first
+   * connection to be established is kept and the other attempts are abandoned.
+   * If no connection is established by the deadline, or every attempt fails, a NetworkError is thrown
+   * @param[in] deadline time in milliseconds (see RequestTracer::now) to give up at, ignored if m_options.connectTimeout is 0
+   */
+  void NetworkManager::connect_inet(const long long deadline){
+    // resolve hostname, reusing the addresses found by an earlier connect
+    int stat = 0;
+    RSHARED_PTR<const rclient_addrinfo> host = ResolverCache::instance().resolve(m_sHost, m_iPort, stat);
+    if(!host){
       // error occured
       throw_network_error("ERROR:: Failed to obtain host address.\n", stat, gai_strerror(stat));
     }
-    // create wrapper for host to make sure it is freed using freeaddrinfo().
-    RSHARED_PTR<rclient_addrinfo> tofreehost(host, addrinfo_deleter);
-    
-    // try to connect
-    if (!findConnection(host, m_iSock)){
+    const RVECTORTYPE<const rclient_addrinfo*> addresses = interleaveFamilies(host.get());
+
+    ConnectAttempts attempts;
+    size_t next = 0; // next address to try
+    int lastError = ECONNREFUSED;
+    long long now = RequestTracer::now() / 1000;
+    long long nextStart = now;
+    int winner = -1;
+    while(winner < 0){
+      // start the next attempt when it is due, or right away if no attempt is in progress
+      if(next < addresses.size() && (now >= nextStart || attempts.fds.empty())){
+        const rclient_addrinfo *res = addresses[next++];
+        int sock = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if(sock < 0){
+          lastError = errno;
+          continue;
+        }
+        attempts.add(sock);
+        apply_socket_options(sock);
+        if(!setBlocking(sock, false)){
+          lastError = errno;
+          attempts.drop(attempts.fds.size() - 1);
+          continue;
+        }
+        if(::connect(sock, res->ai_addr, res->ai_addrlen) == 0){
+          winner = attempts.release(attempts.fds.size() - 1);
+          break;
+        }
+        if(errno != EINPROGRESS){
+          lastError = errno;
+          attempts.drop(attempts.fds.size() - 1);
+          continue;
+        }
+        nextStart = now + m_options.connectStagger;
+        continue;
+      }
+
+      // the cached addresses may be stale, so resolve the host again on the next connect
+      if(attempts.fds.empty()){
+        ResolverCache::instance().invalidate(m_sHost, m_iPort);
+        throw_network_error("ERROR:: Failed to connect to host.\n", lastError);
+      }
+      if(m_options.connectTimeout > 0 && now >= deadline){
+        ResolverCache::instance().invalidate(m_sHost, m_iPort);
+        throw_network_error("ERROR:: Timed out connecting to host.\n", ETIMEDOUT);
+      }
+
+      // wait for an attempt to finish, until the next attempt or the deadline is due
+      long long timeout = -1;
+      if(next < addresses.size())
+        timeout = nextStart - now;
+      if(m_options.connectTimeout > 0 && (timeout < 0 || deadline - now < timeout))
+        timeout = deadline - now;
+      stat = ::poll(&attempts.fds[0], attempts.fds.size(), (int) timeout);
+      if(stat < 0 && errno != EINTR)
+        throw_network_error("ERROR:: Failed to connect to host.\n", errno);
+
+      for(size_t i = 0; stat > 0 && i < attempts.fds.size();){
+        if(!attempts.fds[i].revents){
+          ++i;
+          continue;
+        }
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if(::getsockopt(attempts.fds[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+          error = errno;
+        if(error == 0){
+          winner = attempts.release(i);
+          break;
+        }
+        // a failed attempt lets the next address start without waiting its turn
+        lastError = error;
+        attempts.drop(i);
+        nextStart = now;
+      }
+      now = RequestTracer::now() / 1000;
+    }
+
+    // remaining attempts are closed when they go out of scope
+    m_iSock = winner;
+    if(!setBlocking(m_iSock, true))
+      throw_network_error("ERROR:: Failed to connect to host.\n", errno);
+  }
+
+
+  /** Opens a unix domain socket and connects it to the path following "unix://" in m_sHost
+   * If connection fails, sock is set to -1 and a NetworkError is thrown
+   */
+  void NetworkManager::connect_unix(){
+    const RSTRINGTYPE path = m_sHost.substr(UnixPrefixLength);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.empty() || path.size() >= sizeof(address.sun_path))
+      throw_network_error("ERROR:: Invalid unix socket path.\n", ENAMETOOLONG);
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    // bind socket
+    m_iSock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(m_iSock < 0){
+      throw_network_error("ERROR:: Failed to obtain socket.\n", errno);
+    }
+    apply_socket_options(m_iSock);
+
+    if(::connect(m_iSock, (struct sockaddr*) &address, sizeof(address)) != 0){
       // error occured
       throw_network_error("ERROR:: Failed to connect to host.\n", errno);
     }
+  }
+
+
+  /** Establishes a connection with a Rserve
+   * If connection fails, sock is set to -1 and a NetworkError is thrown
+   * Otherwise, the sock is set accordingly
+   */
+  void NetworkManager::connect_to_rserve(){
+    // return if already connected
+    if(m_iSock >= 0) return;
+
+    // connecting and reading the server's ID share one deadline
+    const long long deadline = RequestTracer::now() / 1000 + m_options.connectTimeout;
+    if(m_bUnixSocket)
+      connect_unix();
+    else
+      connect_inet(deadline);
+
+    // zero-copy sends need kernel support, so they are left off rather than failing the connection
+    m_bZeroCopy = false;
+    m_iZeroCopySent = m_iZeroCopyDone = 0;
+#ifdef RCLIENT_USE_ZEROCOPY
+    if(m_options.zeroCopyThreshold > 0 && !m_bUnixSocket){
+      int enable = 1;
+      m_bZeroCopy = (::setsockopt(m_iSock, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0);
+    }
+#endif
 
     // connection was successful and socket is established
 
     // read 32-byte header sent by the server
     
     unsigned char serverID[RserveIDLength+1];
-    recv_from_rserve(serverID, RserveIDLength, 0, "RServe ID");
+    if(m_options.connectTimeout > 0)
+      recv_before(serverID, RserveIDLength, deadline, "RServe ID");
+    else
+      recv_from_rserve(serverID, RserveIDLength, 0, "RServe ID");
 
     serverID[RserveIDLength] = 0;
     m_sRserve_version = RSTRINGTYPE((char*) serverID);
 
+    if(m_options.recorder){
+      m_iTraceConnection = m_options.recorder->nextConnection();
+      m_options.recorder->record(m_iTraceConnection, TrafficRecorder::TR_HELLO, serverID, RserveIDLength, NULL, 0);
+    }
+
     // check version
     if(!versionMatch(m_sRserve_version, m_bAnyVersion)){
       // incompatible server
       throw_network_error("ERROR:: RServe version is incompatible with RClient.\n"); // close socket
     }
+    m_pMetrics->recordConnect(m_bConnectedBefore);
+    m_bConnectedBefore = true;
+  }
+
+
+  /** @return socket and connection settings the NetworkManager was constructed with
+   */
+  const ConnectionOptions& NetworkManager::getOptions() const{
+    return m_options;
+  }
+
+  /** @return counters of the traffic, which may be shared with other connections (see ConnectionOptions::metrics)
+   */
+  const ClientMetrics& NetworkManager::getMetrics() const{
+    return *m_pMetrics;
   }
 
 
@@ -252,6 +838,28 @@ namespace rclient{
   }
 
 
+  /** Checks whether the connection to RServe is still usable without sending a request.
+   * Does not try to connect. If RServe has closed the connection, or has sent data that was not requested,
+   * the NetworkManager disconnects.
+   * @return True if connected and idle, False otherwise
+   */
+  bool NetworkManager::isConnected(){
+    if(m_iSock < 0) return false;
+
+    // anything readable between requests means the peer hung up or the stream is out of step
+    struct pollfd pfd;
+    pfd.fd = m_iSock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int stat = ::poll(&pfd, 1, 0);
+    if(stat < 0 || (stat > 0 && pfd.revents) || m_iReadEnd > m_iReadBegin){
+      disconnect();
+      return false;
+    }
+    return true;
+  }
+
+
   /** Checks RServe version information to determine if authentication is required
    * If the client is not connected yet, then it will connect to retrieve Authentication type
    * @return True if authentication is required, False otherwise
@@ -317,26 +925,12 @@ namespace rclient{
   }
 
 
-  /** Sends Rpacket to connected Rserve and then waits for response
-   * If connection is not yet established, then it will do so before making the request
-   * submit can throw a NetworkError if the connection failed 
-   * Reads the 16 byte header to know the size of the packet
-   * Reads the remainder of the packet based on length designated by header
-   * Parses server's response into a new Rpacket to be returned
-   * @param[in] Rpacket to be sent to the Rserve
-   * @return Rpacket response sent back from the server
+  /** Serializes the QAP1Header of an RPacket for sending
+   * @param[in] packet request to send
+   * @param[out] networkHeader filled with the QAP1Header in network form
    */
-  RSHARED_PTR<const RPacket> NetworkManager::submit(RPacket &packet){
-    if(m_iSock < 0){
-      // if not connected, try to establish connection
-      connect_to_rserve();
-    }
-    
-    EndianConverter converter;
-
-    // send QAP1Header
+  void NetworkManager::make_header(RPacket &packet, RVECTORTYPE<uint8_t> &networkHeader){
     QAP1Header qap1_request = packet.getHeader();
-    RVECTORTYPE<uint8_t> networkHeader;
     int header_size = sizeof(uint32_t) * 4;
     networkHeader.resize(header_size);
     size_t pos = 0;
@@ -347,81 +941,615 @@ namespace rclient{
     qap1_request.getOffset(networkHeader, pos);
     pos += sizeof(uint32_t);
     qap1_request.getLength_highbits(networkHeader, pos);
+  }
+
+  /** @param[in] packet request about to be sent
+   * @return True if the request is large enough to be sent with zero-copy sends, and the connection supports them
+   */
+  bool NetworkManager::use_zero_copy(RPacket &packet) const{
+    if(!m_bZeroCopy) return false;
+    RSHARED_PTR<const RVECTORTYPE<RPacket::PacketEntry> > entries = packet.getEntries();
+    size_t length = 0;
+    for(size_t i = 0; i < entries->size(); ++i)
+      length += (*entries)[i].getLength();
+    return length >= (size_t) m_options.zeroCopyThreshold;
+  }
+
+  /** Waits until the kernel has released the data of zero-copy sends, so that it may be changed or freed.
+   * The kernel reports each release on the socket's error queue once the data has been acknowledged.
+   * Throws a NetworkError if the connection failed
+   * @param[in] sent value of m_iZeroCopySent after the last send to wait for
+   */
+  void NetworkManager::wait_zero_copy(const uint32_t sent){
+#ifdef RCLIENT_USE_ZEROCOPY
+    short events = 0;
+    while((int32_t) (sent - m_iZeroCopyDone) > 0){
+      unsigned char control[128];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if(::recvmsg(m_iSock, &msg, MSG_ERRQUEUE) < 0){
+        if(errno == EINTR) continue;
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+          throw_network_error("Error occured while waiting for zero-copy sends.", errno);
+        // the error queue is reported as POLLERR, so an empty queue after POLLERR or POLLHUP means the connection failed
+        if(events & (POLLERR | POLLHUP))
+          throw_network_error("Error occured while waiting for zero-copy sends.", ECONNRESET);
+        struct pollfd pfd;
+        pfd.fd = m_iSock;
+        pfd.events = 0;
+        pfd.revents = 0;
+        if(::poll(&pfd, 1, -1) < 0 && errno != EINTR)
+          throw_network_error("Error occured while waiting for zero-copy sends.", errno);
+        events = pfd.revents;
+        continue;
+      }
+      events = 0;
+
+      for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+        if(!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+          continue;
+        const struct sock_extended_err *err = (const struct sock_extended_err*) CMSG_DATA(cmsg);
+        // each notification covers the sends from ee_info to ee_data, which TCP reports in order
+        if(err->ee_origin == SO_EE_ORIGIN_ZEROCOPY && err->ee_errno == 0 && (int32_t) (err->ee_data + 1 - m_iZeroCopyDone) > 0)
+          m_iZeroCopyDone = err->ee_data + 1;
+      }
+    }
+#endif
+  }
+
+
+  /** Lays out an RPacket for sending: the QAP1Header in network form, followed by each entry in the data
+   * Must not be used for packets with streaming entries.
+   * @param[in] packet request to lay out. Must outlive the use of request
+   * @param[in] networkHeader QAP1Header of packet, from make_header. Must outlive the use of request
+   * @param[out] request buffers to be sent to RServe, in order
+   */
+  void NetworkManager::gather_request(RPacket &packet, RVECTORTYPE<uint8_t> &networkHeader, RVECTORTYPE<struct iovec> &request){
+    const int header_size = networkHeader.size();
+
+    RSHARED_PTR<const RVECTORTYPE<RPacket::PacketEntry> > entries = packet.getEntries();
+    request.resize(entries->size() + 1);
+    request[0].iov_base = &networkHeader[0];
+    request[0].iov_len = header_size;
+    for(size_t i = 0; i < entries->size(); ++i){
+      const RPacket::PacketEntry &entry = (*entries)[i];
+      request[i+1].iov_base = (void*) entry.getEntry();
+      request[i+1].iov_len = entry.getLength();
+    }
+  }
 
-    send_to_rserve(&networkHeader[0], header_size, MSG_NOSIGNAL, "QAP1Header.");
 
-    // send each entry in the data
-    for(size_t i = 0; i < packet.getEntries()->size(); ++i){
-      RPacket::PacketEntry entry = (*packet.getEntries())[i];
-      send_to_rserve(&entry.getEntry()[0], entry.getLength(), MSG_NOSIGNAL, "RPacket Entry Data.");
+  /** Builds the CMD_login payload for the authentication type RServe asked for. Passwords are salted with crypt() for "uc".
+   * If the client is not connected yet, then it will connect to retrieve the authentication type
+   * @param[in] user login username
+   * @param[in] pwd login password
+   * @param[out] loginfo payload to send with CMD_login
+   * @return False if no supported authentication type is offered, True otherwise
+   */
+  bool NetworkManager::getLoginInfo(const RSTRINGTYPE &user, const RSTRINGTYPE &pwd, RSTRINGTYPE &loginfo){
+    loginfo = user + "\n";
+    if (hasAuthorizationType("uc")){
+      // authorization with unix crypt
+      const RSTRINGTYPE key = getKey();
+      ScopedLock lock(crypt_mutex);
+      loginfo.append(crypt(pwd.c_str(), key.c_str()));
     }
+    else if (hasAuthorizationType("pt"))
+      // authorization with plain text
+      loginfo.append(pwd);
+    else
+      // cannot determine authorization type, unable to log in
+      return false;
+    return true;
+  }
+
+
+  /** Sends Rpacket to connected Rserve and then waits for response
+   * If connection is not yet established, then it will do so before making the request
+   * submit can throw a NetworkError if the connection failed 
+   * Must not be called while pipelined requests are awaiting their responses.
+   * @param[in] Rpacket to be sent to the Rserve
+   * @return Rpacket response sent back from the server
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::submit(RPacket &packet){
+    sendRequest(packet);
+    return receiveResponse();
+  }
+
+  /** Sends Rpacket to connected Rserve and then passes the REXPs in its response to handler as they are received
+   * See receiveResponse(REXPHandler&)
+   * @param[in] Rpacket to be sent to the Rserve
+   * @param[in] handler receives the REXPs in the response
+   * @return Rpacket response sent back from the server, without its REXPs
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::submit(RPacket &packet, REXPHandler &handler){
+    sendRequest(packet);
+    return receiveResponse(handler);
+  }
+
+
+  /** Sends Rpacket to Rserve without waiting for its response, so that several requests can be in flight at once.
+   * Rserve answers requests in the order they are sent, so each call must be matched by a later call to receiveResponse.
+   * If connection is not yet established, then it will do so before making the request.
+   * Throws a NetworkError if the connection failed, in which case responses to earlier requests are lost as well.
+   * The caller should bound the requests in flight: Rserve stops reading once its responses back up on the socket.
+   * @param[in] Rpacket to be sent to the Rserve
+   */
+  void NetworkManager::sendRequest(RPacket &packet){
+    if(m_iSock < 0){
+      // if not connected, try to establish connection
+      connect_to_rserve();
+    }
+
+    const long long sentAt = RequestTracer::now();
+    // the header is built once, for both the recorder and the send
+    RVECTORTYPE<uint8_t> networkHeader;
+    make_header(packet, networkHeader);
+    const bool zeroCopy = use_zero_copy(packet);
+    if(m_options.recorder)
+      m_options.recorder->record(m_iTraceConnection, networkHeader, packet);
+    if(hasStreamingEntry(*packet.getEntries())){
+      // serialize through a fixed-size buffer, so memory use does not grow with the size of the request
+      try{
+        SocketWriter writer(*this, zeroCopy);
+        writer.write(&networkHeader[0], networkHeader.size());
+        RSHARED_PTR<const RVECTORTYPE<RPacket::PacketEntry> > entries = packet.getEntries();
+        for(size_t i = 0; i < entries->size(); ++i)
+          (*entries)[i].writeTo(writer);
+        writer.flush();
+        // the writer's chunks are freed when it goes out of scope
+        if(zeroCopy)
+          wait_zero_copy(m_iZeroCopySent);
+      }
+      catch(...){
+        // part of the request may have been sent, so the connection cannot be used any more
+        disconnect();
+        throw;
+      }
+    }
+    else{
+      // gather QAP1Header and each entry in the data so the request goes out in a single write
+      RVECTORTYPE<struct iovec> request;
+      gather_request(packet, networkHeader, request);
+      send_to_rserve(request, MSG_NOSIGNAL | (zeroCopy ? ZeroCopyFlag : 0), "QAP1Header and RPacket Entry Data.");
+      // the caller may change or free the packet once sendRequest returns
+      if(zeroCopy)
+        wait_zero_copy(m_iZeroCopySent);
+    }
+    track_request(packet, sentAt);
+    if(m_options.tracer)
+      m_options.tracer->onPhase(RequestTracer::TP_SEND, packet.getCommand(), sentAt, RequestTracer::now());
  
-    // read QAP1Header
-    recv_from_rserve(&networkHeader[0], header_size, 0, "Response QAP1Header.");
+#ifdef TCP_QUICKACK
+    // the kernel may fall back to delayed acks, so re-enable quick acks before waiting on the response
+    if(m_options.tcpQuickAck && !m_bUnixSocket)
+      set_socket_option(m_iSock, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+  }
+
+
+  /** Waits for the response to the oldest request sent with sendRequest that has not been answered yet
+   * Reads the 16 byte header to know the size of the packet
+   * Reads the remainder of the packet based on length designated by header into a single buffer
+   * Parses server's response into a new Rpacket to be returned
+   * Throws a NetworkError if the connection failed
+   * @return Rpacket response sent back from the server
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::receiveResponse(){
+    RequestTracer *tracer = m_options.tracer.get();
+    const long long waitBegin = (tracer ? RequestTracer::now() : 0);
+    RVECTORTYPE<uint8_t> networkHeader;
+    const int header_size = sizeof(uint32_t) * 4;
+    networkHeader.resize(header_size);
+
+    // read QAP1Header, pulling as much of the response as is available into the read-ahead buffer
+    recv_buffered(&networkHeader[0], header_size, "Response QAP1Header.");
+    const long long receiveBegin = (tracer ? trace_phase(RequestTracer::TP_WAIT, waitBegin) : 0);
 
     // parse response into QAP1Header
     QAP1Header qap1_response(networkHeader); 
 
-    // swap endian of length to be readable by client
-    size_t responseLength = qap1_response.getLength();
-
-    // entry variables
-    RVECTORTYPE<RPacket::PacketEntry> entrylist;
-    RVECTORTYPE<unsigned char> responseBuffer;
-    size_t bytesRead = 0;
-
-    // read + parse each entry
-    while( bytesRead < responseLength){
-      responseBuffer.resize(sizeof(uint32_t)+1); // resize to header
-      // read 4 byte entry header
-      bytesRead += recv_from_rserve( &responseBuffer[0], sizeof(uint32_t), 0, "4-byte response entry header");
-
-      // if 8 byte header, read another 4 bytes, then rest of entry
-      if(responseBuffer[0] & RPacket::PacketEntry::DT_LARGE){
-	responseBuffer.resize(sizeof(uint64_t)+1); // resize to large header
-	// read another 4 bytes for header
-	bytesRead += recv_from_rserve(&responseBuffer[4], sizeof(uint32_t), 0, "8-byte response entry header");
-
-	// convert entry length to client endian to be readable
-	RVECTORTYPE<uint8_t> serialized_entry_length;
-	serialized_entry_length.resize(sizeof(uint64_t));
-	pos = 0;
-	memcpy(&serialized_entry_length[0], &responseBuffer[1], sizeof(uint64_t)-1);
-	memset(&serialized_entry_length[7], 0, 1);
-	size_t entryLength = converter.deserialize<uint64_t>(serialized_entry_length, pos);
-	responseBuffer.resize(sizeof(uint64_t) + entryLength); // resize to entry size
-
-	// read rest of entry
-	bytesRead += recv_from_rserve(&responseBuffer[8], entryLength, 0, "Response entry data (for DT_LARGE)");
-
-	// create RPacketEntry
-	entrylist.push_back(RPacket::PacketEntry(responseBuffer));
+    // read the whole response body at once, then parse entries from memory
+    RSHARED_PTR<unsigned char> responseBuffer = allocate_response(qap1_response.getLength());
+    const size_t responseLength = qap1_response.getLength();
+    if(responseLength > 0)
+      recv_buffered(responseBuffer.get(), responseLength, "Response entry data");
+    if(m_options.recorder)
+      record_response(networkHeader, responseBuffer.get(), responseLength);
+    if(tracer)
+      trace_phase(RequestTracer::TP_RECEIVE, receiveBegin);
+
+    return make_response(qap1_response, responseBuffer, responseLength);
+  }
+
+
+  /** Waits for the response to the oldest request sent with sendRequest that has not been answered yet,
+   * decoding each REXP entry straight from the received data instead of storing it.
+   * Other entries are kept in the returned RPacket.
+   * Throws a NetworkError if the connection failed or the response is malformed.
+   * If the handler throws, the connection is closed and the exception is passed on.
+   * @param[in] handler receives the REXPs in the response
+   * @return Rpacket response sent back from the server, without its REXPs
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::receiveResponse(REXPHandler &handler){
+    RequestTracer *tracer = m_options.tracer.get();
+    const long long waitBegin = (tracer ? RequestTracer::now() : 0);
+    RVECTORTYPE<uint8_t> networkHeader;
+    const int header_size = sizeof(uint32_t) * 4;
+    networkHeader.resize(header_size);
+    recv_buffered(&networkHeader[0], header_size, "Response QAP1Header.");
+    const long long receiveBegin = (tracer ? trace_phase(RequestTracer::TP_WAIT, waitBegin) : 0);
+    QAP1Header qap1_response(networkHeader);
+    if(qap1_response.getLength() > m_options.maxResponseLength || qap1_response.getLength() > (uint64_t)(size_t) -1)
+      throw_network_error("ERROR:: Response is too long.\n", EMSGSIZE);
+    const size_t responseLength = qap1_response.getLength();
+
+    // entries that are not REXPs
+    RSHARED_PTR<RVECTORTYPE<unsigned char> > responseBuffer = RMAKE_SHARED<RVECTORTYPE<unsigned char> >();
+    // the whole response, only kept when it is recorded
+    RVECTORTYPE<unsigned char> traceBuffer;
+    RVECTORTYPE<unsigned char> *trace = (m_options.recorder ? &traceBuffer : NULL);
+    try{
+      size_t bytesRead = 0;
+      while(bytesRead < responseLength){
+        unsigned char entryHeader[8];
+        recv_buffered(entryHeader, 4, "Response entry header.");
+        size_t header_length = (entryHeader[0] & RPacket::PacketEntry::DT_LARGE ? 8:4);
+        if(header_length == 8)
+          recv_buffered(&entryHeader[4], 4, "Response entry header.");
+
+        // entry length is a little-endian 3 or 7 byte integer following the type
+        uint64_t data_length = 0;
+        for(size_t i = 1; i < header_length; ++i)
+          data_length |= (uint64_t) entryHeader[i] << ((i - 1) * 8);
+        if(responseLength - bytesRead < header_length || responseLength - bytesRead - header_length < data_length)
+          throw_network_error("ERROR:: Malformed response entry.\n", EPROTO);
+
+        if((entryHeader[0] & RPacket::PacketEntry::DT_TYPE_MASK) == RPacket::PacketEntry::DT_SEXP){
+          if(trace)
+            trace->insert(trace->end(), entryHeader, entryHeader + header_length);
+          decode_entry(data_length, handler, trace);
+        }
+        else{
+          size_t pos = responseBuffer->size();
+          responseBuffer->resize(pos + header_length + data_length);
+          memcpy(&(*responseBuffer)[pos], entryHeader, header_length);
+          if(data_length > 0)
+            recv_buffered(&(*responseBuffer)[pos + header_length], data_length, "Response entry data");
+          if(trace)
+            trace->insert(trace->end(), responseBuffer->begin() + pos, responseBuffer->end());
+        }
+        bytesRead += header_length + data_length;
       }
+    }
+    catch(...){
+      // the rest of the response was not read, so the connection cannot be used any more
+      disconnect();
+      throw;
+    }
+    if(trace)
+      record_response(networkHeader, (traceBuffer.empty() ? NULL : &traceBuffer[0]), traceBuffer.size());
+    if(tracer)
+      trace_phase(RequestTracer::TP_RECEIVE, receiveBegin);
+    return make_response(qap1_response, RSHARED_PTR<const unsigned char>(responseBuffer, (responseBuffer->empty() ? NULL : &(*responseBuffer)[0])),
+                         responseBuffer->size());
+  }
+
 
-      // otherwise 4 byte header, read rest of entry
-      else {
-	responseBuffer[4] = 0;
-	// determine 3byte entry size
-	RVECTORTYPE<uint8_t> serialized_entry_length;
-	serialized_entry_length.resize(sizeof(uint32_t));
-	pos = 0;
-	memcpy(&serialized_entry_length[0], &responseBuffer[1], sizeof(uint32_t)-1);
-	memset(&serialized_entry_length[3], 0, 1);
-	uint32_t entryLength = converter.deserialize<uint32_t>(serialized_entry_length, pos);
-	responseBuffer.resize(sizeof(uint32_t) + entryLength); // resize to entry size
-
-	// read rest of entry
-	bytesRead += recv_from_rserve(&responseBuffer[4], entryLength, 0, "Response entry data");
-
-	// create RPacketEntry
-	entrylist.push_back(RPacket::PacketEntry(responseBuffer));
+  /** Feeds the data of a REXP entry to an REXPDecoder as it is received
+   * The data is decoded where it was received in the read-ahead buffer, without copying it.
+   * Throws a NetworkError if the connection failed or the REXP does not fill the entry exactly.
+   * @param[in] length number of bytes in the entry, not including its header
+   * @param[in] handler receives the REXP
+   * @param[out] trace if not null, the entry data is appended to it
+   */
+  void NetworkManager::decode_entry(const uint64_t length, REXPHandler &handler, RVECTORTYPE<unsigned char> *trace){
+    REXPDecoder decoder(handler);
+    uint64_t remaining = length;
+    while(remaining > 0){
+      if(m_iReadEnd == m_iReadBegin){
+        m_vecReadAhead.resize(ReadAheadLength);
+        m_iReadBegin = 0;
+        m_iReadEnd = recv_some(&m_vecReadAhead[0], ReadAheadLength, 1, "Response entry data");
       }
+      size_t n = (size_t) std::min((uint64_t) (m_iReadEnd - m_iReadBegin), remaining);
+      size_t used = decoder.feed(&m_vecReadAhead[m_iReadBegin], n);
+      if(trace)
+        trace->insert(trace->end(), m_vecReadAhead.begin() + m_iReadBegin, m_vecReadAhead.begin() + m_iReadBegin + n);
+      m_iReadBegin += n;
+      remaining -= n;
+      if(used < n)
+        throw_network_error("ERROR:: Malformed REXP in response entry.\n", EPROTO);
+    }
+    if(!decoder.isComplete())
+      throw_network_error("ERROR:: Malformed REXP in response entry.\n", EPROTO);
+  }
+
+
+  /** Allocates the buffer a response body is received into, without initialising it
+   * Throws a NetworkError if the response is longer than m_options.maxResponseLength or the memory cannot be allocated,
+   * since the connection cannot be used once the response is left unread.
+   * @param[in] length number of bytes in the response body
+   * @return buffer of length bytes, null if length is 0
+   */
+  RSHARED_PTR<unsigned char> NetworkManager::allocate_response(const uint64_t length){
+    if(length > m_options.maxResponseLength || length > (uint64_t)(size_t) -1)
+      throw_network_error("ERROR:: Response is too long.\n", EMSGSIZE);
+    if(length == 0)
+      return RSHARED_PTR<unsigned char>();
+    try{
+      return RSHARED_PTR<unsigned char>(new unsigned char[static_cast<size_t>(length)], &delete_response);
+    }
+    catch(const std::bad_alloc&){
+      throw_network_error("ERROR:: Could not allocate the response.\n", ENOMEM);
+    }
+    return RSHARED_PTR<unsigned char>();
+  }
+
+
+  /** Frames a response body into entries
+   * Throws a NetworkError if an entry runs past the end of the body
+   * @param[in] qap1_response QAP1Header of the response
+   * @param[in] responseBuffer whole response body
+   * @param[in] responseLength number of bytes in responseBuffer
+   * @return Rpacket whose entries are views into responseBuffer
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::make_response(const QAP1Header &qap1_response, const RSHARED_PTR<const unsigned char> &responseBuffer,
+                                                           const size_t responseLength){
+    // entries are views into responseBuffer, which is owned by the returned RPacket
+    RSHARED_PTR<RVECTORTYPE<RPacket::PacketEntry> > entrylist = RMAKE_SHARED<RVECTORTYPE<RPacket::PacketEntry> >();
+    size_t bytesParsed = 0;
+    while(bytesParsed < responseLength){
+      size_t entryLength = 0;
+      if(!parseEntryLength(responseBuffer.get(), responseLength, bytesParsed, entryLength))
+        throw_network_error("ERROR:: Malformed response entry.\n", EPROTO);
+
+      // create RPacketEntry
+      entrylist->push_back(RPacket::PacketEntry(responseBuffer, bytesParsed, entryLength));
+      bytesParsed += entryLength;
     }
   
+    // the response answers the oldest request in flight
+    if(!m_inFlight.empty()){
+      const InFlight &request = m_inFlight.front();
+      m_pMetrics->recordResponse(request.command, RequestTracer::now() - request.sentAt,
+                                 sizeof(uint32_t) * 4 + qap1_response.getLength(), entrylist->size());
+      m_inFlight.pop_front();
+    }
+
+    // the REXPs decoded from the response share one arena, released with them
+    RSHARED_PTR<RArena> arena;
+    if(m_options.decodeArenaSize > 0)
+      arena = RArena::create(static_cast<size_t>(m_options.decodeArenaSize));
+
     // return RPacket created out of entries
-    return RMAKE_SHARED<RPacket>(qap1_response, entrylist);
+    return RMAKE_SHARED<RPacket>(qap1_response, responseBuffer, entrylist, arena);
+  }
+
+
+  /** Counts a request that has been sent or queued, and remembers when, to measure the latency of its response
+   * @param[in] packet request
+   * @param[in] sentAt time the request started to be sent, see RequestTracer::now
+   */
+  void NetworkManager::track_request(RPacket &packet, const long long sentAt){
+    InFlight request;
+    request.command = packet.getCommand();
+    request.sentAt = sentAt;
+    m_inFlight.push_back(request);
+    m_pMetrics->recordRequest(sizeof(uint32_t) * 4 + packet.getHeader().getLength(), packet.getEntries()->size());
   }
 
+
+  /** Reports a phase of the response to the oldest request in flight to m_options.tracer, which must be set
+   * @param[in] phase phase that ended
+   * @param[in] begin time the phase began, see RequestTracer::now
+   * @return time the phase ended
+   */
+  long long NetworkManager::trace_phase(const RequestTracer::ePhase phase, const long long begin){
+    const long long end = RequestTracer::now();
+    m_options.tracer->onPhase(phase, (m_inFlight.empty() ? 0 : m_inFlight.front().command), begin, end);
+    return end;
+  }
+
+
+  /** Records a received response with m_options.recorder
+   * @param[in] networkHeader QAP1Header of the response, as received
+   * @param[in] body data section of the response, may be null if length is 0
+   * @param[in] length number of bytes in body
+   */
+  void NetworkManager::record_response(const RVECTORTYPE<uint8_t> &networkHeader, const unsigned char *body, const size_t length){
+    m_options.recorder->record(m_iTraceConnection, TrafficRecorder::TR_RESPONSE, &networkHeader[0], networkHeader.size(), body, length);
+  }
+
+
+  /** Returns the connection socket, connecting to Rserve first if necessary, so that it can be watched with poll/epoll.
+   * The socket must only be read and written through the NetworkManager.
+   * getSocket() will throw a NetworkError if the connection fails
+   * @return connected socket
+   */
+  int NetworkManager::getSocket(){
+    if(m_iSock < 0){
+      // if not connected, try to establish connection
+      connect_to_rserve();
+    }
+    return m_iSock;
+  }
+
+
+  /** Appends an Rpacket to the outgoing queue without sending anything. Use flushRequests to send it.
+   * The request is copied, so the packet may be modified or destroyed once queueRequest returns.
+   * Requests queued this way must be answered with pollResponse, and not mixed with submit/sendRequest.
+   * If connection is not yet established, then it will do so first. Throws a NetworkError if the connection fails.
+   * @param[in] Rpacket to be sent to the Rserve
+   */
+  void NetworkManager::queueRequest(RPacket &packet){
+    if(m_iSock < 0){
+      // if not connected, try to establish connection
+      connect_to_rserve();
+    }
+    RVECTORTYPE<uint8_t> networkHeader;
+    make_header(packet, networkHeader);
+    const size_t begin = m_vecSendQueue.size();
+    m_vecSendQueue.insert(m_vecSendQueue.end(), networkHeader.begin(), networkHeader.end());
+    BufferWriter writer(m_vecSendQueue);
+    RSHARED_PTR<const RVECTORTYPE<RPacket::PacketEntry> > entries = packet.getEntries();
+    for(size_t i = 0; i < entries->size(); ++i)
+      (*entries)[i].writeTo(writer);
+    writer.flush();
+    if(m_options.recorder)
+      m_options.recorder->record(m_iTraceConnection, TrafficRecorder::TR_REQUEST, &m_vecSendQueue[begin], m_vecSendQueue.size() - begin, NULL, 0);
+    track_request(packet, RequestTracer::now());
+  }
+
+
+  /** Sends as much of the outgoing queue as the socket accepts without blocking
+   * Throws a NetworkError if the connection failed
+   * @return True if the outgoing queue is now empty, False if the socket is full
+   */
+  bool NetworkManager::flushRequests(){
+    while(m_iSendBegin < m_vecSendQueue.size()){
+      ssize_t netStatus = ::send(m_iSock, &m_vecSendQueue[m_iSendBegin], m_vecSendQueue.size() - m_iSendBegin, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if(netStatus <= 0){
+        if(netStatus == 0)
+          throw_network_error("Error occured while trying to send: Queued requests.", ECONNRESET);
+        if(errno == EINTR) continue;
+        if(errno == EAGAIN || errno == EWOULDBLOCK) return false;
+        throw_network_error("Error occured while trying to send: Queued requests.", errno);
+      }
+      m_iSendBegin += netStatus;
+    }
+    m_vecSendQueue.clear();
+    m_iSendBegin = 0;
+
+#ifdef TCP_QUICKACK
+    // the kernel may fall back to delayed acks, so re-enable quick acks before waiting on the response
+    if(m_options.tcpQuickAck && !m_bUnixSocket)
+      set_socket_option(m_iSock, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+    return true;
+  }
+
+
+  /** @return True if queued requests have not been completely sent yet
+   */
+  bool NetworkManager::hasQueuedRequests() const{
+    return m_iSendBegin < m_vecSendQueue.size();
+  }
+
+
+  /** Reads whatever part of the next response is available without blocking
+   * A partially received response is kept until a later call completes it.
+   * Throws a NetworkError if the connection failed or Rserve closed it
+   * @return the next response once it has been received completely, null otherwise
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::pollResponse(){
+    return poll_response(true);
+  }
+
+
+  /** Takes data from the outgoing queue so that the caller can send it. The data counts as sent once taken.
+   * Requests must have been queued with queueRequest, and their responses passed to receiveCompleted.
+   * @param[out] buf buffer to fill with queued data
+   * @param[in] length size of buf
+   * @return number of bytes copied into buf, 0 if nothing is queued
+   */
+  size_t NetworkManager::takeQueuedRequests(unsigned char *buf, const size_t length){
+    size_t n = std::min(length, m_vecSendQueue.size() - m_iSendBegin);
+    if(n > 0)
+      memcpy(buf, &m_vecSendQueue[m_iSendBegin], n);
+    m_iSendBegin += n;
+    if(m_iSendBegin == m_vecSendQueue.size()){
+      m_vecSendQueue.clear();
+      m_iSendBegin = 0;
+    }
+    return n;
+  }
+
+  /** Reports the result of sending data taken with takeQueuedRequests
+   * Throws a NetworkError and closes the connection if the send failed
+   * @param[in] result number of bytes sent, or a negative errno
+   */
+  void NetworkManager::sendCompleted(const int result){
+    if(result == 0)
+      throw_network_error("Error occured while trying to send: Queued requests.", ECONNRESET);
+    if(result < 0)
+      throw_network_error("Error occured while trying to send: Queued requests.", -result);
+  }
+
+  /** Passes on data the caller received from the socket, to be read with takeResponse
+   * Throws a NetworkError and closes the connection if the receive failed or Rserve closed the connection
+   * @param[in] data received data
+   * @param[in] result number of bytes in data, 0 if the connection was closed, or a negative errno
+   */
+  void NetworkManager::receiveCompleted(const unsigned char *data, const int result){
+    if(result == 0)
+      throw_network_error("Error occured while receiving: Response data.", ECONNRESET);
+    if(result < 0)
+      throw_network_error("Error occured while receiving: Response data.", -result);
+
+    // append to the data that has not been taken yet
+    if(m_iReadBegin == m_iReadEnd)
+      m_iReadBegin = m_iReadEnd = 0;
+    if(m_vecReadAhead.size() < m_iReadEnd + result)
+      m_vecReadAhead.resize(m_iReadEnd + result);
+    memcpy(&m_vecReadAhead[m_iReadEnd], data, result);
+    m_iReadEnd += result;
+  }
+
+  /** Same as pollResponse, but only uses data passed to receiveCompleted and never reads the socket
+   * @return the next response once it has been received completely, null otherwise
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::takeResponse(){
+    return poll_response(false);
+  }
+
+
+  /** Reads whatever part of the next response is available without blocking
+   * A partially received response is kept until a later call completes it.
+   * Throws a NetworkError if the connection failed or Rserve closed it
+   * @param[in] readSocket whether to read from the socket, or only use data that has already been received
+   * @return the next response once it has been received completely, null otherwise
+   */
+  RSHARED_PTR<const RPacket> NetworkManager::poll_response(const bool readSocket){
+    const size_t header_size = sizeof(uint32_t) * 4;
+    if(m_vecRecvHeader.size() != header_size)
+      m_vecRecvHeader.resize(header_size);
+
+    // read QAP1Header
+    while(m_iRecvHeaderLength < header_size){
+      size_t n = recv_available(&m_vecRecvHeader[m_iRecvHeaderLength], header_size - m_iRecvHeaderLength, readSocket, "Response QAP1Header.");
+      if(n == 0) return RSHARED_PTR<const RPacket>();
+      m_iRecvHeaderLength += n;
+      if(m_iRecvHeaderLength == header_size){
+        QAP1Header qap1_response(m_vecRecvHeader);
+        m_pRecvBody = allocate_response(qap1_response.getLength());
+        m_iRecvBodySize = qap1_response.getLength();
+        m_iRecvBodyLength = 0;
+      }
+    }
+
+    // read the response body
+    while(m_iRecvBodyLength < m_iRecvBodySize){
+      size_t n = recv_available(m_pRecvBody.get() + m_iRecvBodyLength, m_iRecvBodySize - m_iRecvBodyLength, readSocket, "Response entry data");
+      if(n == 0) return RSHARED_PTR<const RPacket>();
+      m_iRecvBodyLength += n;
+    }
+
+    // response is complete, get ready for the next one
+    QAP1Header qap1_response(m_vecRecvHeader);
+    RSHARED_PTR<unsigned char> responseBuffer;
+    responseBuffer.swap(m_pRecvBody);
+    const size_t responseLength = m_iRecvBodySize;
+    m_iRecvHeaderLength = 0;
+    m_iRecvBodySize = m_iRecvBodyLength = 0;
+    if(m_options.recorder)
+      record_response(m_vecRecvHeader, responseBuffer.get(), responseLength);
+    return make_response(qap1_response, responseBuffer, responseLength);
+  }
+
+
   // may need to add a submit_disconnect for detachedVoidEval in the future
 
 } // close namespace
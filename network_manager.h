@@ -19,40 +19,118 @@
 
 #include "config.h"
 #include "rpacket.h"
+#include "connection_options.h"
+#include "client_metrics.h"
+#include "request_tracer.h"
 #include <string>
+#include <deque>
+#include <sys/uio.h> // for iovec
 
 
 namespace rclient{
 
+  class REXPHandler;
+
   /** NetworkManager handles all network traffic between client and R server.
-   * Constructor stores host IP and port.
+   * Constructor stores host IP and port. A host of the form "unix:///path/to/socket" connects through a unix domain socket instead.
    * On first request to access the server (submit), the NetworkManager establishes the connection.
    * The connection is closed when the NetworkManager is deleted
    */
   class RCLIENT_API NetworkManager{
 
   public:
-    explicit NetworkManager(const RSTRINGTYPE &server_host, const int server_port = 6311, const bool allowAnyVersion = false);
+    explicit NetworkManager(const RSTRINGTYPE &server_host, const int server_port = 6311, const bool allowAnyVersion = false,
+                            const ConnectionOptions &options = ConnectionOptions());
     ~NetworkManager(); // make sure disconnected when destroyed
 
     const RSTRINGTYPE& getVersion();
+    bool isConnected();
+    void disconnect();
     bool isAuthorizationRequired();
     bool hasAuthorizationType(const RSTRINGTYPE &has_type);
     RSTRINGTYPE getKey();
+    bool getLoginInfo(const RSTRINGTYPE &user, const RSTRINGTYPE &pwd, RSTRINGTYPE &loginfo);
+    const ConnectionOptions& getOptions() const;
+    const ClientMetrics& getMetrics() const;
     RSHARED_PTR<const RPacket> submit(RPacket &packet);
+    RSHARED_PTR<const RPacket> submit(RPacket &packet, REXPHandler &handler);
+    void sendRequest(RPacket &packet);
+    RSHARED_PTR<const RPacket> receiveResponse();
+    RSHARED_PTR<const RPacket> receiveResponse(REXPHandler &handler);
+
+    // non-blocking interface, for driving the connection from an event loop
+    int getSocket();
+    void queueRequest(RPacket &packet);
+    bool flushRequests();
+    bool hasQueuedRequests() const;
+    RSHARED_PTR<const RPacket> pollResponse();
+
+    // completion-based interface, for event loops that perform the socket I/O themselves
+    size_t takeQueuedRequests(unsigned char *buf, const size_t length);
+    void sendCompleted(const int result);
+    void receiveCompleted(const unsigned char *data, const int result);
+    RSHARED_PTR<const RPacket> takeResponse();
   
   private:
+    class SocketWriter; // streams request data to RServe through a fixed-size buffer
+
+    /** request awaiting its response, for measuring its latency
+     */
+    struct InFlight{
+      uint32_t command; // RPacket::eCMD of the request
+      long long sentAt; // microseconds, see RequestTracer::now
+    };
+
     const RSTRINGTYPE m_sHost; // Rserve IP
     const int m_iPort; // Rserve port
+    const bool m_bUnixSocket; // whether m_sHost names a unix socket rather than a TCP host
     int m_iSock; // connection socket
     bool m_bAnyVersion; // whether or not to allow connection to any version of RServe
+    const ConnectionOptions m_options; // socket settings applied on every connect
 
     RSTRINGTYPE m_sRserve_version; // string response from server upon connecting
+    RVECTORTYPE<unsigned char> m_vecReadAhead; // data received from RServe but not yet consumed
+    size_t m_iReadBegin; // position of first unconsumed byte in m_vecReadAhead
+    size_t m_iReadEnd; // position after last received byte in m_vecReadAhead
+    RVECTORTYPE<unsigned char> m_vecSendQueue; // requests queued by queueRequest
+    size_t m_iSendBegin; // position of first unsent byte in m_vecSendQueue
+    RVECTORTYPE<uint8_t> m_vecRecvHeader; // QAP1Header of the response being read by pollResponse
+    size_t m_iRecvHeaderLength; // bytes of m_vecRecvHeader received so far
+    RSHARED_PTR<unsigned char> m_pRecvBody; // body of the response being read by pollResponse
+    size_t m_iRecvBodySize; // bytes in m_pRecvBody
+    size_t m_iRecvBodyLength; // bytes of m_pRecvBody received so far
+    bool m_bZeroCopy; // whether zero-copy sends are enabled on the connection
+    uint32_t m_iZeroCopySent; // zero-copy sends made on the connection
+    uint32_t m_iZeroCopyDone; // zero-copy sends whose data the kernel has released
+    uint32_t m_iTraceConnection; // id the connection is recorded under by m_options.recorder
+    const RSHARED_PTR<ClientMetrics> m_pMetrics; // counts the traffic, m_options.metrics if it is set
+    bool m_bConnectedBefore; // whether a connection has been established before, so the next one is a reconnect
+    std::deque<InFlight> m_inFlight; // requests sent or queued whose responses have not been received, oldest first
+
     void send_to_rserve(const unsigned char *buf, const size_t len, const int flags, const std::string &description);
+    void send_to_rserve(RVECTORTYPE<struct iovec> &iov, const int flags, const std::string &description);
     size_t recv_from_rserve(unsigned char *buf, const size_t len, const int flags, const std::string &description);
+    void recv_before(unsigned char *buf, const size_t len, const long long deadline, const std::string &description);
+    size_t recv_some(unsigned char *buf, const size_t len, const size_t min_len, const std::string &description);
+    size_t recv_buffered(unsigned char *buf, const size_t len, const std::string &description);
+    size_t recv_available(unsigned char *buf, const size_t len, const bool readSocket, const std::string &description);
+    bool use_zero_copy(RPacket &packet) const;
+    void wait_zero_copy(const uint32_t sent);
+    void make_header(RPacket &packet, RVECTORTYPE<uint8_t> &networkHeader);
+    void gather_request(RPacket &packet, RVECTORTYPE<uint8_t> &networkHeader, RVECTORTYPE<struct iovec> &request);
+    void track_request(RPacket &packet, const long long sentAt);
+    void decode_entry(const uint64_t length, REXPHandler &handler, RVECTORTYPE<unsigned char> *trace);
+    RSHARED_PTR<const RPacket> poll_response(const bool readSocket);
+    RSHARED_PTR<unsigned char> allocate_response(const uint64_t length);
+    RSHARED_PTR<const RPacket> make_response(const QAP1Header &qap1_response, const RSHARED_PTR<const unsigned char> &responseBuffer, const size_t responseLength);
+    long long trace_phase(const RequestTracer::ePhase phase, const long long begin);
+    void record_response(const RVECTORTYPE<uint8_t> &networkHeader, const unsigned char *body, const size_t length);
 
     void connect_to_rserve();
-    void disconnect();
+    void connect_inet(const long long deadline);
+    void connect_unix();
+    void apply_socket_options(const int sock);
+    void set_socket_option(const int sock, const int level, const int option, const int value, const std::string &description);
     void throw_network_error(const std::string &description, const int error_num = 0, const RSTRINGTYPE &error_str = "");
   };
 } // close namespace
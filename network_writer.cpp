@@ -0,0 +1,108 @@
+/*  NetworkWriter: Fixed-size buffer for serializing data that is flushed as it fills.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "network_writer.h"
+
+#include <string.h>
+#include <algorithm> // for std::min
+#include <stdexcept>
+
+namespace rclient{
+
+  /** constructor allocates the scratch buffer
+   * @param[in] capacity size of the scratch buffer in bytes, and the largest chunk passed to flushChunk
+   */
+  NetworkWriter::NetworkWriter(const size_t capacity):m_vecBuffer(std::max(capacity, (size_t) 8)), m_iUsed(0){}
+
+  /** destructor. Data that was not flushed is discarded
+   */
+  NetworkWriter::~NetworkWriter(){}
+
+
+  /** Copies data into the scratch buffer, flushing it whenever it fills
+   * @param[in] data bytes to write
+   * @param[in] length number of bytes in data
+   */
+  void NetworkWriter::write(const unsigned char *data, size_t length){
+    while(length > 0){
+      size_t available;
+      unsigned char *buf = reserve(available);
+      size_t n = std::min(available, length);
+      memcpy(buf, data, n);
+      commit(n);
+      data += n;
+      length -= n;
+    }
+  }
+
+  /** Returns the free part of the scratch buffer so data can be serialized into it directly.
+   * Flushes the buffer first if less than min_length bytes are free. Follow with commit.
+   * @param[out] available number of bytes that may be written to the returned buffer
+   * @param[in] min_length fewest bytes the caller needs, at most 8
+   * @return pointer to the free part of the scratch buffer
+   */
+  unsigned char* NetworkWriter::reserve(size_t &available, const size_t min_length){
+    if(min_length > 8)
+      throw std::logic_error("NetworkWriter can only reserve up to 8 bytes at a time.");
+    if(m_vecBuffer.size() - m_iUsed < min_length)
+      flush();
+    available = m_vecBuffer.size() - m_iUsed;
+    return &m_vecBuffer[m_iUsed];
+  }
+
+  /** Marks bytes written to the buffer returned by reserve as used
+   * @param[in] length number of bytes written, at most the number available
+   */
+  void NetworkWriter::commit(const size_t length){
+    m_iUsed += length;
+    if(m_iUsed == m_vecBuffer.size())
+      flush();
+  }
+
+  /** Passes everything written so far on to flushChunk
+   */
+  void NetworkWriter::flush(){
+    if(m_iUsed == 0) return;
+    size_t used = m_iUsed;
+    m_iUsed = 0;
+    flushChunk(&m_vecBuffer[0], used);
+  }
+
+  /** Exchanges the scratch buffer for another one, so that a chunk passed to flushChunk can stay in use after it returns.
+   * Only to be called from flushChunk, while the scratch buffer holds no unflushed data.
+   * @param[in,out] spare buffer to write into from now on, resized to the capacity. Receives the previous scratch buffer
+   */
+  void NetworkWriter::swapBuffer(RVECTORTYPE<unsigned char> &spare){
+    spare.resize(m_vecBuffer.size());
+    m_vecBuffer.swap(spare);
+  }
+
+
+
+  /** constructor
+   * @param[out] buffer vector that written data is appended to, once flushed
+   */
+  BufferWriter::BufferWriter(RVECTORTYPE<unsigned char> &buffer):NetworkWriter(65536), m_buffer(buffer){}
+
+  /** appends a chunk to the vector
+   * @param[in] data bytes to append
+   * @param[in] length number of bytes in data
+   */
+  void BufferWriter::flushChunk(const unsigned char *data, const size_t length){
+    m_buffer.insert(m_buffer.end(), data, data + length);
+  }
+
+} // close namespace
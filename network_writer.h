@@ -0,0 +1,69 @@
+/*  NetworkWriter: Fixed-size buffer for serializing data that is flushed as it fills.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_NETWORK_WRITER_H_INCLUDED
+#define RCLIENT_NETWORK_WRITER_H_INCLUDED
+
+#include "config.h"
+
+namespace rclient{
+
+  /** Serializes data into a fixed-size buffer and passes each full buffer on to flushChunk, so that
+   * data of any size can be encoded with constant memory.
+   * Data can be copied in with write, or serialized in place with reserve and commit.
+   * Subclasses decide where the chunks go. Call flush once everything has been written.
+   */
+  class RCLIENT_API NetworkWriter{
+
+  public:
+    explicit NetworkWriter(const size_t capacity);
+    virtual ~NetworkWriter();
+
+    void write(const unsigned char *data, size_t length);
+    unsigned char* reserve(size_t &available, const size_t min_length = 1);
+    void commit(const size_t length);
+    void flush();
+
+  protected:
+    virtual void flushChunk(const unsigned char *data, const size_t length) = 0;
+    void swapBuffer(RVECTORTYPE<unsigned char> &spare);
+
+  private:
+    NetworkWriter(const NetworkWriter &no_copy); // non construction-copyable
+    NetworkWriter& operator=(const NetworkWriter&); // non-copyable
+
+    RVECTORTYPE<unsigned char> m_vecBuffer; // scratch buffer
+    size_t m_iUsed; // bytes of m_vecBuffer written but not yet flushed
+  };
+
+
+  /** NetworkWriter that appends everything written to a vector
+   */
+  class RCLIENT_API BufferWriter : public NetworkWriter{
+
+  public:
+    explicit BufferWriter(RVECTORTYPE<unsigned char> &buffer);
+
+  protected:
+    virtual void flushChunk(const unsigned char *data, const size_t length);
+
+  private:
+    RVECTORTYPE<unsigned char> &m_buffer; // receives the data
+  };
+
+} // close namespace
+
+#endif
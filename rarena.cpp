@@ -0,0 +1,124 @@
+/*  RArena: Bump Allocator Releasing Everything Allocated From It at Once
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "rarena.h"
+
+#include <algorithm> // for std::min and std::max
+
+namespace{
+
+  // alignment of every allocation, enough for any type a REXP holds
+  const size_t Alignment = 16;
+
+  // chunks stop doubling at this size
+  const size_t MaxChunkSize = 1024 * 1024;
+
+} // close namespace
+
+
+namespace rclient{
+
+  /** Creates an arena. No memory is allocated until the first call to allocate
+   * @param[in] chunkSize bytes in the first chunk
+   * @return pointer holding a reference to the arena
+   */
+  RSHARED_PTR<RArena> RArena::create(const size_t chunkSize){
+    return RSHARED_PTR<RArena>(new RArena(chunkSize), &RArena::release);
+  }
+
+  /** constructor
+   * @param[in] chunkSize bytes in the first chunk
+   */
+  RArena::RArena(const size_t chunkSize):m_pNext(NULL), m_iRemaining(0), m_iChunkSize(std::max(chunkSize, Alignment)),
+                                         m_iAllocated(0), m_iReferences(1){}
+
+  /** destructor frees every chunk, and so everything allocated from the arena
+   */
+  RArena::~RArena(){
+    for(size_t i = 0; i < m_chunks.size(); ++i)
+      ::operator delete(m_chunks[i]);
+  }
+
+  /** Allocates memory that stays valid, and keeps the arena alive, until it is passed to deallocate
+   * @param[in] bytes number of bytes needed
+   * @return memory aligned to 16 bytes
+   */
+  void* RArena::allocate(const size_t bytes){
+    size_t size = (bytes + Alignment - 1) & ~(Alignment - 1);
+    if(size < bytes)
+      throw std::bad_alloc();
+
+    ScopedLock lock(m_mutex);
+    if(size > m_iRemaining){
+      // room is reserved for the chunk first, so that it cannot be lost if push_back throws
+      if(m_chunks.size() == m_chunks.capacity())
+        m_chunks.reserve(std::max(static_cast<size_t>(8), m_chunks.size() * 2));
+      if(size > m_iChunkSize / 2){
+        // large request: give it a chunk of its own and keep filling the current one
+        void *chunk = ::operator new(size);
+        m_chunks.push_back(chunk);
+        m_iAllocated += size;
+        ++m_iReferences;
+        return chunk;
+      }
+      m_pNext = static_cast<unsigned char*>(::operator new(m_iChunkSize));
+      m_chunks.push_back(m_pNext);
+      m_iRemaining = m_iChunkSize;
+      m_iChunkSize = std::min(m_iChunkSize * 2, std::max(m_iChunkSize, MaxChunkSize));
+    }
+    void *ptr = m_pNext;
+    ++m_iReferences;
+    m_iAllocated += size;
+    m_pNext += size;
+    m_iRemaining -= size;
+    return ptr;
+  }
+
+  /** Releases the reference held by an allocation. The memory is not reused; the chunks are freed with the last reference
+   * @param[in] ptr memory returned by allocate
+   */
+  void RArena::deallocate(void*){
+    release(this);
+  }
+
+  /** Drops a reference to an arena, destroying it if that was the last one
+   * @param[in] arena arena to release
+   */
+  void RArena::release(RArena *arena){
+    bool last;
+    {
+      ScopedLock lock(arena->m_mutex);
+      last = --arena->m_iReferences == 0;
+    }
+    if(last)
+      delete arena;
+  }
+
+  /** @return bytes handed out by allocate, rounded up to the alignment
+   */
+  size_t RArena::getBytesAllocated() const{
+    ScopedLock lock(m_mutex);
+    return m_iAllocated;
+  }
+
+  /** @return number of chunks allocated
+   */
+  size_t RArena::getChunkCount() const{
+    ScopedLock lock(m_mutex);
+    return m_chunks.size();
+  }
+
+} // close namespace
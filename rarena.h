@@ -0,0 +1,149 @@
+/*  RArena: Bump Allocator Releasing Everything Allocated From It at Once
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_RARENA_H_INCLUDED
+#define RCLIENT_RARENA_H_INCLUDED
+
+#include "config.h"
+#include "thread_sync.h"
+
+#include <new>
+#include <stddef.h>
+
+namespace rclient{
+
+  /** Hands out memory from large chunks by advancing a pointer, and frees all the chunks at once.
+   * deallocate does not reuse memory, so an arena suits objects that are created together and released together, such as the
+   * REXPs decoded from one response. Each allocation holds a reference to the arena until it is deallocated, as does the
+   * pointer returned by create; the chunks are freed when the last of these is released. Chunks start at chunkSize bytes and
+   * double up to 1MB; larger requests get a chunk of their own.
+   */
+  class RCLIENT_API RArena{
+
+  public:
+    static RSHARED_PTR<RArena> create(const size_t chunkSize = 64 * 1024);
+
+    void* allocate(const size_t bytes);
+    void deallocate(void *ptr);
+
+    size_t getBytesAllocated() const;
+    size_t getChunkCount() const;
+
+  private:
+    explicit RArena(const size_t chunkSize);
+    ~RArena();
+    RArena(const RArena &no_copy); // non construction-copyable
+    RArena& operator=(const RArena&); // non-copyable
+
+    static void release(RArena *arena);
+
+    RVECTORTYPE<void*> m_chunks; // every chunk, freed by the destructor
+    unsigned char *m_pNext; // next free byte in the current chunk
+    size_t m_iRemaining; // free bytes left in the current chunk
+    size_t m_iChunkSize; // size of the next chunk
+    size_t m_iAllocated; // bytes handed out, including alignment
+    size_t m_iReferences; // allocations not yet deallocated, plus one while the pointer from create is held
+    mutable Mutex m_mutex; // guards everything above, decoding may share an arena between threads
+  };
+
+
+  /** Allocator for containers and allocate_shared that takes memory from an RArena.
+   * Copies share a plain pointer to the arena; the allocations themselves keep it alive, so copying an allocator costs
+   * nothing and an object allocated from the arena stays valid after the arena's owner lets go of it.
+   */
+  template<typename T>
+  class RArenaAllocator{
+
+  public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind{
+      typedef RArenaAllocator<U> other;
+    };
+
+    /** constructor
+     * @param[in] arena arena to allocate from, must not be null
+     */
+    explicit RArenaAllocator(const RSHARED_PTR<RArena> &arena):m_pArena(arena.get()){}
+
+    /** constructor for other value types, sharing the arena of other
+     * @param[in] other allocator to share the arena of
+     */
+    template<typename U>
+    RArenaAllocator(const RArenaAllocator<U> &other):m_pArena(other.getArena()){}
+
+    /** @return arena allocated from
+     */
+    RArena* getArena() const{
+      return m_pArena;
+    }
+
+    /** @param[in] n number of values to allocate room for
+     * @return uninitialized room for n values
+     */
+    pointer allocate(const size_type n, const void* = 0){
+      if(n > max_size())
+        throw std::bad_alloc();
+      return static_cast<pointer>(m_pArena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(const pointer p, const size_type){
+      m_pArena->deallocate(p);
+    }
+
+    void construct(pointer p, const T &val){
+      new(static_cast<void*>(p)) T(val);
+    }
+
+    void destroy(pointer p){
+      p->~T();
+    }
+
+    size_type max_size() const{
+      return static_cast<size_type>(-1) / sizeof(T);
+    }
+
+    pointer address(reference val) const{
+      return &val;
+    }
+
+    const_pointer address(const_reference val) const{
+      return &val;
+    }
+
+    template<typename U>
+    bool operator==(const RArenaAllocator<U> &other) const{
+      return m_pArena == other.getArena();
+    }
+
+    template<typename U>
+    bool operator!=(const RArenaAllocator<U> &other) const{
+      return m_pArena != other.getArena();
+    }
+
+  private:
+    RArena *m_pArena; // arena to allocate from
+  };
+
+} // close namespace
+#endif
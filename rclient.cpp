@@ -15,17 +15,89 @@
  */
 
 #include "rclient.h"
+#include "async_submitter.h"
 #include <unistd.h>
+#include <string.h> // for memchr
 
 namespace rclient{
 
   /** On initialization, the RClient creates a NetworkManager with provided IP and port.
    * If consumers want to access multiple server, they must declare an RClient for each one.
-   * @param[in] host IP address of the Rserve
+   * @param[in] host IP address of the Rserve, or "unix://" followed by the path of the unix socket Rserve is listening on
    * @param[in] port Port that the Rserve is listening for new connections on (default 6311)
    * @param[in] allowAnyVersion Whether or not to allow connection to any version of RServe. Otherwise only version 0103 is permitted.
+   * @param[in] options socket settings (TCP_NODELAY, buffer sizes, keepalive...) applied on every connection to RServe
    */
-  RClient::RClient(const RSTRINGTYPE &host, const int port, const bool allowAnyVersion):m_NetMan(host,port, allowAnyVersion){}
+  RClient::RClient(const RSTRINGTYPE &host, const int port, const bool allowAnyVersion, const ConnectionOptions &options):m_NetMan(host,port, allowAnyVersion, options){}
+
+  /** Destructor waits for outstanding asynchronous requests to complete
+   */
+  RClient::~RClient(){}
+
+
+  /** Sends a request and waits for the response.
+   * If the I/O thread is running, the request is queued behind outstanding asynchronous requests to keep their order.
+   * @param[in] packet request to send
+   * @return RPacket response sent back from the server
+   */
+  RSHARED_PTR<const RPacket> RClient::submit(RPacket &packet){
+    AsyncSubmitter *async = async_submitter(false);
+    if(async)
+      return async->submit(RMAKE_SHARED<RPacket>(packet))->getResponse();
+    return m_NetMan.submit(packet);
+  }
+
+  /** Sends a request and passes the REXPs in its response to handler as they are received.
+   * If the I/O thread is running, the request is queued behind outstanding asynchronous requests and the handler is called on that thread.
+   * @param[in] packet request to send
+   * @param[in] handler receives the REXPs in the response
+   * @return RPacket response sent back from the server, without its REXPs
+   */
+  RSHARED_PTR<const RPacket> RClient::submit(RPacket &packet, REXPHandler &handler){
+    AsyncSubmitter *async = async_submitter(false);
+    if(async)
+      return async->submit(RMAKE_SHARED<RPacket>(packet), RSHARED_PTR<RCallback>(), &handler)->getResponse();
+    return m_NetMan.submit(packet, handler);
+  }
+
+  /** Queues a request for the I/O thread, starting the thread if needed
+   * @param[in] packet request to send
+   * @param[in] callback notified on the I/O thread when the request completes. May be null
+   * @return future that receives the response
+   */
+  RSHARED_PTR<RFuture> RClient::submitAsync(const RSHARED_PTR<RPacket> &packet, const RSHARED_PTR<RCallback> &callback){
+    return async_submitter(true)->submit(packet, callback);
+  }
+
+  /** Retrieves the I/O thread, starting it first if requested
+   * m_pAsync is only set once, under m_asyncMutex, so the returned pointer stays valid until the client is destroyed.
+   * @param[in] create whether to start the I/O thread if it is not running yet
+   * @return I/O thread, null if it is not running and create is false
+   */
+  AsyncSubmitter* RClient::async_submitter(const bool create){
+    ScopedLock lock(m_asyncMutex);
+    if(!m_pAsync && create)
+      m_pAsync.reset(new AsyncSubmitter(m_NetMan, m_netMutex));
+    return m_pAsync.get();
+  }
+
+
+  /** @return current time if a RequestTracer is installed, see RequestTracer::now. 0 otherwise, without reading the clock
+   */
+  long long RClient::trace_begin() const{
+    return (m_NetMan.getOptions().tracer ? RequestTracer::now() : 0);
+  }
+
+  /** Reports a phase that ended to the RequestTracer, if one is installed
+   * @param[in] phase phase that ended
+   * @param[in] command RPacket::eCMD of the request
+   * @param[in] begin time the phase began, from trace_begin
+   */
+  void RClient::trace_end(const RequestTracer::ePhase phase, const uint32_t command, const long long begin) const{
+    RequestTracer *tracer = m_NetMan.getOptions().tracer.get();
+    if(tracer)
+      tracer->onPhase(phase, command, begin, RequestTracer::now());
+  }
 
 
   /** Obtains authentication key from RServe, salts password, and sends login info.
@@ -34,33 +106,28 @@ namespace rclient{
    * @return TRUE if login was successful or if login is not required.
    */
   bool RClient::login(const RSTRINGTYPE &user, const RSTRINGTYPE &pwd){
- // check if authentication is required
-    if(!m_NetMan.isAuthorizationRequired())
-      return true;
-   
-    RSTRINGTYPE loginfo(user + "\n");
-    
-    if (m_NetMan.hasAuthorizationType("uc")){
-      // authorization with unix crypt
-      const RSTRINGTYPE key = m_NetMan.getKey();
-      loginfo.append(crypt(pwd.c_str(), key.c_str()));
-    }
-    else if (m_NetMan.hasAuthorizationType("pt"))
-      // authorization with plain text
-      loginfo.append(pwd);
-    else
+    RSTRINGTYPE loginfo;
+    {
+      ScopedLock netLock(m_netMutex);
+      // check if authentication is required
+      if(!m_NetMan.isAuthorizationRequired())
+        return true;
       // cannot determine authorization type, unable to log in
-      return false;
+      if(!m_NetMan.getLoginInfo(user, pwd, loginfo))
+        return false;
+    }
 
     // Authentication required
+    const long long encodeBegin = trace_begin();
     RVECTORTYPE<RPacket::PacketEntry> entrylist;
     entrylist.resize(1);
     entrylist[0] = RPacket::PacketEntry(loginfo);
     // make RPacket to be sent
     RPacket toSend(RPacket::CMD_login, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_login, encodeBegin);
     // submit packet and receive the response
 
-    RSHARED_PTR<const RPacket> response = m_NetMan.submit(toSend);
+    RSHARED_PTR<const RPacket> response = submit(toSend);
     // store response in RClient
     m_pLast_response = response;
     // return whether or not response was successful
@@ -72,14 +139,16 @@ namespace rclient{
    * @return TRUE if request successful, FALSE if the request failed 
    */
   bool RClient::shutdown(const RSTRINGTYPE &key){
+    const long long encodeBegin = trace_begin();
     RVECTORTYPE<RPacket::PacketEntry> entrylist;
     entrylist.resize(1);
     entrylist[0] = RPacket::PacketEntry(key);
     // make RPacket to be sent
     RPacket toSend(RPacket::CMD_shutdown, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_shutdown, encodeBegin);
     // submit packet and receive the response
 
-    RSHARED_PTR<const RPacket> response = m_NetMan.submit(toSend);
+    RSHARED_PTR<const RPacket> response = submit(toSend);
     // store response in RClient
     m_pLast_response = response;
     // return whether or not response was successful
@@ -88,21 +157,24 @@ namespace rclient{
 
 
   /** Sends request to server to set the given symbol
+   * expr is serialized a chunk at a time as it is sent, so large values do not need a second copy in memory
    * @param[in] sym symbol to have R expression assigned to
    * @param[in] expr R expression to be assigned to sym
    * @return TRUE if assignment was successful, FALSE if the request failed
    */
   bool RClient::assign(const RSTRINGTYPE &sym, const REXP &expr){
+    const long long encodeBegin = trace_begin();
     RVECTORTYPE<RPacket::PacketEntry> entrylist;
     entrylist.resize(2);
     entrylist[0] = RPacket::PacketEntry(sym);
-    entrylist[1] = RPacket::PacketEntry(expr);
+    entrylist[1] = RPacket::PacketEntry::streaming(expr);
 
     // make RPacket to be sent
     RPacket toSend(RPacket::CMD_setSEXP, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_setSEXP, encodeBegin);
 
     // submit packet and receive the response
-    RSHARED_PTR<const RPacket> response = m_NetMan.submit(toSend);
+    RSHARED_PTR<const RPacket> response = submit(toSend);
     // store response in RClient
     m_pLast_response = response;
     // return whether or not response was successful
@@ -152,19 +224,119 @@ namespace rclient{
   RSHARED_PTR<const REXP> RClient::eval(const RSTRINGTYPE &expr){
 
     // make RPacket entries
+    const long long encodeBegin = trace_begin();
     RVECTORTYPE<RPacket::PacketEntry> entrylist;
     entrylist.resize(1);
     entrylist[0] = RPacket::PacketEntry(expr+"\n");
     // make RPacket to be sent
     RPacket toSend(RPacket::CMD_eval, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_eval, encodeBegin);
     // submit packet and receive the response
-    RSHARED_PTR<const RPacket> response = m_NetMan.submit(toSend);
+    RSHARED_PTR<const RPacket> response = submit(toSend);
     // store response in client
     m_pLast_response = response;
     // return first entry
-    return response_REXPAt(0);
+    const long long decodeBegin = trace_begin();
+    RSHARED_PTR<const REXP> value = response_REXPAt(0);
+    trace_end(RequestTracer::TP_DECODE, RPacket::CMD_eval, decodeBegin);
+    return value;
   }
 
+  /** Sends request to server to evaluate the provided string, and passes the result to handler while it is received.
+   * The result is never stored, so results larger than memory can be processed.
+   * If handler throws, the connection is closed and the exception is passed on.
+   * @param[in] expr R expression to be evaulated on the server
+   * @param[in] handler receives the value of the executed R expression
+   * @return TRUE if evaluation was successful, FALSE if the request failed
+   */
+  bool RClient::eval(const RSTRINGTYPE &expr, REXPHandler &handler){
+    const long long encodeBegin = trace_begin();
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(1);
+    entrylist[0] = RPacket::PacketEntry(expr+"\n");
+    // make RPacket to be sent
+    RPacket toSend(RPacket::CMD_eval, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_eval, encodeBegin);
+    // submit packet and decode the response as it arrives
+    RSHARED_PTR<const RPacket> response = submit(toSend, handler);
+    // store response in client
+    m_pLast_response = response;
+    // return whether or not response was successful
+    return response->isOk();
+  }
+
+  /** Sends request to server to evaluate the provided string without returning the result
+   * @param[in] expr R expression to be evaulated on the server
+   * @return TRUE if evaluation was successful, FALSE if the request failed
+   */
+  bool RClient::voidEval(const RSTRINGTYPE &expr){
+    const long long encodeBegin = trace_begin();
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(1);
+    entrylist[0] = RPacket::PacketEntry(expr+"\n");
+    // make RPacket to be sent
+    RPacket toSend(RPacket::CMD_voideval, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_voideval, encodeBegin);
+    // submit packet and receive the response
+    RSHARED_PTR<const RPacket> response = submit(toSend);
+    // store response in client
+    m_pLast_response = response;
+    // return whether or not response was successful
+    return response->isOk();
+  }
+
+
+  /** Queues request for server to evaluate the provided string. Returns without waiting for the response.
+   * The response is not stored as the most recent response of the RClient.
+   * @param[in] expr R expression to be evaulated on the server
+   * @param[in] callback notified on the I/O thread when the request completes. May be null
+   * @return future holding the response. RFuture::getREXP returns the value of the executed R expression
+   */
+  RSHARED_PTR<RFuture> RClient::evalAsync(const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback){
+    const long long encodeBegin = trace_begin();
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(1);
+    entrylist[0] = RPacket::PacketEntry(expr+"\n");
+    RSHARED_PTR<RPacket> toSend = RMAKE_SHARED<RPacket>(RPacket::CMD_eval, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_eval, encodeBegin);
+    return submitAsync(toSend, callback);
+  }
+
+  /** Queues request for server to evaluate the provided string without returning the result.
+   * Returns without waiting for the response.
+   * @param[in] expr R expression to be evaulated on the server
+   * @param[in] callback notified on the I/O thread when the request completes. May be null
+   * @return future holding the response
+   */
+  RSHARED_PTR<RFuture> RClient::voidEvalAsync(const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback){
+    const long long encodeBegin = trace_begin();
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(1);
+    entrylist[0] = RPacket::PacketEntry(expr+"\n");
+    RSHARED_PTR<RPacket> toSend = RMAKE_SHARED<RPacket>(RPacket::CMD_voideval, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_voideval, encodeBegin);
+    return submitAsync(toSend, callback);
+  }
+
+  /** Queues request for server to set the given symbol. Returns without waiting for the response.
+   * expr is encoded before returning, so it may be modified or destroyed immediately.
+   * @param[in] sym symbol to have R expression assigned to
+   * @param[in] expr R expression to be assigned to sym
+   * @param[in] callback notified on the I/O thread when the request completes. May be null
+   * @return future holding the response
+   */
+  RSHARED_PTR<RFuture> RClient::assignAsync(const RSTRINGTYPE &sym, const REXP &expr, const RSHARED_PTR<RCallback> &callback){
+    const long long encodeBegin = trace_begin();
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(2);
+    entrylist[0] = RPacket::PacketEntry(sym);
+    entrylist[1] = RPacket::PacketEntry(expr);
+    RSHARED_PTR<RPacket> toSend = RMAKE_SHARED<RPacket>(RPacket::CMD_setSEXP, entrylist);
+    trace_end(RequestTracer::TP_ENCODE, RPacket::CMD_setSEXP, encodeBegin);
+    return submitAsync(toSend, callback);
+  }
+
+
   /** Checks the QAP1Header of the most recent server response to see if the previous server command was successful
    * @return True if first bit is set in the command, representing a successful request. False otherwise
    */
@@ -218,15 +390,16 @@ namespace rclient{
 
     const RPacket::PacketEntry &entry = (*m_pLast_response->getEntries())[pos];
 
-    // check for terminator at end of entry
-    size_t len = entry.getLength();
-    if(entry.getEntry()[len] ){
-      // end of entry is not null, return empty string
+    // check for terminator within entry, the entry may be followed by other data in the response
+    size_t header_length = entry.getHeaderLength();
+    const unsigned char *str = entry.getEntry() + header_length;
+    if(!memchr(str, 0, entry.getLength() - header_length)){
+      // string is not null terminated, return empty string
       return RSTRINGTYPE(); // or throw exception
     }
 
     // string at 8 bytes or 4 bytes depending on header size
-    return RSTRINGTYPE((char*) &entry.getEntry()[(entry.getHeaderLength() == 8 ? 8:4)]);
+    return RSTRINGTYPE((const char*) str);
   }
   
 
@@ -240,14 +413,32 @@ namespace rclient{
       return RMAKE_SHARED<REXPNull>(); // does not compile with -o2 and higher
     }
     const RPacket::PacketEntry &entry = (*m_pLast_response->getEntries())[pos];
-    return entry.toREXP();    
+    return entry.toREXP(m_pLast_response->getArena());
   }
 
   /** Retrives server version
    * @return string displaying server version
    */
   const RSTRINGTYPE RClient::getRserveVersion(){
+    ScopedLock lock(m_netMutex);
     return m_NetMan.getVersion();
   }
 
+  /** Checks whether the client holds an open, idle connection to RServe. Does not try to connect.
+   * The connection is lost after a network error, and a new connection would not be logged in.
+   * @return True if the connection is still open, False otherwise
+   */
+  bool RClient::isConnected(){
+    ScopedLock lock(m_netMutex);
+    return m_NetMan.isConnected();
+  }
+
+  /** Reads the client's traffic counters without blocking, even while requests are in progress
+   * The counters include other clients sharing the same ConnectionOptions::metrics.
+   * @return latency histograms by command, bytes and entries sent and received, connects and network errors
+   */
+  ClientMetrics::Snapshot RClient::getMetrics() const{
+    return m_NetMan.getMetrics().snapshot();
+  }
+
 } // close namespace
@@ -20,23 +20,32 @@
 #include "config.h"
 #include "network_manager.h"
 #include "rexp_class_hierarchy.h"
+#include "rexp_handler.h"
+#include "rfuture.h"
+#include "thread_sync.h"
 
 #include <inttypes.h>
 
 namespace rclient{
 
+  class AsyncSubmitter;
+
   /** Primary class to be used by the consumer.
    * RClient is initialized with Rserve host IP and port that it will be interacting with.
    * RClient contains all of the Rserve commands that can be executed by the consumer.
    * The consumer will want to #include "rclient.h" in order to have access to all functionality within the client.
    * The client attempts to connect to Rserve on the first Rserve command requested by the consumer.
    * The client disconnects when a network error occurs or when its NetworkmManager is destroyed.
+   * The Async commands return immediately and are sent by a dedicated I/O thread, started on first use.
+   * Requests are sent in the order they are made, whether they are synchronous or asynchronous.
    */
   class RCLIENT_API RClient{
 
   public:
 
-    explicit RClient(const RSTRINGTYPE &host, const int port = 6311, const bool allowAnyVersion = false);
+    explicit RClient(const RSTRINGTYPE &host, const int port = 6311, const bool allowAnyVersion = false,
+                     const ConnectionOptions &options = ConnectionOptions());
+    ~RClient();
     RClient(const RClient& no_copy); // non construction-copyable
     RClient& operator=(const RClient&); // non-copyable
     
@@ -45,6 +54,8 @@ namespace rclient{
     bool shutdown(const RSTRINGTYPE &key = ""); // CMD_shutdown
 
     RSHARED_PTR<const REXP> eval(const RSTRINGTYPE &expr);
+    bool eval(const RSTRINGTYPE &expr, REXPHandler &handler);
+    bool voidEval(const RSTRINGTYPE &expr); // CMD_voideval
 
     bool assign(const RSTRINGTYPE &sym, const REXP &expr);
     template<typename T_VAL, typename T_REXP>
@@ -53,9 +64,13 @@ namespace rclient{
       bool assign(const RSTRINGTYPE &sym, const T_VAL &expr, const T_NA &consumerNAValue);
 
 
-    /* Following Rserve Commands not yet implemented on this client
+    /* Asynchronous Rserve Commands */
+    RSHARED_PTR<RFuture> evalAsync(const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+    RSHARED_PTR<RFuture> voidEvalAsync(const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+    RSHARED_PTR<RFuture> assignAsync(const RSTRINGTYPE &sym, const REXP &expr, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+
 
-       bool voidEval(const RSTRINGTYPE &expr);
+    /* Following Rserve Commands not yet implemented on this client
 
        RSHARED_PTR<RSession> detachedEval(const RSTRINGTYPE expr, int *status=NULL);
        RSHARED_PTR<RSession> detach(int *status = NULL);
@@ -96,10 +111,27 @@ namespace rclient{
     RSHARED_PTR<const REXP> response_REXPAt(const size_t &pos) const;
 
     const RSTRINGTYPE getRserveVersion();
+    bool isConnected();
+
+    // latency histograms and traffic counters, see ClientMetrics
+    ClientMetrics::Snapshot getMetrics() const;
 
   private:
+    RSHARED_PTR<const RPacket> submit(RPacket &packet);
+    RSHARED_PTR<const RPacket> submit(RPacket &packet, REXPHandler &handler);
+    RSHARED_PTR<RFuture> submitAsync(const RSHARED_PTR<RPacket> &packet, const RSHARED_PTR<RCallback> &callback);
+    AsyncSubmitter* async_submitter(const bool create);
+    long long trace_begin() const;
+    void trace_end(const RequestTracer::ePhase phase, const uint32_t command, const long long begin) const;
+
     // network manager to handle all network activity
     NetworkManager m_NetMan;
+    // held while m_NetMan is in use once the I/O thread has started
+    Mutex m_netMutex;
+    // held while m_pAsync is read or created, see async_submitter
+    Mutex m_asyncMutex;
+    // I/O thread for asynchronous requests, null until the first one. Declared after m_NetMan so it is destroyed first
+    RSHARED_PTR<AsyncSubmitter> m_pAsync;
     // most recent response from Rserve
     RSHARED_PTR<const RPacket> m_pLast_response;
   };
@@ -0,0 +1,188 @@
+/*  RClientPool: Thread-safe pool of connected and logged-in RClient sessions.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "rclient_pool.h"
+
+#include <stdexcept>
+
+namespace rclient{
+
+  /** Constructor connects and logs in size sessions.
+   * Throws NetworkError if a session cannot connect, or runtime_error if a login is rejected.
+   * @param[in] host Rserve IP address
+   * @param[in] port Port that Rserve is listening on
+   * @param[in] size number of sessions kept by the pool
+   * @param[in] user login username, used if Rserve requires authentication
+   * @param[in] pwd login password, used if Rserve requires authentication
+   * @param[in] allowAnyVersion Whether or not to allow connection to any version of RServe. Otherwise only version 0103 is permitted.
+   * @param[in] options socket settings applied to every session
+   * @param[in] maxWaiting maximum number of threads that may wait in checkout at once, 0 for no limit
+   */
+  RClientPool::RClientPool(const RSTRINGTYPE &host, const int port, const size_t size, const RSTRINGTYPE &user, const RSTRINGTYPE &pwd,
+                           const bool allowAnyVersion, const ConnectionOptions &options, const size_t maxWaiting):
+    m_sHost(host), m_iPort(port), m_iSize(size), m_sUser(user), m_sPwd(pwd), m_bAnyVersion(allowAnyVersion), m_options(options),
+    m_iMaxWaiting(maxWaiting), m_iOpen(0), m_iWaiting(0){
+    try{
+      for(size_t i = 0; i < m_iSize; ++i){
+        m_idle.push_back(createSession());
+        ++m_iOpen;
+      }
+    }
+    catch(...){
+      for(size_t i = 0; i < m_idle.size(); ++i)
+        delete m_idle[i];
+      throw;
+    }
+  }
+
+  /** destructor disconnects all idle sessions
+   */
+  RClientPool::~RClientPool(){
+    for(size_t i = 0; i < m_idle.size(); ++i)
+      delete m_idle[i];
+  }
+
+
+  /** Creates a session that is connected to Rserve and logged in
+   * @return new RClient owned by the caller
+   */
+  RClient* RClientPool::createSession(){
+    RClient *client = new RClient(m_sHost, m_iPort, m_bAnyVersion, m_options);
+    try{
+      // login connects, and returns true without a request if authentication is not required
+      if(!client->login(m_sUser, m_sPwd))
+        throw std::runtime_error("ERROR:: RClientPool failed to log in to RServe.");
+    }
+    catch(...){
+      delete client;
+      throw;
+    }
+    return client;
+  }
+
+
+  /** Takes an idle session from the pool, waiting for one to be checked in if all are in use.
+   * A session whose connection was closed while idle is replaced before it is handed out.
+   * Throws runtime_error if too many threads are already waiting or the timeout expires,
+   * and NetworkError if a replacement session cannot connect.
+   * @param[in] timeout_ms maximum number of milliseconds to wait for a session, negative to wait indefinitely
+   * @return session for the exclusive use of the caller. It is checked back in when released
+   */
+  RClientPool::Session RClientPool::checkout(const long timeout_ms){
+    RClient *client = NULL;
+    {
+      ScopedLock lock(m_mutex);
+      if(m_idle.empty() && m_iOpen >= m_iSize){
+        if(m_iMaxWaiting > 0 && m_iWaiting >= m_iMaxWaiting)
+          throw std::runtime_error("ERROR:: Too many threads waiting for an RClientPool session.");
+
+        ++m_iWaiting;
+        // the deadline is fixed before waiting, so that wakeups which find no session do not restart the timeout
+        const struct timespec deadline = Condition::deadline(timeout_ms);
+        bool signalled = true;
+        while(m_idle.empty() && m_iOpen >= m_iSize && signalled){
+          if(timeout_ms < 0)
+            m_available.wait(m_mutex);
+          else
+            signalled = m_available.timedWaitUntil(m_mutex, deadline);
+        }
+        --m_iWaiting;
+
+        if(m_idle.empty() && m_iOpen >= m_iSize)
+          throw std::runtime_error("ERROR:: Timed out waiting for an RClientPool session.");
+      }
+
+      if(!m_idle.empty()){
+        client = m_idle.front();
+        m_idle.pop_front();
+      }
+      else{
+        // reserve a free slot; the session is created below without holding the lock
+        ++m_iOpen;
+      }
+    }
+
+    // health check: replace sessions that lost their connection while idle
+    if(client && !client->isConnected()){
+      delete client;
+      client = NULL;
+    }
+
+    if(!client){
+      try{
+        client = createSession();
+      }
+      catch(...){
+        // release the slot so that another thread can try
+        ScopedLock lock(m_mutex);
+        --m_iOpen;
+        m_available.signal();
+        throw;
+      }
+    }
+
+    return Session(client, Checkin(this));
+  }
+
+
+  /** Returns a session to the pool. Called when the last copy of a Session is released.
+   * A session that hit a network error is dropped and its slot freed, so that the next checkout
+   * creates a new session without the releasing thread waiting on Rserve.
+   * @param[in] client session being checked in
+   */
+  void RClientPool::checkin(RClient *client){
+    const bool connected = client->isConnected();
+    if(!connected)
+      delete client;
+
+    ScopedLock lock(m_mutex);
+    if(connected)
+      m_idle.push_back(client);
+    else
+      --m_iOpen;
+    m_available.signal();
+  }
+
+
+  /** Retrieves the maximum number of sessions in the pool
+   * @return number of sessions the pool was created with
+   */
+  size_t RClientPool::size() const{
+    return m_iSize;
+  }
+
+  /** Retrieves the number of sessions waiting to be checked out
+   * @return number of idle sessions
+   */
+  size_t RClientPool::idle(){
+    ScopedLock lock(m_mutex);
+    return m_idle.size();
+  }
+
+
+  /** constructor stores the pool that sessions are returned to
+   * @param[in] pool RClientPool that owns the sessions
+   */
+  RClientPool::Checkin::Checkin(RClientPool *pool):m_pPool(pool){}
+
+  /** returns client to the pool
+   * @param[in] client session being released
+   */
+  void RClientPool::Checkin::operator()(RClient *client) const{
+    m_pPool->checkin(client);
+  }
+
+} // close namespace
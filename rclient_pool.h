@@ -0,0 +1,85 @@
+/*  RClientPool: Thread-safe pool of connected and logged-in RClient sessions.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_POOL_H_INCLUDED
+#define RCLIENT_POOL_H_INCLUDED
+
+#include "config.h"
+#include "rclient.h"
+#include "thread_sync.h"
+
+#include <deque>
+
+namespace rclient{
+
+  /** Pool of RClient sessions that may be shared between threads.
+   * Rserve forks a process for every connection, so the pool connects and logs in its sessions up front.
+   * checkout() hands a session to one thread at a time. The session goes back to the pool when the last copy of the
+   * returned pointer is released. A session that lost its connection is dropped, and checkout() replaces it with a new, logged-in session.
+   * All sessions must be released before the pool is destroyed.
+   */
+  class RCLIENT_API RClientPool{
+
+  public:
+    typedef RSHARED_PTR<RClient> Session;
+
+    RClientPool(const RSTRINGTYPE &host, const int port, const size_t size,
+                const RSTRINGTYPE &user = "", const RSTRINGTYPE &pwd = "",
+                const bool allowAnyVersion = false, const ConnectionOptions &options = ConnectionOptions(),
+                const size_t maxWaiting = 0);
+    ~RClientPool();
+
+    Session checkout(const long timeout_ms = -1);
+
+    size_t size() const;
+    size_t idle();
+
+  private:
+    RClientPool(const RClientPool &no_copy); // non construction-copyable
+    RClientPool& operator=(const RClientPool&); // non-copyable
+
+    /** Deleter for Session: returns the RClient to its pool instead of deleting it
+     */
+    class Checkin{
+    public:
+      explicit Checkin(RClientPool *pool);
+      void operator()(RClient *client) const;
+    private:
+      RClientPool *m_pPool;
+    };
+
+    RClient* createSession();
+    void checkin(RClient *client);
+
+    const RSTRINGTYPE m_sHost; // Rserve IP
+    const int m_iPort; // Rserve port
+    const size_t m_iSize; // maximum number of sessions
+    const RSTRINGTYPE m_sUser; // login username
+    const RSTRINGTYPE m_sPwd; // login password
+    const bool m_bAnyVersion; // whether or not to allow connection to any version of RServe
+    const ConnectionOptions m_options; // socket settings for every session
+    const size_t m_iMaxWaiting; // maximum number of threads blocked in checkout, 0 for no limit
+
+    Mutex m_mutex; // guards all of the members below
+    Condition m_available; // signalled when a session is checked in or a slot is freed
+    std::deque<RClient*> m_idle; // sessions ready to be checked out
+    size_t m_iOpen; // sessions that exist or are being created, checked out or idle
+    size_t m_iWaiting; // threads blocked in checkout
+  };
+
+} // close namespace
+
+#endif
@@ -0,0 +1,89 @@
+/*  RDataView: Read-only View of the Values Held by an REXP Vector
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_RDATA_VIEW_H_INCLUDED
+#define RCLIENT_RDATA_VIEW_H_INCLUDED
+
+#include "config.h"
+
+#include <stddef.h>
+
+namespace rclient{
+
+  /** Pointer and length of values owned by an REXP, returned by the getView functions of REXP vectors.
+   * The values are not copied, so NA values keep R's representation, and the view is only valid while the REXP exists and is
+   * unchanged.
+   */
+  template<typename T>
+  class RDataView{
+
+  public:
+    typedef const T* const_iterator;
+
+    /** constructor for an empty view
+     */
+    RDataView():m_pData(NULL), m_iLength(0){}
+
+    /** constructor
+     * @param[in] data first value, may be NULL if length is 0
+     * @param[in] length number of values
+     */
+    RDataView(const T *data, const size_t length):m_pData(data), m_iLength(length){}
+
+    /** @return first value, NULL if the view is empty
+     */
+    const T* data() const{
+      return m_pData;
+    }
+
+    /** @return number of values
+     */
+    size_t size() const{
+      return m_iLength;
+    }
+
+    /** @return true if there are no values
+     */
+    bool empty() const{
+      return m_iLength == 0;
+    }
+
+    /** @param[in] i index of the value, must be less than size()
+     * @return value at index i
+     */
+    const T& operator[](const size_t i) const{
+      return m_pData[i];
+    }
+
+    /** @return iterator to the first value
+     */
+    const_iterator begin() const{
+      return m_pData;
+    }
+
+    /** @return iterator past the last value
+     */
+    const_iterator end() const{
+      return m_pData + m_iLength;
+    }
+
+  private:
+    const T *m_pData; // first value
+    size_t m_iLength; // number of values
+  };
+
+} // close namespace
+#endif
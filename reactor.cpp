@@ -0,0 +1,547 @@
+/*  Reactor: Event loop that drives many Rserve sessions from a single thread.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "reactor.h"
+
+#include <stdexcept>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+
+// epoll is only available on Linux, other systems fall back to poll()
+#if defined(__linux__)
+#define RCLIENT_USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+namespace{
+
+  /** number of socket events handled per call to run()
+   */
+  const int MaxEvents = 64;
+
+  /** io_uring submission queue size, and most sessions whose receive buffer is registered
+   */
+  const unsigned RingEntries = 1024;
+
+  /** size of each session's send and receive buffer when io_uring is used
+   */
+  const size_t RingBufferLength = 65536;
+
+  /** operation identified by the user data of an io_uring completion
+   */
+  enum eOperation { OP_SEND = 1, OP_RECEIVE = 2, OP_TIMEOUT = 3, OP_CANCEL = 4 };
+
+  /** Packs the session, connection generation and operation into io_uring user data
+   * @param[in] id session the operation is for
+   * @param[in] generation generation of the session's connection
+   * @param[in] op operation
+   * @return user data
+   */
+  uint64_t operationData(const size_t id, const unsigned generation, const eOperation op){
+    return ((uint64_t) id << 24) | ((uint64_t) (generation & 0xffff) << 8) | op;
+  }
+
+} // close namespace
+
+namespace rclient{
+
+  /** Session constructor stores the connection settings. The session connects when it is added to the Reactor.
+   */
+  Reactor::Session::Session(const RSTRINGTYPE &host, const int port, const RSTRINGTYPE &user, const RSTRINGTYPE &pwd,
+                            const bool allowAnyVersion, const ConnectionOptions &options):
+    netman(host, port, allowAnyVersion, options), user(user), pwd(pwd), sock(-1), watchingWrite(false),
+    sendBegin(0), sendEnd(0), bufferSlot(-1), sending(false), receiving(false), generation(0){}
+
+
+  /** Constructor creates the io_uring or epoll instance
+   * Throws runtime_error if epoll is unavailable
+   * @param[in] useIoUring whether to use io_uring if the system supports it
+   */
+  Reactor::Reactor(const bool useIoUring):m_iPoll(-1), m_bTimeoutPending(false), m_iTimeoutGeneration(0), m_iPending(0){
+    if(useIoUring && m_ring.open(RingEntries, RingEntries))
+      return;
+#ifdef RCLIENT_USE_EPOLL
+    m_iPoll = epoll_create(MaxEvents);
+    if(m_iPoll < 0)
+      throw std::runtime_error("ERROR:: Failed to create epoll instance.");
+#endif
+  }
+
+  /** Destructor fails every request still awaiting a response, then closes all sessions
+   */
+  Reactor::~Reactor(){
+    for(SessionId id = 0; id < m_sessions.size(); ++id)
+      fail(id, std::runtime_error("ERROR:: Reactor was destroyed before the request completed."));
+    if(m_ring.isOpen()){
+      // the kernel writes to the session buffers until the cancelled operations complete
+      while(ring_busy()){
+        int ret = m_ring.submit(1);
+        if(ret < 0 && ret != -EINTR) break;
+        reap_completions();
+      }
+      m_ring.close();
+    }
+    if(m_iPoll >= 0)
+      close(m_iPoll);
+  }
+
+  /** @return True if io_uring was requested and is available, false if epoll or poll is used
+   */
+  bool Reactor::isUsingIoUring() const{
+    return m_ring.isOpen();
+  }
+
+
+  /** Connects to Rserve and logs in, blocking until done, then starts watching the new session
+   * Throws NetworkError if the connection fails, runtime_error if the login is rejected
+   * @param[in] host Rserve IP address
+   * @param[in] port Port that Rserve is listening on
+   * @param[in] user login username, used if Rserve requires authentication
+   * @param[in] pwd login password, used if Rserve requires authentication
+   * @param[in] allowAnyVersion Whether or not to allow connection to any version of RServe
+   * @param[in] options socket settings applied to the connection
+   * @return id of the new session, used to submit requests to it
+   */
+  Reactor::SessionId Reactor::addSession(const RSTRINGTYPE &host, const int port, const RSTRINGTYPE &user, const RSTRINGTYPE &pwd,
+                                         const bool allowAnyVersion, const ConnectionOptions &options){
+    RSHARED_PTR<Session> session = RMAKE_SHARED<Session>(host, port, user, pwd, allowAnyVersion, options);
+    SessionId id = m_sessions.size();
+    if(m_ring.isOpen()){
+      session->sendBuffer.resize(RingBufferLength);
+      session->recvBuffer.resize(RingBufferLength);
+      if(m_ring.registerBuffer(id, &session->recvBuffer[0], RingBufferLength))
+        session->bufferSlot = id;
+    }
+    m_sessions.push_back(session);
+    try{
+      connect(id);
+    }
+    catch(...){
+      m_sessions.pop_back();
+      throw;
+    }
+    return id;
+  }
+
+  /** @return number of sessions added to the Reactor
+   */
+  size_t Reactor::sessions() const{
+    return m_sessions.size();
+  }
+
+  /** @return number of requests awaiting their response, across all sessions
+   */
+  size_t Reactor::pending() const{
+    return m_iPending;
+  }
+
+
+  /** Queues a request on a session and sends as much of it as the socket accepts without blocking.
+   * With io_uring, the request is sent by the next call to run() instead.
+   * If the session lost its connection, it reconnects and logs in again first, which blocks.
+   * @param[in] session id returned by addSession
+   * @param[in] packet request to send. It is copied, so it may be modified or destroyed once submit returns
+   * @param[in] callback notified from run() when the request completes. May be null
+   * @return future that receives the response
+   */
+  RSHARED_PTR<RFuture> Reactor::submit(const SessionId session, RPacket &packet, const RSHARED_PTR<RCallback> &callback){
+    Session &s = getSession(session);
+    RSHARED_PTR<RFuture> future = RMAKE_SHARED<RFuture>(callback);
+    s.inFlight.push_back(future);
+    ++m_iPending;
+    try{
+      if(s.sock < 0)
+        connect(session);
+      s.netman.queueRequest(packet);
+      // send right away if the socket has room, otherwise wait until it is writable
+      if(!m_ring.isOpen())
+        s.netman.flushRequests();
+      watch(session);
+    }
+    catch(const std::runtime_error &e){
+      fail(session, e);
+    }
+    return future;
+  }
+
+  /** Queues request for server to evaluate the provided string
+   * @param[in] session id returned by addSession
+   * @param[in] expr R expression to be evaulated on the server
+   * @param[in] callback notified from run() when the request completes. May be null
+   * @return future holding the response. RFuture::getREXP returns the value of the executed R expression
+   */
+  RSHARED_PTR<RFuture> Reactor::eval(const SessionId session, const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback){
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(1);
+    entrylist[0] = RPacket::PacketEntry(expr+"\n");
+    RPacket toSend(RPacket::CMD_eval, entrylist);
+    return submit(session, toSend, callback);
+  }
+
+  /** Queues request for server to evaluate the provided string without returning the result
+   * @param[in] session id returned by addSession
+   * @param[in] expr R expression to be evaulated on the server
+   * @param[in] callback notified from run() when the request completes. May be null
+   * @return future holding the response
+   */
+  RSHARED_PTR<RFuture> Reactor::voidEval(const SessionId session, const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback){
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(1);
+    entrylist[0] = RPacket::PacketEntry(expr+"\n");
+    RPacket toSend(RPacket::CMD_voideval, entrylist);
+    return submit(session, toSend, callback);
+  }
+
+  /** Queues request for server to set the given symbol
+   * @param[in] session id returned by addSession
+   * @param[in] sym symbol to have R expression assigned to
+   * @param[in] expr R expression to be assigned to sym
+   * @param[in] callback notified from run() when the request completes. May be null
+   * @return future holding the response
+   */
+  RSHARED_PTR<RFuture> Reactor::assign(const SessionId session, const RSTRINGTYPE &sym, const REXP &expr, const RSHARED_PTR<RCallback> &callback){
+    RVECTORTYPE<RPacket::PacketEntry> entrylist;
+    entrylist.resize(2);
+    entrylist[0] = RPacket::PacketEntry(sym);
+    entrylist[1] = RPacket::PacketEntry(expr);
+    RPacket toSend(RPacket::CMD_setSEXP, entrylist);
+    return submit(session, toSend, callback);
+  }
+
+
+  /** Waits for socket events, then sends queued requests and completes received responses
+   * @param[in] timeout_ms longest time to wait for an event in milliseconds, -1 to wait indefinitely
+   * @return number of requests completed
+   */
+  size_t Reactor::run(const long timeout_ms){
+    if(m_ring.isOpen())
+      return run_ring(timeout_ms);
+
+    size_t completed = 0;
+#ifdef RCLIENT_USE_EPOLL
+    struct epoll_event events[MaxEvents];
+    int n = epoll_wait(m_iPoll, events, MaxEvents, timeout_ms);
+    if(n < 0){
+      if(errno == EINTR) return 0;
+      throw NetworkError("ERROR:: Failed to wait for socket events.\n", errno);
+    }
+    for(int i = 0; i < n; ++i)
+      completed += handleEvent(events[i].data.u64, events[i].events & EPOLLOUT, events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP));
+#else
+    RVECTORTYPE<struct pollfd> fds;
+    RVECTORTYPE<SessionId> ids;
+    for(SessionId id = 0; id < m_sessions.size(); ++id){
+      if(m_sessions[id]->sock < 0) continue;
+      struct pollfd pfd;
+      pfd.fd = m_sessions[id]->sock;
+      pfd.events = POLLIN | (m_sessions[id]->watchingWrite ? POLLOUT : 0);
+      pfd.revents = 0;
+      fds.push_back(pfd);
+      ids.push_back(id);
+    }
+    int n = ::poll(fds.empty() ? NULL : &fds[0], fds.size(), timeout_ms);
+    if(n < 0){
+      if(errno == EINTR) return 0;
+      throw NetworkError("ERROR:: Failed to wait for socket events.\n", errno);
+    }
+    for(size_t i = 0; i < fds.size(); ++i)
+      if(fds[i].revents)
+        completed += handleEvent(ids[i], fds[i].revents & POLLOUT, fds[i].revents & (POLLIN | POLLERR | POLLHUP));
+#endif
+    return completed;
+  }
+
+  /** Calls run() until no request is awaiting a response
+   * @return number of requests completed
+   */
+  size_t Reactor::runUntilIdle(){
+    size_t completed = 0;
+    while(m_iPending > 0)
+      completed += run();
+    return completed;
+  }
+
+
+  /** Connects a session to Rserve if needed, logs in, and starts watching its socket
+   * Throws NetworkError if the connection fails, runtime_error if the login is rejected
+   * @param[in] id session to connect
+   */
+  void Reactor::connect(const SessionId id){
+    Session &s = getSession(id);
+    // log in while the socket is still used synchronously
+    if(s.netman.isAuthorizationRequired()){
+      RSTRINGTYPE loginfo;
+      if(!s.netman.getLoginInfo(s.user, s.pwd, loginfo))
+        throw std::runtime_error("ERROR:: Rserve requires an unsupported authentication type.");
+      RVECTORTYPE<RPacket::PacketEntry> entrylist;
+      entrylist.resize(1);
+      entrylist[0] = RPacket::PacketEntry(loginfo);
+      RPacket toSend(RPacket::CMD_login, entrylist);
+      if(!s.netman.submit(toSend)->isOk())
+        throw std::runtime_error("ERROR:: Failed to log in to Rserve.");
+    }
+    watch(id);
+  }
+
+  /** Starts watching a session's socket, or updates whether it is watched for writability
+   * Always watched for readability, and for writability while queued requests have not been sent completely.
+   * @param[in] id session to watch
+   */
+  void Reactor::watch(const SessionId id){
+    Session &s = getSession(id);
+    const int sock = s.netman.getSocket();
+    const bool writing = s.netman.hasQueuedRequests();
+    if(sock == s.sock && writing == s.watchingWrite) return;
+    // io_uring operations are prepared by run() instead
+    if(m_ring.isOpen()){
+      s.sock = sock;
+      return;
+    }
+#ifdef RCLIENT_USE_EPOLL
+    struct epoll_event event;
+    event.events = EPOLLIN | (writing ? EPOLLOUT : 0);
+    event.data.u64 = id;
+    if(epoll_ctl(m_iPoll, sock == s.sock ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, sock, &event) != 0)
+      throw NetworkError("ERROR:: Failed to watch session socket.\n", errno);
+#endif
+    s.sock = sock;
+    s.watchingWrite = writing;
+  }
+
+  /** Stops watching a session's socket
+   * @param[in] id session to stop watching
+   */
+  void Reactor::unwatch(const SessionId id){
+    Session &s = getSession(id);
+    if(s.sock < 0) return;
+    if(m_ring.isOpen()){
+      // completions of the operations in flight are ignored once the generation changes
+      if(s.sending)
+        m_ring.prepareCancel(operationData(id, s.generation, OP_SEND), operationData(id, s.generation, OP_CANCEL));
+      if(s.receiving)
+        m_ring.prepareCancel(operationData(id, s.generation, OP_RECEIVE), operationData(id, s.generation, OP_CANCEL));
+      ++s.generation;
+      s.sendBegin = s.sendEnd = 0;
+    }
+#ifdef RCLIENT_USE_EPOLL
+    // fails harmlessly if the socket was already closed, which removed it from the epoll set
+    epoll_ctl(m_iPoll, EPOLL_CTL_DEL, s.sock, NULL);
+#endif
+    s.sock = -1;
+    s.watchingWrite = false;
+  }
+
+
+  /** Handles the events reported for a session's socket
+   * @param[in] id session the events are for
+   * @param[in] writable whether the socket can accept more data
+   * @param[in] readable whether the socket has data, or an error or hang-up to report
+   * @return number of requests completed
+   */
+  size_t Reactor::handleEvent(const SessionId id, const bool writable, const bool readable){
+    Session &s = getSession(id);
+    // session may have been closed by an earlier event
+    if(s.sock < 0) return 0;
+    try{
+      if(writable){
+        s.netman.flushRequests();
+        watch(id);
+      }
+      if(readable)
+        return readResponses(id);
+    }
+    catch(const std::runtime_error &e){
+      return fail(id, e);
+    }
+    return 0;
+  }
+
+  /** Completes requests with every response that has been received completely
+   * Throws NetworkError if the connection failed
+   * @param[in] id session to read from
+   * @return number of requests completed
+   */
+  size_t Reactor::readResponses(const SessionId id){
+    Session &s = getSession(id);
+    size_t completed = 0;
+    while(true){
+      RSHARED_PTR<const RPacket> response = (m_ring.isOpen() ? s.netman.takeResponse() : s.netman.pollResponse());
+      if(!response) break;
+      // Rserve only answers requests, so a response with nothing in flight is dropped
+      if(s.inFlight.empty()) continue;
+      RSHARED_PTR<RFuture> future = s.inFlight.front();
+      s.inFlight.pop_front();
+      --m_iPending;
+      future->setResponse(response);
+      ++completed;
+    }
+    return completed;
+  }
+
+  /** Fails every request of a session that is awaiting its response, stops watching the session and closes its connection.
+   * The connection is closed whatever the error, since responses left unread would be taken for those of later requests
+   * @param[in] id session that failed
+   * @param[in] error error to report to each request
+   * @return number of requests completed
+   */
+  size_t Reactor::fail(const SessionId id, const std::runtime_error &error){
+    Session &s = getSession(id);
+    unwatch(id);
+    s.netman.disconnect();
+    std::deque<RSHARED_PTR<RFuture> > failed;
+    failed.swap(s.inFlight);
+    m_iPending -= failed.size();
+
+    const NetworkError *networkError = dynamic_cast<const NetworkError*>(&error);
+    for(size_t i = 0; i < failed.size(); ++i){
+      if(networkError)
+        failed[i]->setError(*networkError);
+      else
+        failed[i]->setError(error.what());
+    }
+    return failed.size();
+  }
+
+  /** Prepares the I/O of every connected session, then submits it and waits for completions with a single system call
+   * Throws NetworkError if io_uring fails
+   * @param[in] timeout_ms longest time to wait for a completion in milliseconds, -1 to wait indefinitely
+   * @return number of requests completed
+   */
+  size_t Reactor::run_ring(const long timeout_ms){
+    for(SessionId id = 0; id < m_sessions.size(); ++id)
+      prepare_session(id);
+
+    if(timeout_ms > 0){
+      // replace a timeout left over from an earlier call, which may be longer
+      if(m_bTimeoutPending)
+        m_ring.prepareCancel(operationData(0, m_iTimeoutGeneration, OP_TIMEOUT), operationData(0, m_iTimeoutGeneration, OP_CANCEL));
+      ++m_iTimeoutGeneration;
+      m_bTimeoutPending = m_ring.prepareTimeout(timeout_ms, operationData(0, m_iTimeoutGeneration, OP_TIMEOUT));
+    }
+
+    int ret = m_ring.submit(timeout_ms == 0 ? 0 : 1);
+    if(ret < 0 && ret != -EINTR && ret != -EBUSY)
+      throw NetworkError("ERROR:: Failed to submit io_uring operations.\n", -ret);
+    return reap_completions();
+  }
+
+  /** Prepares a session's next send, and a receive while responses are awaited
+   * The receive is linked to the send, so that it starts once the request has gone out.
+   * @param[in] id session to prepare
+   */
+  void Reactor::prepare_session(const SessionId id){
+    Session &s = *m_sessions[id];
+    if(s.sock < 0) return;
+
+    if(!s.sending && s.sendBegin == s.sendEnd){
+      s.sendBegin = 0;
+      s.sendEnd = s.netman.takeQueuedRequests(&s.sendBuffer[0], s.sendBuffer.size());
+    }
+    const bool receive = !s.receiving && !s.inFlight.empty();
+    const bool send = !s.sending && s.sendBegin < s.sendEnd;
+    // a send linked to a receive must be submitted together with it, so room is made for both before preparing either
+    if(send && receive && !m_ring.reserve(2))
+      return;
+    if(send){
+      s.sending = m_ring.prepareSend(s.sock, &s.sendBuffer[s.sendBegin], s.sendEnd - s.sendBegin,
+                                     operationData(id, s.generation, OP_SEND), receive);
+    }
+    if(receive){
+      s.receiving = m_ring.prepareReceive(s.sock, &s.recvBuffer[0], s.recvBuffer.size(), s.bufferSlot,
+                                          operationData(id, s.generation, OP_RECEIVE));
+    }
+  }
+
+  /** Handles every completion io_uring has posted
+   * @return number of requests completed
+   */
+  size_t Reactor::reap_completions(){
+    size_t completed = 0;
+    uint64_t userData;
+    int result;
+    while(m_ring.nextCompletion(userData, result))
+      completed += handle_completion(userData, result);
+    return completed;
+  }
+
+  /** Passes the result of an io_uring operation on to its session
+   * @param[in] userData identifies the operation
+   * @param[in] result result of the operation: a byte count, or a negative errno
+   * @return number of requests completed
+   */
+  size_t Reactor::handle_completion(const uint64_t userData, const int result){
+    const eOperation op = (eOperation) (userData & 0xff);
+    const unsigned generation = (unsigned) ((userData >> 8) & 0xffff);
+    const SessionId id = (SessionId) (userData >> 24);
+
+    if(op == OP_TIMEOUT){
+      if(generation == (m_iTimeoutGeneration & 0xffff))
+        m_bTimeoutPending = false;
+      return 0;
+    }
+    if(op == OP_CANCEL || id >= m_sessions.size())
+      return 0;
+
+    Session &s = *m_sessions[id];
+    if(op == OP_SEND)
+      s.sending = false;
+    else
+      s.receiving = false;
+    // the operation belongs to a connection that has been dropped since
+    if(generation != (s.generation & 0xffff) || s.sock < 0)
+      return 0;
+
+    try{
+      if(op == OP_SEND){
+        s.netman.sendCompleted(result);
+        s.sendBegin += result;
+        return 0;
+      }
+      // a receive linked to a send that fell short is cancelled, and prepared again by the next run()
+      if(result == -ECANCELED)
+        return 0;
+      s.netman.receiveCompleted(&s.recvBuffer[0], result);
+      return readResponses(id);
+    }
+    catch(const std::runtime_error &e){
+      return fail(id, e);
+    }
+  }
+
+  /** @return True while a send or receive of any session is in flight
+   */
+  bool Reactor::ring_busy() const{
+    for(SessionId id = 0; id < m_sessions.size(); ++id){
+      if(m_sessions[id]->sending || m_sessions[id]->receiving)
+        return true;
+    }
+    return false;
+  }
+
+
+  /** Looks up a session by id
+   * Throws runtime_error if there is no such session
+   * @param[in] id session id returned by addSession
+   * @return session
+   */
+  Reactor::Session& Reactor::getSession(const SessionId id){
+    if(id >= m_sessions.size())
+      throw std::runtime_error("ERROR:: Unknown Reactor session.");
+    return *m_sessions[id];
+  }
+
+} // close namespace
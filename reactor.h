@@ -0,0 +1,114 @@
+/*  Reactor: Event loop that drives many Rserve sessions from a single thread.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_REACTOR_H_INCLUDED
+#define RCLIENT_REACTOR_H_INCLUDED
+
+#include "config.h"
+#include "network_manager.h"
+#include "rfuture.h"
+#include "uring.h"
+#include <deque>
+
+namespace rclient{
+
+  /** Reactor multiplexes many Rserve sessions on one thread, using epoll on Linux and poll elsewhere.
+   * On Linux it can instead use io_uring, where each call to run() sends and receives for every session with a single
+   * system call. It falls back to epoll if io_uring is unavailable, see isUsingIoUring.
+   * Sessions connect and log in when they are added. Requests are queued without blocking, and are sent
+   * and answered as the sockets become ready while run() is called. Any number of requests may be queued
+   * on a session; Rserve answers them in order.
+   * Requests complete through their RFuture and optional RCallback, on the thread calling run(). Callbacks may
+   * submit further requests, but must not wait on a future of the same Reactor.
+   * A Reactor and its sessions must only be used by one thread at a time.
+   */
+  class RCLIENT_API Reactor{
+
+  public:
+    typedef size_t SessionId;
+
+    explicit Reactor(const bool useIoUring = false);
+    ~Reactor();
+
+    bool isUsingIoUring() const;
+
+    SessionId addSession(const RSTRINGTYPE &host, const int port = 6311, const RSTRINGTYPE &user = "", const RSTRINGTYPE &pwd = "",
+                         const bool allowAnyVersion = false, const ConnectionOptions &options = ConnectionOptions());
+    size_t sessions() const;
+    size_t pending() const;
+
+    RSHARED_PTR<RFuture> submit(const SessionId session, RPacket &packet, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+    RSHARED_PTR<RFuture> eval(const SessionId session, const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+    RSHARED_PTR<RFuture> voidEval(const SessionId session, const RSTRINGTYPE &expr, const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+    RSHARED_PTR<RFuture> assign(const SessionId session, const RSTRINGTYPE &sym, const REXP &expr,
+                                const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+
+    size_t run(const long timeout_ms = -1);
+    size_t runUntilIdle();
+
+  private:
+    Reactor(const Reactor &no_copy); // non construction-copyable
+    Reactor& operator=(const Reactor&); // non-copyable
+
+    /** connection to one Rserve and the requests awaiting its responses
+     */
+    struct Session{
+      Session(const RSTRINGTYPE &host, const int port, const RSTRINGTYPE &user, const RSTRINGTYPE &pwd,
+              const bool allowAnyVersion, const ConnectionOptions &options);
+
+      NetworkManager netman;
+      const RSTRINGTYPE user; // login username, used whenever the session connects
+      const RSTRINGTYPE pwd; // login password
+      int sock; // socket being watched, -1 if not connected
+      bool watchingWrite; // whether the socket is watched for writability
+      std::deque<RSHARED_PTR<RFuture> > inFlight; // requests awaiting their response, oldest first
+
+      // io_uring only
+      RVECTORTYPE<unsigned char> sendBuffer; // request data being sent
+      size_t sendBegin; // start of the data in sendBuffer not yet sent
+      size_t sendEnd; // end of the data in sendBuffer
+      RVECTORTYPE<unsigned char> recvBuffer; // response data being received
+      int bufferSlot; // registered buffer slot of recvBuffer, -1 if not registered
+      bool sending; // whether a send is in flight
+      bool receiving; // whether a receive is in flight
+      unsigned generation; // changes whenever the connection is dropped, so completions for the old one are ignored
+    };
+
+    void connect(const SessionId id);
+    void watch(const SessionId id);
+    void unwatch(const SessionId id);
+    size_t handleEvent(const SessionId id, const bool writable, const bool readable);
+    size_t readResponses(const SessionId id);
+    size_t fail(const SessionId id, const std::runtime_error &error);
+    Session& getSession(const SessionId id);
+
+    size_t run_ring(const long timeout_ms);
+    void prepare_session(const SessionId id);
+    size_t reap_completions();
+    size_t handle_completion(const uint64_t userData, const int result);
+    bool ring_busy() const;
+
+    int m_iPoll; // epoll instance, -1 when poll() or io_uring is used
+    URing m_ring; // open when io_uring is used
+    bool m_bTimeoutPending; // whether a timeout prepared by run() is in flight
+    unsigned m_iTimeoutGeneration; // identifies the latest timeout
+    RVECTORTYPE<RSHARED_PTR<Session> > m_sessions; // indexed by SessionId
+    size_t m_iPending; // requests awaiting their response across all sessions
+  };
+
+} // close namespace
+
+#endif
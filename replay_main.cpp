@@ -0,0 +1,148 @@
+/*  rclient_replay: Inspects, decodes and serves trace files recorded with TrafficRecorder.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h> // for gettimeofday
+
+#include "mock_rserve.h"
+#include "traffic_trace.h"
+
+using namespace std;
+using namespace rclient;
+
+/** prints the command line options
+ * @param[in] name name the program was run as
+ */
+void printUsage(const char *name){
+  cerr << "usage: " << name << " info trace" << endl
+       << "       " << name << " decode trace [-n iterations]" << endl
+       << "       " << name << " serve trace [-p port] [-a address]" << endl
+       << "  info    counts the connections and frames in the trace" << endl
+       << "  decode  parses every recorded response into REXPs, and reports the rate" << endl
+       << "  serve   answers clients with the recorded responses, one recorded connection per client" << endl;
+}
+
+/** @return seconds since the epoch
+ */
+double now(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/** prints a summary of the trace
+ * @param[in] trace trace to summarize
+ */
+void info(const TrafficTrace &trace){
+  const RVECTORTYPE<uint32_t> connections = trace.getConnections();
+  cout << connections.size() << " connections" << endl;
+  for(size_t i = 0; i < connections.size(); ++i){
+    const RVECTORTYPE<TrafficTrace::Record> requests = trace.getRecords(connections[i], TrafficRecorder::TR_REQUEST);
+    const RVECTORTYPE<TrafficTrace::Record> responses = trace.getRecords(connections[i], TrafficRecorder::TR_RESPONSE);
+    size_t bytes = 0;
+    for(size_t j = 0; j < responses.size(); ++j)
+      bytes += responses[j].frame->size();
+    cout << "connection " << connections[i] << ": " << requests.size() << " requests, "
+         << responses.size() << " responses (" << bytes << " bytes)" << endl;
+  }
+}
+
+/** decodes every recorded response, as RClient does after receiving it
+ * @param[in] trace trace to decode
+ * @param[in] iterations number of times to decode the trace
+ */
+void decode(const TrafficTrace &trace, const int iterations){
+  const RVECTORTYPE<TrafficTrace::Record> &records = trace.getRecords();
+  size_t responses = 0, values = 0;
+  double bytes = 0;
+  const double start = now();
+  for(int n = 0; n < iterations; ++n){
+    for(size_t i = 0; i < records.size(); ++i){
+      if(records[i].kind != TrafficRecorder::TR_RESPONSE) continue;
+      RSHARED_PTR<const RPacket> response = TrafficTrace::toPacket(records[i]);
+      RSHARED_PTR<const RVECTORTYPE<RPacket::PacketEntry> > entries = response->getEntries();
+      for(size_t j = 0; j < entries->size(); ++j){
+        if(((*entries)[j].getDataType() & RPacket::PacketEntry::DT_TYPE_MASK) == RPacket::PacketEntry::DT_SEXP && (*entries)[j].toREXP())
+          ++values;
+      }
+      ++responses;
+      bytes += records[i].frame->size();
+    }
+  }
+  const double elapsed = now() - start;
+  cout << responses << " responses, " << values << " REXPs decoded in " << elapsed << " s" << endl;
+  if(elapsed > 0)
+    cout << responses / elapsed << " responses/s, " << bytes / elapsed / 1e6 << " MB/s" << endl;
+}
+
+int main(int argc, char **argv){
+  if(argc < 3){
+    printUsage(argv[0]);
+    return 1;
+  }
+  const string mode = argv[1];
+  const string path = argv[2];
+
+  int iterations = 1;
+  int port = 6311;
+  string address = "127.0.0.1";
+  int option;
+  optind = 3;
+  while((option = getopt(argc, argv, "n:p:a:h")) != -1){
+    switch(option){
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'a':
+      address = optarg;
+      break;
+    default:
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  try{
+    RSHARED_PTR<const TrafficTrace> trace = RMAKE_SHARED<TrafficTrace>(path);
+    if(mode == "info"){
+      info(*trace);
+    }
+    else if(mode == "decode"){
+      decode(*trace, iterations);
+    }
+    else if(mode == "serve"){
+      MockRserve server(port, address);
+      server.replay(trace);
+      cout << "replaying " << path << " on " << address << ":" << server.listen() << endl;
+      server.run();
+    }
+    else{
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  catch(const std::exception &e){
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,42 @@
+/*  RequestTracer: Interface notified of the time spent in each phase of a request.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "request_tracer.h"
+
+#include <sys/time.h> // for gettimeofday
+#include <time.h> // for clock_gettime
+
+namespace rclient{
+
+  /** virtual destructor
+   */
+  RequestTracer::~RequestTracer(){}
+
+
+  /** @return current time in microseconds from an arbitrary start, which does not jump when the system clock is set
+   */
+  long long RequestTracer::now(){
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+    if(clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+      return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long) tv.tv_sec * 1000000 + tv.tv_usec;
+  }
+
+} // close namespace
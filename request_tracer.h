@@ -0,0 +1,64 @@
+/*  RequestTracer: Interface notified of the time spent in each phase of a request.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_REQUEST_TRACER_H_INCLUDED
+#define RCLIENT_REQUEST_TRACER_H_INCLUDED
+
+#include "config.h"
+
+#include <inttypes.h>
+
+namespace rclient{
+
+  /** Interface for consumers that want to know where the time of a request goes: in the client, on the network or in R.
+   * Install a tracer with ConnectionOptions::tracer. Without one, the phases are not timed at all.
+   * A request goes through the phases in order:
+   *  - TP_ENCODE:  RClient builds the request entries. Values assigned with assign are serialized while they are sent, so
+   *                their encoding is part of TP_SEND instead
+   *  - TP_SEND:    the QAP1 header and entries are written to the socket. They go out in the same write, so they are timed together
+   *  - TP_WAIT:    from waiting for the response until its header arrives, which is mostly R evaluating the request
+   *  - TP_RECEIVE: the rest of the response arrives. REXPs passed to an REXPHandler are decoded during this phase
+   *  - TP_DECODE:  RClient::eval decodes the REXP in the response
+   * Requests that fail stop reporting phases at the failure. onPhase is called on the thread doing the work, which is the
+   * I/O thread for asynchronous requests, so a tracer shared by several clients must be thread safe.
+   */
+  class RCLIENT_API RequestTracer{
+
+  public:
+    enum ePhase {
+      TP_ENCODE  = 1,
+      TP_SEND    = 2,
+      TP_WAIT    = 3,
+      TP_RECEIVE = 4,
+      TP_DECODE  = 5
+    };
+
+    virtual ~RequestTracer();
+
+    /** called at the end of each phase. Must not throw
+     * @param[in] phase phase that ended
+     * @param[in] command RPacket::eCMD of the request
+     * @param[in] beginUs time the phase began, see now
+     * @param[in] endUs time the phase ended, see now
+     */
+    virtual void onPhase(const ePhase phase, const uint32_t command, const long long beginUs, const long long endUs) = 0;
+
+    static long long now();
+  };
+
+} // close namespace
+
+#endif
@@ -0,0 +1,144 @@
+/*  ResolverCache: Process-wide cache of resolved Rserve addresses.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "resolver_cache.h"
+#include "request_tracer.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sstream>
+
+namespace{
+
+  /** Custom deleter for rclient_addrinfo calls freeaddrinfo
+   * @param[in] host addrinfo to be freed
+   */
+  void addrinfo_deleter(const rclient_addrinfo *host){
+    freeaddrinfo(const_cast<rclient_addrinfo*>(host));
+  }
+
+  /** default milliseconds to cache a successful lookup
+   */
+  const long DefaultPositiveTTL = 60000;
+
+  /** default milliseconds to cache a failed lookup
+   */
+  const long DefaultNegativeTTL = 5000;
+
+  /** creates the shared cache once, whichever thread uses it first. Function-local statics are not initialized
+   * thread-safely before C++11
+   */
+  pthread_once_t instance_once = PTHREAD_ONCE_INIT;
+
+  /** the shared cache, never destroyed so that it outlives NetworkManagers destroyed during static destruction
+   */
+  rclient::ResolverCache *shared_instance = NULL;
+
+} // close namespace
+
+namespace rclient{
+
+  /** @return the cache shared by the whole process
+   */
+  ResolverCache& ResolverCache::instance(){
+    pthread_once(&instance_once, &ResolverCache::create_instance);
+    return *shared_instance;
+  }
+
+  /** creates the shared cache, called once through pthread_once
+   */
+  void ResolverCache::create_instance(){
+    shared_instance = new ResolverCache();
+  }
+
+  /** constructor uses the default time to live
+   */
+  ResolverCache::ResolverCache():m_iPositiveTTL(DefaultPositiveTTL), m_iNegativeTTL(DefaultNegativeTTL){}
+
+
+  /** Looks up the stream socket addresses of host, using the cached result if it has not expired
+   * @param[in] host host name or IP address
+   * @param[in] port port to connect to
+   * @param[out] error getaddrinfo error code if the lookup failed
+   * @return resolved addresses, or null if the lookup failed
+   */
+  RSHARED_PTR<const rclient_addrinfo> ResolverCache::resolve(const RSTRINGTYPE &host, const int port, int &error){
+    const Key key(host, port);
+    long positiveTTL, negativeTTL;
+    {
+      ScopedLock lock(m_mutex);
+      std::map<Key, Entry>::const_iterator it = m_entries.find(key);
+      if(it != m_entries.end() && it->second.expires > RequestTracer::now() / 1000){
+        error = it->second.error;
+        return it->second.addresses;
+      }
+      positiveTTL = m_iPositiveTTL;
+      negativeTTL = m_iNegativeTTL;
+    }
+
+    // resolve without holding the lock, so a slow lookup does not hold up other hosts
+    rclient_addrinfo *result = NULL;
+    rclient_addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    std::stringstream service;
+    service << port;
+    Entry entry;
+    entry.error = getaddrinfo(host.c_str(), service.str().c_str(), &hints, &result);
+    if(entry.error == 0)
+      // make sure result is freed using freeaddrinfo() once it is no longer cached or in use
+      entry.addresses = RSHARED_PTR<const rclient_addrinfo>(result, addrinfo_deleter);
+
+    const long ttl = entry.addresses ? positiveTTL : negativeTTL;
+    if(ttl > 0){
+      entry.expires = RequestTracer::now() / 1000 + ttl;
+      ScopedLock lock(m_mutex);
+      m_entries[key] = entry;
+    }
+    error = entry.error;
+    return entry.addresses;
+  }
+
+  /** Discards the cached result for host and port, so that the next lookup resolves it again
+   * Called by NetworkManager when none of the addresses could be connected to.
+   * @param[in] host host name or IP address
+   * @param[in] port port to connect to
+   */
+  void ResolverCache::invalidate(const RSTRINGTYPE &host, const int port){
+    ScopedLock lock(m_mutex);
+    m_entries.erase(Key(host, port));
+  }
+
+  /** Discards every cached result
+   */
+  void ResolverCache::clear(){
+    ScopedLock lock(m_mutex);
+    m_entries.clear();
+  }
+
+  /** Sets how long lookups are cached. Applies to lookups made from now on.
+   * @param[in] positive_ms milliseconds a successful lookup is cached, 0 to disable caching
+   * @param[in] negative_ms milliseconds a failed lookup is cached, 0 to disable caching
+   */
+  void ResolverCache::setTimeToLive(const long positive_ms, const long negative_ms){
+    ScopedLock lock(m_mutex);
+    m_iPositiveTTL = positive_ms;
+    m_iNegativeTTL = negative_ms;
+  }
+
+} // close namespace
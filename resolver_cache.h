@@ -0,0 +1,67 @@
+/*  ResolverCache: Process-wide cache of resolved Rserve addresses.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_RESOLVER_CACHE_H_INCLUDED
+#define RCLIENT_RESOLVER_CACHE_H_INCLUDED
+
+#include "config.h"
+#include "thread_sync.h"
+#include <map>
+#include <string>
+#include <utility>
+
+namespace rclient{
+
+  /** Caches getaddrinfo results by host and port so that reconnects do not wait on the resolver.
+   * Failed lookups are cached as well, for a shorter time. NetworkManager invalidates the entry for a host
+   * when it cannot connect to any of its cached addresses, so the next connect resolves the host again.
+   * A single cache is shared by the whole process. It is safe to use from multiple threads.
+   */
+  class RCLIENT_API ResolverCache{
+
+  public:
+    static ResolverCache& instance();
+
+    RSHARED_PTR<const rclient_addrinfo> resolve(const RSTRINGTYPE &host, const int port, int &error);
+    void invalidate(const RSTRINGTYPE &host, const int port);
+    void clear();
+    void setTimeToLive(const long positive_ms, const long negative_ms);
+
+  private:
+    ResolverCache();
+    ResolverCache(const ResolverCache &no_copy); // non construction-copyable
+    ResolverCache& operator=(const ResolverCache&); // non-copyable
+
+    static void create_instance();
+
+    /** result of resolving one host and port
+     */
+    struct Entry{
+      RSHARED_PTR<const rclient_addrinfo> addresses; // resolved addresses, null if the lookup failed
+      int error; // getaddrinfo error if the lookup failed
+      long long expires; // time in milliseconds (see RequestTracer::now) after which the entry is resolved again
+    };
+    typedef std::pair<RSTRINGTYPE, int> Key;
+
+    Mutex m_mutex; // guards all of the members below
+    std::map<Key, Entry> m_entries;
+    long m_iPositiveTTL; // milliseconds a successful lookup is cached, 0 to disable
+    long m_iNegativeTTL; // milliseconds a failed lookup is cached, 0 to disable
+  };
+
+} // close namespace
+
+#endif
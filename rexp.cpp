@@ -17,9 +17,11 @@
 #include "rexp.h"
 #include "rpacket_entry_0103.h"
 #include "rexp_pairlist.h"
+#include "network_writer.h"
 
 #include <string.h>
 #include <sstream>
+#include <stdexcept>
 
 namespace rclient{
 
@@ -289,6 +291,18 @@ namespace rclient{
     return true;
   }
 
+  /** Writes REXP contents in format to be sent to RServe
+   * Serializes the whole REXP with toNetworkData, so types with large data should write it in pieces instead
+   * @param[out] writer receives the network data
+   */
+  void REXP::toNetworkStream(NetworkWriter &writer) const{
+    RVECTORTYPE<unsigned char> buf(bytelength());
+    if(buf.empty()) return;
+    if(!toNetworkData(&buf[0], buf.size()))
+      throw std::runtime_error("ERROR:: Failed to convert REXP to Network Data.");
+    writer.write(&buf[0], buf.size());
+  }
+
   /** returns number of bytes of data to be sent over the network for this REXP
    * used by RPacketEntry in the entry header
    * @return Zero as XT_S4 has no data
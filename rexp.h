@@ -23,6 +23,8 @@
 
 namespace rclient{
 
+  class NetworkWriter;
+
   // forward declarations of PairList for attributes.
   class REXPPairList;
 
@@ -101,6 +103,7 @@ namespace rclient{
     // dont want consumer to have access to these, but needed by rpacket_entry
     // possible use of private + friend here
     virtual bool toNetworkData(unsigned char *buf, const size_t &length) const;
+    virtual void toNetworkStream(NetworkWriter &writer) const;
     virtual size_t bytelength() const;
 
   protected:
@@ -0,0 +1,386 @@
+/*  REXPDecoder: Incremental decoder that reports a REXP to an REXPHandler as its bytes arrive.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "rexp_decoder.h"
+#include "rexp.h"
+#include "endian_converter.h"
+
+#include <string.h>
+#include <algorithm> // for std::min
+#include <stdexcept>
+
+namespace{
+
+  /** most numbers passed to the handler in a single call
+   */
+  const size_t ChunkLength = 1024;
+
+} // close namespace
+
+namespace rclient{
+
+  /** constructor
+   * @param[in] handler receives the decoded REXP. Must outlive the REXPDecoder
+   */
+  REXPDecoder::REXPDecoder(REXPHandler &handler):m_handler(handler), m_bComplete(false), m_iHeaderLength(0), m_iPartialLength(0), m_bTerminated(false){}
+
+  /** destructor
+   */
+  REXPDecoder::~REXPDecoder(){}
+
+
+  /** Decodes the next piece of data, passing every part of the REXP that it completes on to the handler
+   * Data after the end of the REXP is not consumed.
+   * If the data is malformed or the handler throws, the decoder must be reset before it is used again.
+   * @param[in] data next bytes of the REXP
+   * @param[in] length number of bytes in data
+   * @return number of bytes consumed. Less than length only once the REXP is complete
+   */
+  size_t REXPDecoder::feed(const unsigned char *data, const size_t length){
+    size_t consumed = 0;
+    while(!m_bComplete && consumed < length){
+      // lists are made of nested values, each starting with a REXP header
+      if(m_vecFrames.empty() || m_vecFrames.back().kind == K_ATTRIBUTED || m_vecFrames.back().kind == K_LIST || m_vecFrames.back().kind == K_TAGGED_LIST)
+        consumed += read_header(&data[consumed], length - consumed);
+      else
+        consumed += read_data(&data[consumed], length - consumed);
+      finish_values();
+    }
+    return consumed;
+  }
+
+  /** @return True once the whole REXP has been decoded
+   */
+  bool REXPDecoder::isComplete() const{
+    return m_bComplete;
+  }
+
+  /** Discards any partly decoded REXP, so that the decoder can decode a new one
+   */
+  void REXPDecoder::reset(){
+    m_vecFrames.clear();
+    m_bComplete = false;
+    m_iHeaderLength = 0;
+    m_iPartialLength = 0;
+    m_sString.clear();
+    m_bTerminated = false;
+  }
+
+
+  /** Receives a REXP header, then starts the value it describes
+   * @param[in] data next bytes of the REXP
+   * @param[in] length number of bytes in data
+   * @return number of bytes consumed
+   */
+  size_t REXPDecoder::read_header(const unsigned char *data, const size_t length){
+    size_t i = 0;
+    while(i < length){
+      m_aHeader[m_iHeaderLength++] = data[i++];
+      size_t header_length = (m_aHeader[0] & REXP::XT_LARGE ? 8 : 4);
+      if(m_iHeaderLength == header_length){
+        // length is a little-endian 3 or 7 byte integer following the type
+        uint64_t value_length = 0;
+        for(size_t j = 1; j < header_length; ++j)
+          value_length |= (uint64_t) m_aHeader[j] << ((j - 1) * 8);
+        m_iHeaderLength = 0;
+        begin_value(m_aHeader[0], value_length);
+        break;
+      }
+    }
+    return i;
+  }
+
+
+  /** Decodes data of the innermost value, up to its end
+   * @param[in] data next bytes of the REXP
+   * @param[in] length number of bytes in data
+   * @return number of bytes consumed
+   */
+  size_t REXPDecoder::read_data(const unsigned char *data, const size_t length){
+    Frame &frame = m_vecFrames.back();
+    const size_t n = (size_t) std::min(frame.remaining, (uint64_t) length);
+    frame.remaining -= n;
+
+    switch(frame.kind){
+    case K_INTEGERS:
+    case K_DOUBLES:
+      {
+        const size_t width = (frame.kind == K_INTEGERS ? sizeof(int32_t) : sizeof(double));
+        size_t i = 0;
+
+        // finish a number that was split from the previous data
+        if(m_iPartialLength > 0){
+          size_t part = std::min(width - m_iPartialLength, n);
+          memcpy(&m_aPartial[m_iPartialLength], data, part);
+          m_iPartialLength += part;
+          i += part;
+          if(m_iPartialLength < width)
+            break;
+          if(frame.kind == K_INTEGERS)
+            decode_integers(m_aPartial, 1);
+          else
+            decode_doubles(m_aPartial, 1);
+          m_iPartialLength = 0;
+        }
+
+        size_t count = (n - i) / width;
+        if(frame.kind == K_INTEGERS)
+          decode_integers(&data[i], count);
+        else
+          decode_doubles(&data[i], count);
+        i += count * width;
+
+        // keep the start of a number that continues in the next data
+        memcpy(m_aPartial, &data[i], n - i);
+        m_iPartialLength = n - i;
+        break;
+      }
+
+    case K_STRINGS:
+    case K_TAG:
+      {
+        size_t i = 0;
+        while(i < n){
+          // tags are padded after the terminating NUL
+          if(frame.kind == K_TAG && m_bTerminated)
+            break;
+
+          // skip over SOH as it is buffer for the end of the data
+          if(frame.kind == K_STRINGS && m_sString.empty() && data[i] == 0x1){
+            ++i;
+            continue;
+          }
+
+          const unsigned char *end = (const unsigned char*) memchr(&data[i], 0, n - i);
+          size_t len = (end ? end - &data[i] : n - i);
+          m_sString.append((const char*) &data[i], len);
+          i += len;
+          if(end){
+            ++i;
+            if(frame.kind == K_TAG){
+              m_bTerminated = true;
+            }
+            else{
+              m_handler.onString(m_sString);
+              m_sString.clear();
+            }
+          }
+        }
+        break;
+      }
+
+    default:
+      // skipped
+      break;
+    }
+    return n;
+  }
+
+
+  /** Starts a value whose header has been received
+   * Throws runtime_error if the value does not fit in the list holding it
+   * @param[in] type REXP type from the header, including flags
+   * @param[in] length length of the value's data from the header
+   */
+  void REXPDecoder::begin_value(const uint32_t type, const uint64_t length){
+    Frame frame;
+    frame.type = type;
+    frame.remaining = length;
+    frame.kind = K_SKIP;
+    frame.children = 0;
+    frame.silent = false;
+
+    bool isTag = false;
+    if(!m_vecFrames.empty()){
+      Frame &parent = m_vecFrames.back();
+      uint64_t total = length + (type & REXP::XT_LARGE ? 8 : 4);
+      if(total > parent.remaining)
+        throw std::runtime_error("ERROR:: Malformed REXP. Value is longer than the list holding it.");
+      parent.remaining -= total;
+      ++parent.children;
+
+      // every other value in a tagged list is a tag
+      if(parent.kind == K_TAGGED_LIST && parent.children % 2 == 0){
+        if((type & REXP::XT_TYPE_MASK) != REXP::XT_SYMNAME)
+          throw std::runtime_error("ERROR:: Malformed REXP. Tag in list is not a symbol name.");
+        isTag = true;
+      }
+      // attributes are skipped if they are not included
+      else if(parent.kind == K_ATTRIBUTED && !IncludeAttributes){
+        frame.silent = true;
+      }
+    }
+
+    if(isTag){
+      frame.kind = K_TAG;
+      m_sString.clear();
+      m_bTerminated = false;
+      m_vecFrames.push_back(frame);
+    }
+    else if(frame.silent){
+      m_vecFrames.push_back(frame);
+    }
+    else if(type & REXP::XT_HAS_ATTR){
+      // attributes come first, the value's data starts after them
+      frame.kind = K_ATTRIBUTED;
+      m_vecFrames.push_back(frame);
+      if(IncludeAttributes)
+        m_handler.onBeginAttributes();
+    }
+    else{
+      m_vecFrames.push_back(frame);
+      begin_data(m_vecFrames.back());
+    }
+  }
+
+
+  /** Determines how a value's data is decoded, and tells the handler that the value has started
+   * @param[in,out] frame value whose data follows
+   */
+  void REXPDecoder::begin_data(Frame &frame){
+    const uint32_t base_type = frame.type & REXP::XT_TYPE_MASK;
+    frame.children = 0;
+
+    switch(base_type){
+    case REXP::XT_INT:
+    case REXP::XT_ARRAY_INT:
+      frame.kind = K_INTEGERS;
+      m_iPartialLength = 0;
+      m_handler.onBeginIntegers(frame.remaining / sizeof(int32_t));
+      break;
+
+    case REXP::XT_DOUBLE:
+    case REXP::XT_ARRAY_DOUBLE:
+      frame.kind = K_DOUBLES;
+      m_iPartialLength = 0;
+      m_handler.onBeginDoubles(frame.remaining / sizeof(double));
+      break;
+
+    case REXP::XT_STR:
+    case REXP::XT_ARRAY_STR:
+      frame.kind = K_STRINGS;
+      m_sString.clear();
+      m_handler.onBeginStrings();
+      break;
+
+    case REXP::XT_LIST_TAG:
+    case REXP::XT_LANG_TAG:
+      frame.kind = K_TAGGED_LIST;
+      m_handler.onBeginList(base_type);
+      break;
+
+    case REXP::XT_VECTOR:
+    case REXP::XT_VECTOR_EXP:
+    case REXP::XT_LIST_NOTAG:
+    case REXP::XT_LANG_NOTAG:
+      frame.kind = K_LIST;
+      m_handler.onBeginList(base_type);
+      break;
+
+    default:
+      frame.kind = K_SKIP;
+      m_handler.onBeginNull(base_type);
+    }
+  }
+
+
+  /** Ends every value whose data has been decoded completely, innermost first
+   * Throws runtime_error if a tagged list ends with a value that has no tag
+   */
+  void REXPDecoder::finish_values(){
+    while(!m_vecFrames.empty()){
+      Frame &frame = m_vecFrames.back();
+
+      if(frame.kind == K_ATTRIBUTED){
+        // the value's data starts once its attributes have ended
+        if(frame.children == 0 && frame.remaining > 0)
+          return;
+        begin_data(frame);
+        continue;
+      }
+      if(frame.remaining > 0)
+        return;
+
+      switch(frame.kind){
+      case K_TAG:
+        m_handler.onTag(m_sString);
+        m_sString.clear();
+        break;
+
+      case K_TAGGED_LIST:
+        if(frame.children % 2)
+          throw std::runtime_error("ERROR:: Malformed REXP. Value in tagged list has no tag.");
+        m_handler.onEnd();
+        break;
+
+      case K_SKIP:
+        if(!frame.silent)
+          m_handler.onEnd();
+        break;
+
+      default:
+        // an unterminated string or a partial number at the end of the data is dropped
+        m_sString.clear();
+        m_iPartialLength = 0;
+        m_handler.onEnd();
+      }
+
+      m_vecFrames.pop_back();
+      if(m_vecFrames.empty())
+        m_bComplete = true;
+    }
+  }
+
+
+  /** Converts little-endian integers and passes them on to the handler
+   * @param[in] data count integers as sent by Rserve
+   * @param[in] count number of integers in data
+   */
+  void REXPDecoder::decode_integers(const unsigned char *data, const size_t count){
+    int32_t values[ChunkLength];
+    size_t done = 0;
+    while(done < count){
+      size_t n = std::min(count - done, ChunkLength);
+      for(size_t j = 0; j < n; ++j){
+        const unsigned char *p = &data[(done + j) * sizeof(int32_t)];
+        values[j] = (int32_t) ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+      }
+      m_handler.onIntegerChunk(values, n);
+      done += n;
+    }
+  }
+
+  /** Converts little-endian doubles and passes them on to the handler
+   * @param[in] data count doubles as sent by Rserve
+   * @param[in] count number of doubles in data
+   */
+  void REXPDecoder::decode_doubles(const unsigned char *data, const size_t count){
+    EndianConverter converter;
+    double values[ChunkLength];
+    size_t done = 0;
+    while(done < count){
+      size_t n = std::min(count - done, ChunkLength);
+      for(size_t j = 0; j < n; ++j){
+        double network_double;
+        memcpy(&network_double, &data[(done + j) * sizeof(double)], sizeof(double));
+        values[j] = converter.swap_endian(network_double);
+      }
+      m_handler.onDoubleChunk(values, n);
+      done += n;
+    }
+  }
+
+} // close namespace
@@ -0,0 +1,90 @@
+/*  REXPDecoder: Incremental decoder that reports a REXP to an REXPHandler as its bytes arrive.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_REXP_DECODER_H_INCLUDED
+#define RCLIENT_REXP_DECODER_H_INCLUDED
+
+#include "config.h"
+#include "rexp_handler.h"
+
+#include <inttypes.h>
+
+namespace rclient{
+
+  /** Decodes one REXP in the Rserve network format, as found in a DT_SEXP entry, from data that is fed to it
+   * in pieces of any size. Each part of the REXP is passed on to the handler as soon as it has been received,
+   * so neither the network data nor the decoded REXP has to be held in memory.
+   * Throws runtime_error if the data is malformed.
+   */
+  class RCLIENT_API REXPDecoder{
+
+  public:
+    explicit REXPDecoder(REXPHandler &handler);
+    ~REXPDecoder();
+
+    size_t feed(const unsigned char *data, const size_t length);
+    bool isComplete() const;
+    void reset();
+
+  private:
+    REXPDecoder(const REXPDecoder &no_copy); // non construction-copyable
+    REXPDecoder& operator=(const REXPDecoder&); // non-copyable
+
+    // how the data of a value is decoded
+    enum eKind {
+      K_ATTRIBUTED,   // value whose attributes have not been decoded yet
+      K_LIST,         // list of values
+      K_TAGGED_LIST,  // list of values, each followed by its tag
+      K_TAG,          // tag of a value in a tagged list
+      K_INTEGERS,
+      K_DOUBLES,
+      K_STRINGS,
+      K_SKIP          // data that is not decoded
+    };
+
+    /** value that is being decoded
+     */
+    struct Frame{
+      uint32_t type; // REXP type, including flags
+      uint64_t remaining; // bytes of data not yet decoded or assigned to a nested value
+      eKind kind;
+      size_t children; // number of nested values started so far
+      bool silent; // if set, no events are sent for the value
+    };
+
+    REXPHandler &m_handler; // receives the decoded parts
+    RVECTORTYPE<Frame> m_vecFrames; // values being decoded, outermost first
+    bool m_bComplete; // whether the whole REXP has been decoded
+
+    unsigned char m_aHeader[8]; // REXP header being received
+    size_t m_iHeaderLength; // bytes of m_aHeader received so far
+    unsigned char m_aPartial[8]; // number split between two pieces of data
+    size_t m_iPartialLength; // bytes of m_aPartial received so far
+    RSTRINGTYPE m_sString; // string being received
+    bool m_bTerminated; // whether the tag being received has ended
+
+    size_t read_header(const unsigned char *data, const size_t length);
+    size_t read_data(const unsigned char *data, const size_t length);
+    void begin_value(const uint32_t type, const uint64_t length);
+    void begin_data(Frame &frame);
+    void finish_values();
+    void decode_integers(const unsigned char *data, const size_t count);
+    void decode_doubles(const unsigned char *data, const size_t count);
+  };
+
+} // close namespace
+
+#endif
@@ -16,11 +16,18 @@
 
 #include "rexp_double.h"
 #include "endian_converter.h"
+#include "network_writer.h"
+#include "na_translator.h"
 
 #include <string.h>
+#include <algorithm> // for std::min
 
 namespace{
 
+  // bits of a double compared by isRserve_NA, and their value for NA
+  const uint64_t RserveNAMask = 0xfff7ffffffffffffL;
+  const uint64_t RserveNABits = 0x7ff00000000007a2L;
+
   /* RServe's double NA representation is NaN and must be declared using a union.
    * @return Rserve's double NA representation.
    */
@@ -39,8 +46,18 @@ namespace{
     union {uint64_t ui64; double d;} val_u;
     val_u.d = val;
     // mask to prevent the conversion to QNaN
-    val_u.ui64 = val_u.ui64 & 0xfff7ffffffffffffL;
-    return ( val_u.ui64 == 0x7ff00000000007a2L);    
+    val_u.ui64 = val_u.ui64 & RserveNAMask;
+    return ( val_u.ui64 == RserveNABits);    
+  }
+
+  /* Retrieves the bits of a double, to match them exactly with NATranslator.
+   * @param[in] val double to convert.
+   * @return bits of val.
+   */
+  uint64_t doubleBits(const double &val){
+    union {uint64_t ui64; double d;} val_u;
+    val_u.d = val;
+    return val_u.ui64;
   }
 
 
@@ -74,17 +91,24 @@ namespace rclient{
    */
   template<typename DoubleType>
   void REXPDouble::initData(const RVECTORTYPE<DoubleType> &vals, const double &consumerNAValue){
-    m_vecData.reserve(vals.size());
-    for(size_t i = 0; i < vals.size(); ++i){
-      if(isConsumer_NA(vals[i], consumerNAValue))
-	m_vecData.push_back(getNARepresentation());
-      else
-	m_vecData.push_back(vals[i]);
-    }
+    m_vecData.assign(vals.begin(), vals.end());
+    if(!m_vecData.empty())
+      NATranslator::translate(&m_vecData[0], &m_vecData[0], m_vecData.size(), ~static_cast<uint64_t>(0), doubleBits(consumerNAValue), getNARepresentation());
   }
   template void REXPDouble::initData<double>(const RVECTORTYPE<double> &vals, const double &consumerNAValue);
   template void REXPDouble::initData<float>(const RVECTORTYPE<float> &vals, const double &consumerNAValue);
 
+  /** Takes the contents of vals, translating the consumer's NA representation to R's unless they are already R's
+   * @param[in,out] vals vector of doubles to adopt, left empty
+   * @param[in] adopt whether the NA values of vals already use R's representation
+   * @param[in] consumerNAValue NA representation for doubles used by the consumer
+   */
+  void REXPDouble::adoptData(RVECTORTYPE<double> &vals, const AdoptTag &adopt, const double &consumerNAValue){
+    m_vecData.swap(vals);
+    if(!adopt.naEncoded && !m_vecData.empty())
+      NATranslator::translate(&m_vecData[0], &m_vecData[0], m_vecData.size(), ~static_cast<uint64_t>(0), doubleBits(consumerNAValue), getNARepresentation());
+  }
+
 
   /** basic constructor initializes an empty vector
    */
@@ -97,7 +121,7 @@ namespace rclient{
   /** Copy constructor.
    * @param[in] exp REXPDouble to copy data from
    */
-  REXPDouble::REXPDouble(const REXPDouble &exp):REXPVector(XT_ARRAY_DOUBLE, exp.getData().size() * sizeof(double)), m_vecData(exp.getData()){
+  REXPDouble::REXPDouble(const REXPDouble &exp):REXPVector(XT_ARRAY_DOUBLE, exp.bytelength()), m_vecData(exp.m_vecData){
     if(exp.hasAttributes())
       REXP::setAttributes(exp.getAttributes());
   }
@@ -157,6 +181,25 @@ namespace rclient{
     initData(vals, consumerNAValue);
   }
 
+  /** constructor adopts the provided vector<double> instead of copying it
+   * @param[in,out] vals vector<double> whose contents become m_vecData, left empty
+   * @param[in] adopt Adopt to translate the consumer's NA values, AdoptNAEncoded if vals already uses R's NA
+   * @param[in] consumerNAValue NA representation for doubles used by the consumer
+   */
+  REXPDouble::REXPDouble(RVECTORTYPE<double> &vals, const AdoptTag &adopt, const double &consumerNAValue):REXPVector(XT_ARRAY_DOUBLE, vals.size()*sizeof(double)){
+    adoptData(vals, adopt, consumerNAValue);
+  }
+
+  /** constructor adopts the provided vector<double> instead of copying it. Constructor for REXP with Attributes
+   * @param[in,out] vals vector<double> whose contents become m_vecData, left empty
+   * @param[in] attr pointer to REXPPairList containing this REXP's attributes
+   * @param[in] adopt Adopt to translate the consumer's NA values, AdoptNAEncoded if vals already uses R's NA
+   * @param[in] consumerNAValue NA representation for doubles used by the consumer
+   */
+  REXPDouble::REXPDouble(RVECTORTYPE<double> &vals, const RSHARED_PTR<const REXPPairList> &attr, const AdoptTag &adopt, const double &consumerNAValue):REXPVector(attr, XT_ARRAY_DOUBLE, vals.size()*sizeof(double)){
+    adoptData(vals, adopt, consumerNAValue);
+  }
+
   /** swap contents of one instance with another
    *  @param[in] exp REXPDouble instance to swap with this
    */
@@ -179,14 +222,9 @@ namespace rclient{
    * @return const vector<double> m_vecData
    */
   RVECTORTYPE<double> REXPDouble::getData(const double &consumerNAValue) const{
-    RVECTORTYPE<double> retval;
-    retval.reserve(m_vecData.size());
-    for(size_t i = 0; i < m_vecData.size(); ++i){
-      if(isRserve_NA(m_vecData[i]))
-        retval.push_back(consumerNAValue);
-      else
-        retval.push_back(m_vecData[i]);
-    }
+    RVECTORTYPE<double> retval(m_vecData);
+    if(!retval.empty())
+      NATranslator::translate(&retval[0], &retval[0], retval.size(), RserveNAMask, RserveNABits, consumerNAValue);
     return retval;
   }
 
@@ -196,12 +234,23 @@ namespace rclient{
    */
   void REXPDouble::fillData(RVECTORTYPE<double> &buf, const double &consumerNAValue) const{
     buf.resize(m_vecData.size());
-    for(size_t i = 0; i < m_vecData.size(); ++i){
-      if(isRserve_NA(m_vecData[i]))
-        buf[i] = consumerNAValue;
-      else
-        buf[i] = m_vecData[i];
-    }
+    if(!buf.empty())
+      NATranslator::translate(&buf[0], &m_vecData[0], m_vecData.size(), RserveNAMask, RserveNABits, consumerNAValue);
+  }
+
+  /** Retrieve the contents of m_vecData without copying them
+   * NA values are R's NA, which isNA recognizes
+   * @return view of m_vecData, valid while this REXPDouble is unchanged
+   */
+  RDataView<double> REXPDouble::getView() const{
+    return RDataView<double>(m_vecData.empty() ? NULL : &m_vecData[0], m_vecData.size());
+  }
+
+  /** Checks whether any of the doubles is NA
+   * @return true if m_vecData contains R's NA
+   */
+  bool REXPDouble::hasNA() const{
+    return !m_vecData.empty() && NATranslator::contains(&m_vecData[0], m_vecData.size(), RserveNAMask, RserveNABits);
   }
 
 
@@ -209,10 +258,19 @@ namespace rclient{
    * @param[in] val double to be compared to m_dNA to determine if it is considered NA
    * @return true if val is NA, false otherwise
    */
-  bool REXPDouble::isNA(const double &val){
+  bool REXPDouble::isNA(const double &val) const{
     return isRserve_NA(val);
   }
 
+  /** Non-const form of isNA, which was the only one before isNA became const. Subclasses that override it keep working
+   * for calls on non-const objects; it forwards to the const isNA
+   * @param[in] val double to be compared to determine if it is considered NA
+   * @return true if val is NA, false otherwise
+   */
+  bool REXPDouble::isNA(const double &val){
+    return static_cast<const REXPDouble&>(*this).isNA(val);
+  }
+
   /** Returns R interpretation of NA double
    * @return R interpretation of NA double
    */
@@ -238,6 +296,26 @@ namespace rclient{
     return true;
   }
 
+  /** writes the doubles to the network a chunk at a time, in little endian order
+   * @param[out] writer receives the network data
+   */
+  void REXPDouble::toNetworkStream(NetworkWriter &writer) const{
+    EndianConverter converter;
+
+    size_t i = 0;
+    while(i < m_vecData.size()){
+      size_t available;
+      unsigned char *buf = writer.reserve(available, sizeof(double));
+      size_t n = std::min(available / sizeof(double), m_vecData.size() - i);
+      for(size_t j = 0; j < n; ++j){
+        double network_double = converter.swap_endian(m_vecData[i+j]);
+        memcpy(&buf[j*sizeof(double)], &network_double, sizeof(double));
+      }
+      writer.commit(n*sizeof(double));
+      i += n;
+    }
+  }
+
   /** returns number of bytes of data being passed over the network
    * used by RPacketEntry in the entry header
    * @return number of bytes in m_vecData
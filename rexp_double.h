@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "rexp_vector.h"
+#include "rdata_view.h"
 
 namespace rclient{
 
@@ -42,22 +43,30 @@ namespace rclient{
     REXPDouble(const RVECTORTYPE<double> &vals, const RSHARED_PTR<const REXPPairList> &attr, const double &consumerNAValue = NA);
     REXPDouble(const RVECTORTYPE<float> &vals, const RSHARED_PTR<const REXPPairList> &attr, const double &consumerNAValue = NA);
 
+    REXPDouble(RVECTORTYPE<double> &vals, const AdoptTag &adopt, const double &consumerNAValue = NA);
+    REXPDouble(RVECTORTYPE<double> &vals, const RSHARED_PTR<const REXPPairList> &attr, const AdoptTag &adopt, const double &consumerNAValue = NA);
+
     virtual size_t length() const;
-    virtual bool isNA(const double &val);
+    virtual bool isNA(const double &val) const;
+    virtual bool isNA(const double &val); // non-const form kept for subclasses that override it
     virtual double getNARepresentation() const;
     virtual RVECTORTYPE<double> getData(const double &consumerNAValue = NA) const;
     virtual void fillData(RVECTORTYPE<double> &buf, const double &consumerNAValue = NA) const;
+    RDataView<double> getView() const;
+    bool hasNA() const;
 
     // for network packet entries
     // dont want consumer to have access to these, but needed by rpacket_entry
     // possible use of private + friend here
     virtual bool toNetworkData(unsigned char *buf, const size_t &length) const;
+    virtual void toNetworkStream(NetworkWriter &writer) const;
     virtual size_t bytelength() const;
   
   private:
     RVECTORTYPE<double> m_vecData;
     template<typename DoubleType>
       void initData(const RVECTORTYPE<DoubleType> &vals, const double &consumerNAValue);
+    void adoptData(RVECTORTYPE<double> &vals, const AdoptTag &adopt, const double &consumerNAValue);
   };
 } // close namespace
 #endif
@@ -0,0 +1,82 @@
+/*  REXPHandler: Receives the parts of a REXP as REXPDecoder decodes them.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "rexp_handler.h"
+
+namespace rclient{
+
+  /** virtual destructor
+   */
+  REXPHandler::~REXPHandler(){}
+
+
+  /** called when a list starts. Its values follow, then onEnd
+   * @param[in] type REXP type of the list, without flags (e.g. XT_VECTOR, XT_LIST_TAG)
+   */
+  void REXPHandler::onBeginList(const uint32_t type){}
+
+  /** called after each value of a tagged list
+   * @param[in] tag name of the value that just ended
+   */
+  void REXPHandler::onTag(const RSTRINGTYPE &tag){}
+
+  /** called before a value that has attributes. The attributes follow as a tagged list, then the value itself
+   */
+  void REXPHandler::onBeginAttributes(){}
+
+
+  /** called when an integer vector starts
+   * @param[in] count number of integers in the vector
+   */
+  void REXPHandler::onBeginIntegers(const size_t count){}
+
+  /** called with the next integers of the vector, as they are received
+   * @param[in] data integers in host byte order
+   * @param[in] count number of integers in data
+   */
+  void REXPHandler::onIntegerChunk(const int32_t *data, const size_t count){}
+
+  /** called when a double vector starts
+   * @param[in] count number of doubles in the vector
+   */
+  void REXPHandler::onBeginDoubles(const size_t count){}
+
+  /** called with the next doubles of the vector, as they are received
+   * @param[in] data doubles in host byte order
+   * @param[in] count number of doubles in data
+   */
+  void REXPHandler::onDoubleChunk(const double *data, const size_t count){}
+
+  /** called when a string vector starts
+   */
+  void REXPHandler::onBeginStrings(){}
+
+  /** called with each string of the vector, once it has been received completely
+   * @param[in] str next string
+   */
+  void REXPHandler::onString(const RSTRINGTYPE &str){}
+
+  /** called for a value that RClient does not decode, including NULL. Its data is skipped
+   * @param[in] type REXP type of the value, without flags
+   */
+  void REXPHandler::onBeginNull(const uint32_t type){}
+
+
+  /** called when the most recently started value is complete
+   */
+  void REXPHandler::onEnd(){}
+
+} // close namespace
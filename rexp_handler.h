@@ -0,0 +1,57 @@
+/*  REXPHandler: Receives the parts of a REXP as REXPDecoder decodes them.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_REXP_HANDLER_H_INCLUDED
+#define RCLIENT_REXP_HANDLER_H_INCLUDED
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <string>
+
+namespace rclient{
+
+  /** Interface for consumers that want to process a REXP while it is received, without building it in memory.
+   * Events arrive in the order the data is sent. Every value starts with one of the onBegin functions and
+   * finishes with onEnd. The values in a list come between the list's onBeginList and onEnd, and in a tagged
+   * list each value is followed by onTag. If a value has attributes, onBeginAttributes and the attributes
+   * (a tagged list) come before the value's onBegin function.
+   * Numbers are passed on as sent by R, so NA is R's NA value rather than a consumer NA value.
+   * Pointers are only valid during the call. The default implementations ignore the event.
+   */
+  class RCLIENT_API REXPHandler{
+
+  public:
+    virtual ~REXPHandler();
+
+    virtual void onBeginList(const uint32_t type);
+    virtual void onTag(const RSTRINGTYPE &tag);
+    virtual void onBeginAttributes();
+
+    virtual void onBeginIntegers(const size_t count);
+    virtual void onIntegerChunk(const int32_t *data, const size_t count);
+    virtual void onBeginDoubles(const size_t count);
+    virtual void onDoubleChunk(const double *data, const size_t count);
+    virtual void onBeginStrings();
+    virtual void onString(const RSTRINGTYPE &str);
+    virtual void onBeginNull(const uint32_t type);
+
+    virtual void onEnd();
+  };
+
+} // close namespace
+
+#endif
@@ -16,9 +16,12 @@
 
 #include "rexp_integer.h"
 #include "endian_converter.h"
+#include "network_writer.h"
+#include "na_translator.h"
 
 #include <string.h>
 #include <limits>
+#include <algorithm> // for std::min
 
 namespace rclient{
 
@@ -31,16 +34,23 @@ namespace rclient{
    * @param[in] consumerNAValue NA representation for integers used by the consumer
    */
   void REXPInteger::initData(const RVECTORTYPE<int32_t> &vals, const int32_t &consumerNAValue){
-    m_vecData.reserve(vals.size());
-    for(size_t i = 0; i < vals.size(); ++i){
-      if (vals[i] == consumerNAValue)
-	m_vecData.push_back(getNARepresentation());
-      else
-	m_vecData.push_back(vals[i]);
-    }
+    m_vecData.resize(vals.size());
+    if(!vals.empty())
+      NATranslator::translate(&m_vecData[0], &vals[0], vals.size(), consumerNAValue, getNARepresentation());
   }
   
 
+  /** Takes the contents of vals, translating the consumer's NA representation to R's unless they are already R's
+   * @param[in,out] vals vector of integers to adopt, left empty
+   * @param[in] adopt whether the NA values of vals already use R's representation
+   * @param[in] consumerNAValue NA representation for integers used by the consumer
+   */
+  void REXPInteger::adoptData(RVECTORTYPE<int32_t> &vals, const AdoptTag &adopt, const int32_t &consumerNAValue){
+    m_vecData.swap(vals);
+    if(!adopt.naEncoded && !m_vecData.empty())
+      NATranslator::translate(&m_vecData[0], &m_vecData[0], m_vecData.size(), consumerNAValue, getNARepresentation());
+  }
+
   /** basic constructor initializes an empty vector
    */
   REXPInteger::REXPInteger():REXPVector(XT_ARRAY_INT),m_vecData(0){}
@@ -53,7 +63,7 @@ namespace rclient{
   /** Copy constructor.
    * @param[in] exp REXPInteger to copy data from
    */
-  REXPInteger::REXPInteger(const REXPInteger &exp):REXPVector(XT_ARRAY_INT, exp.getData().size() * sizeof(int32_t)), m_vecData(exp.getData()){
+  REXPInteger::REXPInteger(const REXPInteger &exp):REXPVector(XT_ARRAY_INT, exp.bytelength()), m_vecData(exp.m_vecData){
     if(exp.hasAttributes())
       REXP::setAttributes(exp.getAttributes());
   }
@@ -95,6 +105,25 @@ namespace rclient{
     initData(vals, consumerNAValue);
   }
 
+  /** constructor adopts the provided vector<int32_t> instead of copying it
+   * @param[in,out] vals vector<int32_t> whose contents become m_vecData, left empty
+   * @param[in] adopt Adopt to translate the consumer's NA values, AdoptNAEncoded if vals already uses R's NA
+   * @param[in] consumerNAValue NA representation for integers used by the consumer
+   */
+  REXPInteger::REXPInteger(RVECTORTYPE<int32_t> &vals, const AdoptTag &adopt, const int32_t &consumerNAValue):REXPVector(XT_ARRAY_INT, vals.size()*sizeof(int32_t)){
+    adoptData(vals, adopt, consumerNAValue);
+  }
+
+  /** constructor adopts the provided vector<int32_t> instead of copying it. Constructor for REXP with Attributes
+   * @param[in,out] vals vector<int32_t> whose contents become m_vecData, left empty
+   * @param[in] attr pointer to REXPPairList containing this REXP's attributes
+   * @param[in] adopt Adopt to translate the consumer's NA values, AdoptNAEncoded if vals already uses R's NA
+   * @param[in] consumerNAValue NA representation for integers used by the consumer
+   */
+  REXPInteger::REXPInteger(RVECTORTYPE<int32_t> &vals, const RSHARED_PTR<const REXPPairList> &attr, const AdoptTag &adopt, const int32_t &consumerNAValue):REXPVector(attr, XT_ARRAY_INT, vals.size()*sizeof(int32_t)){
+    adoptData(vals, adopt, consumerNAValue);
+  }
+
   /** swap contents of one instance with another
    *  @param[in] exp REXPInteger instance to swap with this
    */
@@ -117,14 +146,9 @@ namespace rclient{
    * @return const vector<int32_t> m_vecData
    */
   RVECTORTYPE<int32_t> REXPInteger::getData(const int32_t &consumerNAValue) const{
-    RVECTORTYPE<int32_t> retval;
-    retval.reserve(m_vecData.size());
-    for(size_t i = 0; i < m_vecData.size(); ++i){
-      if (m_vecData[i] == getNARepresentation())
-	retval.push_back(consumerNAValue);
-      else
-	retval.push_back(m_vecData[i]);
-    }
+    RVECTORTYPE<int32_t> retval(m_vecData);
+    if(!retval.empty())
+      NATranslator::translate(&retval[0], &retval[0], retval.size(), getNARepresentation(), consumerNAValue);
     return retval;
   }
 
@@ -135,12 +159,23 @@ namespace rclient{
    */
   void REXPInteger::fillData(RVECTORTYPE<int32_t> &buf, const int32_t &consumerNAValue) const{
     buf.resize(m_vecData.size());
-    for(size_t i = 0; i < m_vecData.size(); ++i){
-      if (m_vecData[i] == getNARepresentation())
-	buf[i] = consumerNAValue;
-      else
-	buf[i] = m_vecData[i];
-    }
+    if(!buf.empty())
+      NATranslator::translate(&buf[0], &m_vecData[0], m_vecData.size(), getNARepresentation(), consumerNAValue);
+  }
+
+  /** Retrieve the contents of m_vecData without copying them
+   * NA values are R's NA, which isNA recognizes
+   * @return view of m_vecData, valid while this REXPInteger is unchanged
+   */
+  RDataView<int32_t> REXPInteger::getView() const{
+    return RDataView<int32_t>(m_vecData.empty() ? NULL : &m_vecData[0], m_vecData.size());
+  }
+
+  /** Checks whether any of the integers is NA
+   * @return true if m_vecData contains R's NA
+   */
+  bool REXPInteger::hasNA() const{
+    return !m_vecData.empty() && NATranslator::contains(&m_vecData[0], m_vecData.size(), NA);
   }
 
 
@@ -148,10 +183,19 @@ namespace rclient{
    * @param[in] val integer to be compared to determine if it is considered NA
    * @return true if val is NA, false otherwise
    */
-  bool REXPInteger::isNA(const int32_t &val){
+  bool REXPInteger::isNA(const int32_t &val) const{
     return val == NA; //-2147483648
   }
 
+  /** Non-const form of isNA, which was the only one before isNA became const. Subclasses that override it keep working
+   * for calls on non-const objects; it forwards to the const isNA
+   * @param[in] val integer to be compared to determine if it is considered NA
+   * @return true if val is NA, false otherwise
+   */
+  bool REXPInteger::isNA(const int32_t &val){
+    return static_cast<const REXPInteger&>(*this).isNA(val);
+  }
+
   /** Returns R interpretation of NA integer
    * @return R interpretation of NA integer
    */
@@ -181,6 +225,30 @@ namespace rclient{
     return true;
   }
 
+  /** writes the integers to the network a chunk at a time, in little endian order
+   * @param[out] writer receives the network data
+   */
+  void REXPInteger::toNetworkStream(NetworkWriter &writer) const{
+    EndianConverter converter;
+
+    RVECTORTYPE<uint8_t> serialized_int;
+    serialized_int.resize(sizeof(uint32_t));
+
+    size_t i = 0;
+    while(i < m_vecData.size()){
+      size_t available;
+      unsigned char *buf = writer.reserve(available, sizeof(uint32_t));
+      size_t n = std::min(available / sizeof(uint32_t), m_vecData.size() - i);
+      for(size_t j = 0; j < n; ++j){
+        size_t pos = 0;
+        converter.serialize<uint32_t>(serialized_int, pos, m_vecData[i+j]);
+        memcpy(&buf[j*sizeof(uint32_t)], &serialized_int[0], sizeof(uint32_t));
+      }
+      writer.commit(n*sizeof(uint32_t));
+      i += n;
+    }
+  }
+
 
   /** returns number of bytes of data being passed over the network
    * used by RPacketEntry in the entry header
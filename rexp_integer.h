@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "rexp_vector.h"
+#include "rdata_view.h"
 
 namespace rclient{
 
@@ -37,23 +38,30 @@ namespace rclient{
     explicit REXPInteger(const int32_t &val, const int32_t &consumerNAValue = NA);
     explicit REXPInteger(const RVECTORTYPE<int32_t> &vals, const int32_t &consumerNAValue = NA);
     REXPInteger(const RVECTORTYPE<int32_t> &vals, const RSHARED_PTR<const REXPPairList> &attr, const int32_t &consumerNAValue = NA);
+    REXPInteger(RVECTORTYPE<int32_t> &vals, const AdoptTag &adopt, const int32_t &consumerNAValue = NA);
+    REXPInteger(RVECTORTYPE<int32_t> &vals, const RSHARED_PTR<const REXPPairList> &attr, const AdoptTag &adopt, const int32_t &consumerNAValue = NA);
     void swap(REXPInteger &exp);
 
     virtual size_t length() const;
-    virtual bool isNA(const int32_t &val);
+    virtual bool isNA(const int32_t &val) const;
+    virtual bool isNA(const int32_t &val); // non-const form kept for subclasses that override it
     virtual int32_t getNARepresentation() const;
     virtual RVECTORTYPE<int32_t> getData(const int32_t &consumerNAValue = NA) const;
     virtual void fillData(RVECTORTYPE<int32_t> &buf, const int32_t &consumerNAValue = NA) const;
+    RDataView<int32_t> getView() const;
+    bool hasNA() const;
 
     // for network packet entries
     // dont want consumer to have access to these, but needed by rpacket_entry
     // possible use of private + friend here
     virtual bool toNetworkData(unsigned char *buf, const size_t &length) const;
+    virtual void toNetworkStream(NetworkWriter &writer) const;
     virtual size_t bytelength() const;
   
   private:
     RVECTORTYPE<int32_t> m_vecData;
     void initData(const RVECTORTYPE<int32_t> &vals, const int32_t &consumerNAValue);
+    void adoptData(RVECTORTYPE<int32_t> &vals, const AdoptTag &adopt, const int32_t &consumerNAValue);
 
   };
 
@@ -15,6 +15,7 @@
  */
 
 #include "rexp_string.h"
+#include "network_writer.h"
 
 #include <string.h>
 
@@ -60,6 +61,21 @@ namespace rclient{
     }
   }
 
+  /** Takes the contents of vals, translating the consumer's NA representation to R's unless they are already R's
+   * @param[in,out] vals vector of strings to adopt, left empty
+   * @param[in] adopt whether the NA values of vals already use R's representation
+   * @param[in] consumerNAValue NA representation for strings used by the consumer
+   */
+  void REXPString::adoptData(RVECTORTYPE<RSTRINGTYPE> &vals, const AdoptTag &adopt, const RSTRINGTYPE &consumerNAValue){
+    m_vecData.swap(vals);
+    if(adopt.naEncoded || consumerNAValue == NA)
+      return;
+    for(size_t i = 0; i < m_vecData.size(); ++i){
+      if (m_vecData[i] == consumerNAValue)
+	m_vecData[i] = NA;
+    }
+  }
+
   /** basic constructor initializes an empty vector
    */
   REXPString::REXPString():REXPVector(XT_ARRAY_STR),m_vecData(0){}
@@ -71,7 +87,7 @@ namespace rclient{
   /** Copy constructor.
    * @param[in] exp REXPString to copy data from
    */
-  REXPString::REXPString(const REXPString &exp):REXPVector(XT_ARRAY_STR, getBytelength(exp.getData())), m_vecData(exp.getData()){
+  REXPString::REXPString(const REXPString &exp):REXPVector(XT_ARRAY_STR, getBytelength(exp.m_vecData)), m_vecData(exp.m_vecData){
     if(exp.hasAttributes())
       REXP::setAttributes(exp.getAttributes());
   }
@@ -112,6 +128,25 @@ namespace rclient{
     initData(strVec, consumerNAValue);
   }
 
+  /** constructor adopts the provided vector<RSTRINGTYPE> instead of copying it
+   * @param[in,out] strVec vector of strings whose contents become m_vecData, left empty
+   * @param[in] adopt Adopt to translate the consumer's NA values, AdoptNAEncoded if strVec already uses R's NA
+   * @param[in] consumerNAValue NA representation for strings used by the consumer
+   */
+  REXPString::REXPString(RVECTORTYPE<RSTRINGTYPE> &strVec, const AdoptTag &adopt, const RSTRINGTYPE &consumerNAValue):REXPVector(XT_ARRAY_STR, getBytelength(strVec)){
+    adoptData(strVec, adopt, consumerNAValue);
+  }
+
+  /** constructor adopts the provided vector<RSTRINGTYPE> instead of copying it. Constructor for REXP with attributes
+   * @param[in,out] strVec vector of strings whose contents become m_vecData, left empty
+   * @param[in] attr pointer to REXPPairList containing this REXP's attributes
+   * @param[in] adopt Adopt to translate the consumer's NA values, AdoptNAEncoded if strVec already uses R's NA
+   * @param[in] consumerNAValue NA representation for strings used by the consumer
+   */
+  REXPString::REXPString(RVECTORTYPE<RSTRINGTYPE> &strVec, const RSHARED_PTR<const REXPPairList> &attr, const AdoptTag &adopt, const RSTRINGTYPE &consumerNAValue):REXPVector(attr, XT_ARRAY_STR, getBytelength(strVec)){
+    adoptData(strVec, adopt, consumerNAValue);
+  }
+
   /** swap contents of one instance with another
    *  @param[in] exp REXPString instance to swap with this
    */
@@ -159,16 +194,44 @@ namespace rclient{
     }
   }
 
+  /** Retrieve the contents of m_vecData without copying them
+   * NA values are R's NA, which isNA recognizes
+   * @return view of m_vecData, valid while this REXPString is unchanged
+   */
+  RDataView<RSTRINGTYPE> REXPString::getView() const{
+    return RDataView<RSTRINGTYPE>(m_vecData.empty() ? NULL : &m_vecData[0], m_vecData.size());
+  }
+
+  /** Checks whether any of the strings is NA
+   * @return true if m_vecData contains R's NA
+   */
+  bool REXPString::hasNA() const{
+    for(size_t i = 0; i < m_vecData.size(); ++i){
+      if(m_vecData[i] == NA)
+        return true;
+    }
+    return false;
+  }
+
 
 
   /** Compares the provided string to the R interpretation of NA to determine if it is NA
    * @param[in] str string to be compared to determine if it is considered NA
    * @return true if val is NA, false otherwise
    */
-  bool REXPString::isNA(const RSTRINGTYPE &str){
+  bool REXPString::isNA(const RSTRINGTYPE &str) const{
     return str == NA;
   }
 
+  /** Non-const form of isNA, which was the only one before isNA became const. Subclasses that override it keep working
+   * for calls on non-const objects; it forwards to the const isNA
+   * @param[in] str string to be compared to determine if it is considered NA
+   * @return true if str is NA, false otherwise
+   */
+  bool REXPString::isNA(const RSTRINGTYPE &str){
+    return static_cast<const REXPString&>(*this).isNA(str);
+  }
+
   /** Returns R interpretation of NA string
    * @return R interpretation of NA string
    */
@@ -196,6 +259,21 @@ namespace rclient{
     return true;
   }
 
+  /** writes the strings to the network one at a time, then quad-aligns the data
+   * @param[out] writer receives the network data
+   */
+  void REXPString::toNetworkStream(NetworkWriter &writer) const{
+    size_t written = 0;
+    for(size_t i = 0; i < m_vecData.size(); ++i){
+      size_t len = m_vecData[i].size() + 1;
+      writer.write((const unsigned char*) m_vecData[i].c_str(), len);
+      written += len;
+    }
+    // quadalign
+    const unsigned char align[3] = {1, 1, 1};
+    if(written%4) writer.write(align, 4-written%4);
+  }
+
   /** returns number of bytes of data that would be passed over the network by this REXPString's data
    * used by RPacketEntry in the entry header
    * @return number of bytes in m_vecData
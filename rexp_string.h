@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "rexp_vector.h"
+#include "rdata_view.h"
 
 namespace rclient{
 
@@ -37,13 +38,18 @@ namespace rclient{
     explicit REXPString(const RSTRINGTYPE &str, const RSTRINGTYPE &consumerNAValue = NA);
     explicit REXPString(const RVECTORTYPE<RSTRINGTYPE> &strVec, const RSTRINGTYPE &consumerNAValue = NA);
     explicit REXPString(const RVECTORTYPE<RSTRINGTYPE> &strVec, const RSHARED_PTR<const REXPPairList> &attr, const RSTRINGTYPE &consumerNAValue = NA);
+    REXPString(RVECTORTYPE<RSTRINGTYPE> &strVec, const AdoptTag &adopt, const RSTRINGTYPE &consumerNAValue = NA);
+    REXPString(RVECTORTYPE<RSTRINGTYPE> &strVec, const RSHARED_PTR<const REXPPairList> &attr, const AdoptTag &adopt, const RSTRINGTYPE &consumerNAValue = NA);
     void swap(REXPString &exp);
 
     virtual size_t length() const;
     virtual RVECTORTYPE<RSTRINGTYPE> getData(const RSTRINGTYPE &consumerNAValue = NA) const;
     virtual void fillData(RVECTORTYPE<RSTRINGTYPE> &buf, const RSTRINGTYPE &consumerNAValue = NA) const;
+    RDataView<RSTRINGTYPE> getView() const;
+    bool hasNA() const;
 
-    virtual bool isNA(const RSTRINGTYPE &str);
+    virtual bool isNA(const RSTRINGTYPE &str) const;
+    virtual bool isNA(const RSTRINGTYPE &str); // non-const form kept for subclasses that override it
     virtual RSTRINGTYPE getNARepresentation() const;
     
 
@@ -51,11 +57,13 @@ namespace rclient{
     // don't want consumer to have access to these, but they are needed by rpacket_entry
     // possible use of private + friend here
     virtual bool toNetworkData(unsigned char *buf, const size_t &length) const;
+    virtual void toNetworkStream(NetworkWriter &writer) const;
     virtual size_t bytelength() const;
 
   private:
     RVECTORTYPE<RSTRINGTYPE> m_vecData;
     void initData(const RVECTORTYPE<RSTRINGTYPE> &vals, const RSTRINGTYPE &consumerNAValue);
+    void adoptData(RVECTORTYPE<RSTRINGTYPE> &vals, const AdoptTag &adopt, const RSTRINGTYPE &consumerNAValue);
   };
 } // close namespace
 
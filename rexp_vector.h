@@ -22,6 +22,18 @@
 
 namespace rclient{
 
+  /** Selects the constructors of REXP vectors that adopt the caller's vector: its contents are swapped into the REXP
+   * instead of being copied, and the caller's vector is left empty.
+   * Pass Adopt if the values use the consumer's NA representation, which is then translated to R's in place, or
+   * AdoptNAEncoded if they already use R's, so they are taken as they are.
+   */
+  struct AdoptTag{
+    explicit AdoptTag(const bool encoded):naEncoded(encoded){}
+    bool naEncoded; // whether NA values already use R's representation
+  };
+  const AdoptTag Adopt(false);
+  const AdoptTag AdoptNAEncoded(true);
+
   /* abstract class for all vector-type R objects
    */
   class RCLIENT_API REXPVector : public REXP{
@@ -0,0 +1,153 @@
+/*  RFuture: Result of an asynchronous request to the server.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "rfuture.h"
+#include "rexp_null.h"
+
+namespace rclient{
+
+  /** destructor
+   */
+  RCallback::~RCallback(){}
+
+
+  /** constructor for a request that has not completed yet
+   * @param[in] callback notified when the request completes. May be null
+   */
+  RFuture::RFuture(const RSHARED_PTR<RCallback> &callback):m_pCallback(callback), m_bReady(false){}
+
+  /** destructor
+   */
+  RFuture::~RFuture(){}
+
+  /** Checks whether the request has completed, without blocking
+   * @return True if a response or an error is available
+   */
+  bool RFuture::isReady(){
+    ScopedLock lock(m_mutex);
+    return m_bReady;
+  }
+
+  /** Blocks until the request has completed
+   */
+  void RFuture::wait(){
+    ScopedLock lock(m_mutex);
+    while(!m_bReady)
+      m_done.wait(m_mutex);
+  }
+
+  /** Blocks until the request has completed or the timeout expires
+   * @param[in] timeout_ms maximum number of milliseconds to wait, negative values are treated as 0
+   * @return True if the request has completed, False if the timeout expired
+   */
+  bool RFuture::wait(const long timeout_ms){
+    ScopedLock lock(m_mutex);
+    // the deadline is fixed before waiting, so that spurious wakeups do not restart the timeout
+    const struct timespec deadline = Condition::deadline(timeout_ms);
+    while(!m_bReady){
+      if(!m_done.timedWaitUntil(m_mutex, deadline))
+        return m_bReady;
+    }
+    return true;
+  }
+
+  /** Retrieves the server's response, waiting for it if necessary
+   * Throws NetworkError if the connection failed, or runtime_error if the request failed for another reason
+   * @return RPacket response sent back from the server
+   */
+  RSHARED_PTR<const RPacket> RFuture::getResponse(){
+    wait();
+    if(m_pNetworkError)
+      throw *m_pNetworkError;
+    if(!m_pResponse)
+      throw std::runtime_error(m_sError);
+    return m_pResponse;
+  }
+
+  /** Checks the QAP1Header of the response to see if the request was successful, waiting for it if necessary
+   * @return True if the server reported success. False otherwise
+   */
+  bool RFuture::isSuccessful(){
+    return getResponse()->isOk();
+  }
+
+  /** Retrieves the first entry of the response as REXP, waiting for it if necessary
+   * @return REXP contained in the first entry, or REXPNull if there is no REXP
+   */
+  RSHARED_PTR<const REXP> RFuture::getREXP(){
+    RSHARED_PTR<const RPacket> response = getResponse();
+    if(response->getEntries()->empty())
+      return RMAKE_SHARED<REXPNull>();
+    return (*response->getEntries())[0].toREXP(response->getArena());
+  }
+
+  /** Completes the request with the server's response
+   * @param[in] response RPacket response sent back from the server
+   */
+  void RFuture::setResponse(const RSHARED_PTR<const RPacket> &response){
+    {
+      ScopedLock lock(m_mutex);
+      m_pResponse = response;
+    }
+    complete();
+  }
+
+  /** Completes the request with a network failure
+   * @param[in] error exception thrown by the NetworkManager
+   */
+  void RFuture::setError(const NetworkError &error){
+    {
+      ScopedLock lock(m_mutex);
+      m_pNetworkError = RMAKE_SHARED<NetworkError>(error);
+    }
+    complete();
+  }
+
+  /** Completes the request with a failure other than a network error
+   * @param[in] error description of the failure
+   */
+  void RFuture::setError(const std::string &error){
+    {
+      ScopedLock lock(m_mutex);
+      m_sError = error;
+    }
+    complete();
+  }
+
+  /** Wakes threads waiting on the request, then notifies the callback
+   */
+  void RFuture::complete(){
+    {
+      ScopedLock lock(m_mutex);
+      m_bReady = true;
+      m_done.broadcast();
+    }
+    if(!m_pCallback) return;
+
+    try{
+      if(m_pNetworkError)
+        m_pCallback->onError(*m_pNetworkError);
+      else if(!m_pResponse)
+        m_pCallback->onError(std::runtime_error(m_sError));
+      else
+        m_pCallback->onResponse(m_pResponse);
+    }
+    catch(...){
+      // the callback's failure must not take down the thread completing requests
+    }
+  }
+
+} // close namespace
@@ -0,0 +1,80 @@
+/*  RFuture: Result of an asynchronous request to the server.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_RFUTURE_H_INCLUDED
+#define RCLIENT_RFUTURE_H_INCLUDED
+
+#include "config.h"
+#include "rpacket.h"
+#include "network_error.h"
+#include "thread_sync.h"
+
+namespace rclient{
+
+  /** Interface for consumers that want to be notified when an asynchronous request completes.
+   * Exactly one of the functions is called, on the thread that completed the request.
+   * Exceptions thrown by the callback are ignored.
+   */
+  class RCLIENT_API RCallback{
+
+  public:
+    virtual ~RCallback();
+
+    virtual void onResponse(const RSHARED_PTR<const RPacket> &response) = 0;
+    virtual void onError(const std::runtime_error &error) = 0;
+  };
+
+
+  /** Holds the response to an asynchronous request once it arrives.
+   * Getters block until the request has completed. If the request failed, they throw the error.
+   */
+  class RCLIENT_API RFuture{
+
+  public:
+    explicit RFuture(const RSHARED_PTR<RCallback> &callback = RSHARED_PTR<RCallback>());
+    ~RFuture();
+
+    bool isReady();
+    void wait();
+    bool wait(const long timeout_ms);
+
+    RSHARED_PTR<const RPacket> getResponse();
+    bool isSuccessful();
+    RSHARED_PTR<const REXP> getREXP();
+
+    // for the thread completing the request
+    void setResponse(const RSHARED_PTR<const RPacket> &response);
+    void setError(const NetworkError &error);
+    void setError(const std::string &error);
+
+  private:
+    RFuture(const RFuture &no_copy); // non construction-copyable
+    RFuture& operator=(const RFuture&); // non-copyable
+
+    void complete();
+
+    RSHARED_PTR<RCallback> m_pCallback; // notified on completion, may be null
+    Mutex m_mutex;
+    Condition m_done;
+    bool m_bReady;
+    RSHARED_PTR<const RPacket> m_pResponse; // set if the request succeeded
+    RSHARED_PTR<const NetworkError> m_pNetworkError; // set if the request failed with a network error
+    RSTRINGTYPE m_sError; // set if the request failed for another reason
+  };
+
+} // close namespace
+
+#endif
@@ -21,7 +21,7 @@ namespace rclient{
 
   /** constructor builds QAP1 header with provided rserve command and data
    * @param[in] cmd Rserve command. see "rpacket.h" for eCMD enums
-   * @param[in] entries vector of RPacketEntry. RPacket content to be sent
+   * @param[in] entries vector of RPacketEntry. RPacket content to be sent. Streaming entries refer to REXPs that must outlive the packet
    */
   RPacket::RPacket(const eCMD &cmd, const RVECTORTYPE<PacketEntry> &entries):m_vecEntrylist(RMAKE_SHARED<RVECTORTYPE<PacketEntry> >(entries)){
 
@@ -40,10 +40,14 @@ namespace rclient{
 
 
   /** Constructor for NetworkManager to create Rpacket out of server response
+   * Neither the buffer nor the entries are copied.
    * @param[in] header QAP1 protocol RPacket header
-   * @param[in] entries vector of RPacketEntry
+   * @param[in] buffer first byte of the data section of the response
+   * @param[in] entries vector of RPacketEntry viewing buffer
+   * @param[in] arena arena to decode the entries into, may be null
    */
-  RPacket::RPacket(const QAP1Header &header, const RVECTORTYPE<PacketEntry> &entries):m_qap1Header(header), m_vecEntrylist(RMAKE_SHARED<RVECTORTYPE<PacketEntry> >(entries)){}
+  RPacket::RPacket(const QAP1Header &header, const RSHARED_PTR<const unsigned char> &buffer, const RSHARED_PTR<RVECTORTYPE<PacketEntry> > &entries,
+                   const RSHARED_PTR<RArena> &arena):m_qap1Header(header), m_pBuffer(buffer), m_vecEntrylist(entries), m_pArena(arena){}
 
 
   /** Retrieves shared pointer to vector of this packet's entries
@@ -60,6 +64,14 @@ namespace rclient{
     return m_qap1Header;
   }
 
+  /** Retrieves the arena the REXPs of this packet's entries are decoded into: pass it to PacketEntry::toREXP.
+   * The arena is released once the packet and every REXP allocated from it are
+   * @return arena for decoding, null if decoded REXPs are allocated separately
+   */
+  RSHARED_PTR<RArena> RPacket::getArena() const{
+    return m_pArena;
+  }
+
   /** Retrieves Rserve command from this packet's QAP1Header
    * @return enum representing rserve command. see "rpacket.h" for eCMD list
    */
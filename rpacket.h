@@ -116,11 +116,12 @@ namespace rclient{
       ERR_securityClose  = 0x64  // server-initialized close due to security violation
     };
 
-    // constructor for consumer
+    // constructor for consumer. Streaming entries are copied by reference, so their REXPs must outlive the packet
     RPacket(const eCMD &cmd, const RVECTORTYPE<PacketEntry> &entries);
 
     // constructor for network: will not want consumer using this one. make private and friend or something
-    RPacket(const QAP1Header &header, const RVECTORTYPE<PacketEntry> &entries);
+    RPacket(const QAP1Header &header, const RSHARED_PTR<const unsigned char> &buffer, const RSHARED_PTR<RVECTORTYPE<PacketEntry> > &entries,
+            const RSHARED_PTR<RArena> &arena = RSHARED_PTR<RArena>());
 
     uint32_t getCommand() const;
     RSTRINGTYPE getStatus() const;
@@ -128,6 +129,7 @@ namespace rclient{
     // getters
     RSHARED_PTR<const RVECTORTYPE<PacketEntry> > getEntries() const;
     const QAP1Header getHeader() const;
+    RSHARED_PTR<RArena> getArena() const;
 
     // improvement: create enum for triboolean
     bool isOk() const;
@@ -136,7 +138,11 @@ namespace rclient{
   private:
     QAP1Header m_qap1Header;
 
+    // data section received from the server. entries are views into it. null for packets built by the consumer
+    RSHARED_PTR<const unsigned char> m_pBuffer;
     RSHARED_PTR<RVECTORTYPE<PacketEntry> > m_vecEntrylist;
+    // arena to decode the entries into, null to allocate decoded REXPs separately
+    RSHARED_PTR<RArena> m_pArena;
   };
 }
 #endif
@@ -17,6 +17,9 @@
 #include "rpacket_entry_0103.h"
 #include "rexp_class_hierarchy.h"
 #include "endian_converter.h"
+#include "network_writer.h"
+#include "boost_endian.hpp"
+#include "rarena.h"
 
 #include <string.h>
 #include <stdexcept>
@@ -46,16 +49,13 @@ namespace{
   }
 
 
-  /** fills in the header of the entry with the given information
-   * @param[out] entry vector of unsigned char to fill with header
-   * @param[out] isLargeData bool to that is set if large header is used
-   * @param[in] i Iterator for m_aEntry to fill in header
-   * @param[in] type Entry datatype, see rpacket_enty.h for enum of datatypes
-   * @param[in] length Byte length of the entry
+  /** writes an entry header with the given information
+   * @param[out] header at least 8 bytes to fill with the header
+   * @param[in] header_type Entry datatype, see rpacket_enty.h for enum of datatypes
+   * @param[in] header_length Byte length of the entry data
    * @return size of header
    */
-  size_t makeEntryHeader(RVECTORTYPE<unsigned char> &entry, bool &isLargeData, const size_t i, const uint32_t header_type, const uint64_t header_length){
-
+  size_t writeEntryHeader(unsigned char *header, const uint32_t header_type, const uint64_t header_length){
     RVECTORTYPE<uint8_t> type, length;
     type.resize(sizeof(uint32_t));
     length.resize(sizeof(uint64_t));
@@ -64,35 +64,42 @@ namespace{
 
     // if length exceeds 3 bytes, then need 8 byte large data header
     if(header_length > 0x7fffff){
-      // resize entry to maximum header + rexp header + content
-      entry.resize(header_length+8);
-      isLargeData = true;
       // fill type and set flag for large data
-      entry[i] = type[0] | rclient::RPacketEntry_0103::DT_LARGE;
+      header[0] = type[0] | rclient::RPacketEntry_0103::DT_LARGE;
       // fill in length
-      memcpy(&entry[i+1], &length[0], 7);
-      return i+8;
+      memcpy(&header[1], &length[0], 7);
+      return 8;
     }
     // otherwise normal 4 byte header
-    else{
-      entry.resize(header_length+4);
-      isLargeData = false;
-      // fill in type
-      entry[i] = type[0];
-      // fill in length
-      memcpy(&entry[i+1], &length[0], 3);
-      return i+4;
-    }
+    header[0] = type[0];
+    // fill in length
+    memcpy(&header[1], &length[0], 3);
+    return 4;
   }
 
+  /** fills in the header of the entry with the given information
+   * @param[out] entry vector of unsigned char to fill with header
+   * @param[out] isLargeData bool to that is set if large header is used
+   * @param[in] i Iterator for entry to fill in header
+   * @param[in] type Entry datatype, see rpacket_enty.h for enum of datatypes
+   * @param[in] length Byte length of the entry
+   * @return size of header
+   */
+  size_t makeEntryHeader(RVECTORTYPE<unsigned char> &entry, bool &isLargeData, const size_t i, const uint32_t header_type, const uint64_t header_length){
+    isLargeData = header_length > 0x7fffff;
+    // resize entry to header + rexp header + content
+    entry.resize(header_length + (isLargeData ? 8:4));
+    return i + writeEntryHeader(&entry[i], header_type, header_length);
+  }
 
-  /** Creates REXP header at location i of entry with given type and length
-   * @param[out] entry vector of unsigned char to fill with REXP header
-   * @param[in] i iterator for entry to fill in header
+
+  /** writes a REXP header with the given type and length
+   * @param[out] header at least 8 bytes to fill with the REXP header
    * @param[in] rexp_type type of REXP, see rexp.h for enum eType
    * @param[in] rexp_length length of the REXP data
+   * @return size of header
    */
-  size_t makeREXPHeader(RVECTORTYPE<unsigned char> &entry, const size_t i, const uint32_t rexp_type, const uint64_t rexp_length){
+  size_t writeREXPHeader(unsigned char *header, const uint32_t rexp_type, const uint64_t rexp_length){
 
     RVECTORTYPE<uint8_t> type, length;
     type.resize(sizeof(uint32_t));
@@ -100,36 +107,55 @@ namespace{
     serialize<uint32_t>(type, rexp_type);
     serialize<uint64_t>(length, rexp_length);
 
-    entry[i] = type[0];
+    header[0] = type[0];
 
     // remove attr flag if IncludeAttributes is not set
     if(!rclient::IncludeAttributes)
-      entry[i] = entry[i] & ~rclient::REXP::XT_HAS_ATTR;
+      header[0] = header[0] & ~rclient::REXP::XT_HAS_ATTR;
 
     if(rexp_type & rclient::REXP::XT_LARGE){
       // 8 byte header
-      memcpy(&entry[i+1], &length[0], 7);
-      return i+8;
+      memcpy(&header[1], &length[0], 7);
+      return 8;
     }
     else{
       // 4 byte header
-      memcpy(&entry[i+1], &length[0], 3);
-      return i+4;
+      memcpy(&header[1], &length[0], 3);
+      return 4;
     }
   }
 
-
-  /** Creates REXP (including header) at location i of entry.
+  /** Creates REXP header at location i of entry with given type and length
    * @param[out] entry vector of unsigned char to fill with REXP header
    * @param[in] i iterator for entry to fill in header
    * @param[in] rexp_type type of REXP, see rexp.h for enum eType
    * @param[in] rexp_length length of the REXP data
    */
-  size_t fillREXP(RVECTORTYPE<unsigned char> &entry, const rclient::REXP &exp, size_t i){
+  size_t makeREXPHeader(RVECTORTYPE<unsigned char> &entry, const size_t i, const uint32_t rexp_type, const uint64_t rexp_length){
+    return i + writeREXPHeader(&entry[i], rexp_type, rexp_length);
+  }
+
+  /** Calculates the length of a REXP's data, including its attributes if they are sent
+   * @param[in] exp REXP to measure
+   * @return number of bytes following the REXP header
+   */
+  size_t rexpDataLength(const rclient::REXP &exp){
     size_t bytelength = exp.bytelength();
     if(rclient::IncludeAttributes && exp.hasAttributes()){
       bytelength += exp.getAttributes()->bytelength() + (exp.getAttributes()->getType() & rclient::REXP::XT_LARGE ? 8:4);
     }
+    return bytelength;
+  }
+
+
+  /** Creates REXP (including header) at location i of entry.
+   * @param[out] entry vector of unsigned char to fill with REXP header
+   * @param[in] i iterator for entry to fill in header
+   * @param[in] rexp_type type of REXP, see rexp.h for enum eType
+   * @param[in] rexp_length length of the REXP data
+   */
+  size_t fillREXP(RVECTORTYPE<unsigned char> &entry, const rclient::REXP &exp, size_t i){
+    size_t bytelength = rexpDataLength(exp);
     // fill in REXP Header
     i = makeREXPHeader(entry, i, exp.getType(), bytelength);
 
@@ -180,12 +206,134 @@ namespace{
     return i;
   }
 
+  /** Writes REXP (including header) to writer, serializing large data a chunk at a time.
+   * Produces the same bytes as fillREXP.
+   * @param[out] writer receives the network data
+   * @param[in] exp REXP to write
+   */
+  void streamREXP(rclient::NetworkWriter &writer, const rclient::REXP &exp){
+    unsigned char header[8];
+    writer.write(header, writeREXPHeader(header, exp.getType(), rexpDataLength(exp)));
+
+    // write attributes if there are any
+    if(rclient::IncludeAttributes && exp.hasAttributes()){
+      streamREXP(writer, *exp.getAttributes());
+    }
+
+    // special condition for REXPPairList, write each pair individually
+    if(exp.getBaseType() == rclient::REXP::XT_LIST_TAG || exp.getBaseType() == rclient::REXP::XT_LANG_TAG){
+      const rclient::REXPPairList::RPairVector &data = dynamic_cast<const rclient::REXPPairList &>(exp).getData();
+
+      for(size_t j = 0; j < data.size(); ++j){
+        // write val (REXP)
+        streamREXP(writer, *data[j].first);
+
+        // write tag (string), zero padded
+        size_t str_len = data[j].second.size()+1;
+        size_t aligned_len = str_len + (str_len%4 ? (4-str_len%4) : 0);
+        uint32_t str_type = rclient::REXP::XT_SYMNAME | (aligned_len > 0x7fffff ? rclient::REXP::XT_LARGE : 0);
+        writer.write(header, writeREXPHeader(header, str_type, aligned_len));
+        writer.write((const unsigned char*) data[j].second.c_str(), str_len);
+        const unsigned char align[3] = {0, 0, 0};
+        writer.write(align, aligned_len - str_len);
+      }
+    }
+
+    // special condition for REXPList, write each REXP individually
+    else if(exp.getBaseType() == rclient::REXP::XT_LIST_NOTAG || exp.getBaseType() == rclient::REXP::XT_LANG_NOTAG){
+      const rclient::REXPList::RVector &data = dynamic_cast<const rclient::REXPList &>(exp).getData();
+      for(size_t j = 0; j < data.size(); ++j){
+        streamREXP(writer, *data[j]);
+      }
+    }
+    // write data for standard REXP types
+    else{
+      exp.toNetworkStream(writer);
+    }
+  }
+
+  /** reverses the bytes of a 4 byte value
+   * @param[in] x value to swap
+   * @return x in the opposite byte order
+   */
+  inline uint32_t byteSwap(const uint32_t x){
+#if defined(__GNUC__)
+    return __builtin_bswap32(x);
+#else
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+#endif
+  }
+
+  /** reverses the bytes of an 8 byte value
+   * @param[in] x value to swap
+   * @return x in the opposite byte order
+   */
+  inline uint64_t byteSwap(const uint64_t x){
+#if defined(__GNUC__)
+    return __builtin_bswap64(x);
+#else
+    return ((uint64_t) byteSwap((uint32_t) x) << 32) | byteSwap((uint32_t) (x >> 32));
+#endif
+  }
+
+  /** Copies an array of little-endian values out of network data in one pass
+   * On little-endian hosts this is a single memcpy. On big-endian hosts each value is byte swapped, in a loop the
+   * compiler can vectorize.
+   * @param[out] dest presized array receiving count native values
+   * @param[in] src little-endian data, need not be aligned
+   * @param[in] count number of values to copy
+   */
+  template<typename T, typename UIntType>
+  void copyLittleEndian(T *dest, const unsigned char *src, const size_t count){
+    memcpy(dest, src, count * sizeof(T));
+#if defined(BOOST_BIG_ENDIAN)
+    UIntType *values = reinterpret_cast<UIntType*>(dest);
+    for(size_t i = 0; i < count; ++i)
+      values[i] = byteSwap(values[i]);
+#endif
+  }
+
+
+  /** Creates a REXP from arena if there is one, otherwise with RMAKE_SHARED
+   * @param[in] arena arena to allocate the REXP and its reference count from, may be null
+   * @return new REXP
+   */
+  template<typename T>
+  RSHARED_PTR<T> makeREXP(const RSHARED_PTR<rclient::RArena> &arena){
+    if(arena)
+      return RALLOCATE_SHARED<T>(rclient::RArenaAllocator<T>(arena));
+    return RMAKE_SHARED<T>();
+  }
+
+  template<typename T, typename A1>
+  RSHARED_PTR<T> makeREXP(const RSHARED_PTR<rclient::RArena> &arena, const A1 &a1){
+    if(arena)
+      return RALLOCATE_SHARED<T>(rclient::RArenaAllocator<T>(arena), a1);
+    return RMAKE_SHARED<T>(a1);
+  }
+
+  template<typename T, typename A1, typename A2>
+  RSHARED_PTR<T> makeREXP(const RSHARED_PTR<rclient::RArena> &arena, const A1 &a1, const A2 &a2){
+    if(arena)
+      return RALLOCATE_SHARED<T>(rclient::RArenaAllocator<T>(arena), a1, a2);
+    return RMAKE_SHARED<T>(a1, a2);
+  }
+
+  template<typename T, typename A1, typename A2, typename A3>
+  RSHARED_PTR<T> makeREXP(const RSHARED_PTR<rclient::RArena> &arena, const A1 &a1, const A2 &a2, const A3 &a3){
+    if(arena)
+      return RALLOCATE_SHARED<T>(rclient::RArenaAllocator<T>(arena), a1, a2, a3);
+    return RMAKE_SHARED<T>(a1, a2, a3);
+  }
+
+
   /** Parses data from entry into a REXP
-   * @param[in] entry vector of unsigned char containing a REXP at the given offset
+   * @param[in] entry array of unsigned char containing a REXP at the given offset
    * @param[in] offset position in entry to parse REXP
+   * @param[in] arena arena to allocate the REXPs from, null to allocate each separately
    * @return shared pointer to a REXP created from parsing entry
    */
-  RSHARED_PTR<const rclient::REXP> parseREXP(const RVECTORTYPE<unsigned char> &entry, const size_t rexp_pos){
+  RSHARED_PTR<const rclient::REXP> parseREXP(const unsigned char *entry, const size_t rexp_pos, const RSHARED_PTR<rclient::RArena> &arena){
 
     // determine type of REXP
     uint32_t rexp_type = entry[rexp_pos];
@@ -233,7 +381,7 @@ namespace{
       if(rclient::IncludeAttributes){
         // parse the attribute
 
-        attribute = RPTR_CAST<const rclient::REXPPairList>(parseREXP(entry,attr_pos));
+        attribute = RPTR_CAST<const rclient::REXPPairList>(parseREXP(entry, attr_pos, arena));
 
         if(attribute == 0)
           // failed to parse attribute.
@@ -255,34 +403,30 @@ namespace{
     case rclient::REXP::XT_INT:
     case rclient::REXP::XT_ARRAY_INT:
       {
-	RVECTORTYPE<int32_t> data;
-	RVECTORTYPE<uint8_t> data_point;
-	data_point.resize(sizeof(uint32_t));
-	for(uint64_t i=0; i<rexp_length; i+=sizeof(int32_t)){
-	  memcpy(&data_point[0], &entry[i + offset], sizeof(uint32_t));
-	  uint32_t val = deserialize<uint32_t>(data_point);
-	  data.push_back(val);
-	}
+	// copy the whole array at once into a vector sized from the REXP length
+	RVECTORTYPE<int32_t> data(rexp_length / sizeof(int32_t));
+	if(!data.empty())
+	  copyLittleEndian<int32_t, uint32_t>(&data[0], &entry[offset], data.size());
+	// the REXP adopts the data, which already uses R's NA
         if(hasAttr)
-          return RMAKE_SHARED<rclient::REXPInteger>(data, attribute);
+          return makeREXP<rclient::REXPInteger>(arena, RREF(data), attribute, rclient::AdoptNAEncoded);
         else
-          return RMAKE_SHARED<rclient::REXPInteger>(data);
+          return makeREXP<rclient::REXPInteger>(arena, RREF(data), rclient::AdoptNAEncoded);
       }
 
     case rclient::REXP::XT_DOUBLE:
     case rclient::REXP::XT_ARRAY_DOUBLE:
       // create vector
       {
-	rclient::EndianConverter converter;
-	RVECTORTYPE<double> data;
-	for(uint64_t i=0; i<rexp_length; i+=sizeof(double)){
-	  double val = converter.swap_endian(*(double*) &entry[i+offset]);
-	  data.push_back(val);
-	}
+	// copy the whole array at once into a vector sized from the REXP length
+	RVECTORTYPE<double> data(rexp_length / sizeof(double));
+	if(!data.empty())
+	  copyLittleEndian<double, uint64_t>(&data[0], &entry[offset], data.size());
+	// the REXP adopts the data, which already uses R's NA
         if(hasAttr)
-          return RMAKE_SHARED<rclient::REXPDouble>(data, attribute);
+          return makeREXP<rclient::REXPDouble>(arena, RREF(data), attribute, rclient::AdoptNAEncoded);
         else
-          return RMAKE_SHARED<rclient::REXPDouble>(data);
+          return makeREXP<rclient::REXPDouble>(arena, RREF(data), rclient::AdoptNAEncoded);
       }
     case rclient::REXP::XT_STR:
     case rclient::REXP::XT_ARRAY_STR:
@@ -293,7 +437,7 @@ namespace{
 
 	if(entry[rexp_length+offset-1] > 0x1){
 	  // end of REXP is not NUL or SOH, cannot safely interpret as string
-	  return RMAKE_SHARED<rclient::REXPNull>();
+	  return makeREXP<rclient::REXPNull>(arena);
 	}
 
 	while(i < rexp_length){
@@ -309,10 +453,11 @@ namespace{
 	    data.push_back(str);
 	  }
 	}
+	// the REXP adopts the data, which already uses R's NA
         if(hasAttr)
-          return RMAKE_SHARED<rclient::REXPString>(data, attribute);
+          return makeREXP<rclient::REXPString>(arena, RREF(data), attribute, rclient::AdoptNAEncoded);
         else
-          return RMAKE_SHARED<rclient::REXPString>(data);
+          return makeREXP<rclient::REXPString>(arena, RREF(data), rclient::AdoptNAEncoded);
       }
 
     case rclient::REXP::XT_LIST_TAG:
@@ -326,12 +471,12 @@ namespace{
         size_t i = 0;
         while(i < rexp_length){
           // parse rexp
-          RSHARED_PTR<const rclient::REXP> exp = parseREXP(entry, i + offset);
+          RSHARED_PTR<const rclient::REXP> exp = parseREXP(entry, i + offset, arena);
           i += exp->bytelength() + (exp->getType() & rclient::REXP::XT_LARGE ? 8:4);
           
           // invalid PairList if not second member is not a string
           if(entry[i+offset] != rclient::REXP::XT_SYMNAME)
-            return RMAKE_SHARED<rclient::REXPNull>();
+            return makeREXP<rclient::REXPNull>(arena);
 
           // parse string header
           uint32_t sizeof_str_header = (entry[i+offset] & rclient::REXP::XT_LARGE ? 8 : 4);
@@ -346,7 +491,7 @@ namespace{
           // return REXPNull if string is not guaranteed to terminate
           if(entry[i+offset+str_len-1] > 0x1)
             // end of rexp is not NUL or SOH: invalid string. Cannot safely interpret as REXPPairList
-            return RMAKE_SHARED<rclient::REXPNull>();
+            return makeREXP<rclient::REXPNull>(arena);
           
           // create string
           RSTRINGTYPE name((char*) &entry[i+offset]);
@@ -357,9 +502,9 @@ namespace{
           data.push_back(rpair);
           }
         if(hasAttr)
-          return RMAKE_SHARED<rclient::REXPPairList>(data, attribute);
+          return makeREXP<rclient::REXPPairList>(arena, data, attribute);
         else
-          return RMAKE_SHARED<rclient::REXPPairList>(data);
+          return makeREXP<rclient::REXPPairList>(arena, data);
       }
 
     case rclient::REXP::XT_LIST_NOTAG:
@@ -368,21 +513,21 @@ namespace{
         rclient::REXPList::RVector data;
         size_t i = 0;
         while(i < rexp_length){
-          RSHARED_PTR<const rclient::REXP> exp = parseREXP(entry, i + offset);
+          RSHARED_PTR<const rclient::REXP> exp = parseREXP(entry, i + offset, arena);
           data.push_back(exp);
           i += exp->bytelength() + (exp->getType() & rclient::REXP::XT_LARGE ? 8:4);
         }
         if(hasAttr)
-          return RMAKE_SHARED<rclient::REXPList>(data, attribute);
+          return makeREXP<rclient::REXPList>(arena, data, attribute);
         else
-          return RMAKE_SHARED<rclient::REXPList>(data);
+          return makeREXP<rclient::REXPList>(arena, data);
       }
 
     default:
       if(hasAttr)
-        return RMAKE_SHARED<rclient::REXPNull>(attribute);
+        return makeREXP<rclient::REXPNull>(arena, attribute);
       else
-        return RMAKE_SHARED<rclient::REXPNull>();
+        return makeREXP<rclient::REXPNull>(arena);
       
     }
   }
@@ -394,66 +539,124 @@ namespace rclient{
 
   /** empty constructor
    */
-  RPacketEntry_0103::RPacketEntry_0103():m_isLargeData(false){}
+  RPacketEntry_0103::RPacketEntry_0103():m_iOffset(0),m_iLength(0),m_isLargeData(false),m_pStreamed(NULL){}
 
   /** constructor of entry for REXP.
    * eDataType is DT_SEXP
    * @param[in] exp REXP to convert into an RPacket data entry
    */
-  RPacketEntry_0103::RPacketEntry_0103(const REXP &exp){
-    size_t bytelength = exp.bytelength() + (exp.getType() & REXP::XT_LARGE ? 8:4);
-    if(IncludeAttributes && exp.hasAttributes()){
-      bytelength += exp.getAttributes()->bytelength() + (exp.getAttributes()->getType() & REXP::XT_LARGE ? 8:4);
-    }
+  RPacketEntry_0103::RPacketEntry_0103(const REXP &exp):m_iOffset(0),m_pStreamed(NULL){
+    size_t bytelength = rexpDataLength(exp) + (exp.getType() & REXP::XT_LARGE ? 8:4);
+    RSHARED_PTR<RVECTORTYPE<unsigned char> > entry = RMAKE_SHARED<RVECTORTYPE<unsigned char> >();
     // fill in entry header
-    size_t i = makeEntryHeader(m_aEntry, m_isLargeData, 0, DT_SEXP, bytelength);
+    size_t i = makeEntryHeader(*entry, m_isLargeData, 0, DT_SEXP, bytelength);
     // fill in rexp
-    i = fillREXP(m_aEntry, exp, i);
+    i = fillREXP(*entry, exp, i);
+
+    m_pBuffer = RSHARED_PTR<const unsigned char>(entry, &(*entry)[0]);
+    m_iLength = entry->size();
   }
 
   /** constructor of entry for string
    * eDataType is DT_STRING
    * @param[in] str string to convert into RPacket entry
    */
-  RPacketEntry_0103::RPacketEntry_0103(const RSTRINGTYPE &str){
+  RPacketEntry_0103::RPacketEntry_0103(const RSTRINGTYPE &str):m_iOffset(0),m_pStreamed(NULL){
     size_t len = str.size() + 1;
     size_t align = (len%4 ? 4-len%4 : 0);
+    RSHARED_PTR<RVECTORTYPE<unsigned char> > entry = RMAKE_SHARED<RVECTORTYPE<unsigned char> >();
     // create header and retrieve iterator
-    int i = makeEntryHeader(m_aEntry, m_isLargeData, 0, DT_STRING, len+align);
+    int i = makeEntryHeader(*entry, m_isLargeData, 0, DT_STRING, len+align);
     // fill rest of data
-    memcpy(&m_aEntry[i], str.c_str(), len);
+    memcpy(&(*entry)[i], str.c_str(), len);
     i+=len;
     // make sure entry is quadaligned
-    memset(&m_aEntry[i], 0x1, m_aEntry.size()-i);
+    memset(&(*entry)[i], 0x1, entry->size()-i);
+
+    m_pBuffer = RSHARED_PTR<const unsigned char>(entry, &(*entry)[0]);
+    m_iLength = entry->size();
   }
 
 
   /** constructor for what would effectively be a cast. Copies contents of vector into own entry field.
-   * Should only be used by network manager for receiving packets
    * @param data vector of unsigned chars holding contents of a valid RPacketEntry as defined by RServe
    */
-  RPacketEntry_0103::RPacketEntry_0103(const RVECTORTYPE<unsigned char> &data):m_aEntry(data),m_isLargeData(data[0] & DT_LARGE){}
+  RPacketEntry_0103::RPacketEntry_0103(const RVECTORTYPE<unsigned char> &data):m_iOffset(0),m_iLength(data.size()),m_isLargeData(data[0] & DT_LARGE),m_pStreamed(NULL){
+    RSHARED_PTR<const RVECTORTYPE<unsigned char> > copy = RMAKE_SHARED<const RVECTORTYPE<unsigned char> >(data);
+    m_pBuffer = RSHARED_PTR<const unsigned char>(copy, &(*copy)[0]);
+  }
+
+
+  /** constructor of an entry that views part of a buffer holding a server response. The data is not copied.
+   * Should only be used by network manager for receiving packets
+   * @param buffer first byte of the buffer containing the entry. Shared with the RPacket and its other entries
+   * @param offset position of the first byte of a valid RPacketEntry as defined by RServe
+   * @param length number of bytes in the entry, including header
+   */
+  RPacketEntry_0103::RPacketEntry_0103(const RSHARED_PTR<const unsigned char> &buffer, const size_t offset, const size_t length):m_pBuffer(buffer),m_iOffset(offset),m_iLength(length),m_isLargeData(buffer.get()[offset] & DT_LARGE),m_pStreamed(NULL){}
+
+
+  /** creates an entry for a REXP that is serialized a chunk at a time while it is sent, instead of up front.
+   * Only the length of the entry is calculated here, so memory use does not grow with the size of the REXP.
+   * eDataType is DT_SEXP
+   * @param[in] exp REXP to send. Not copied, so it must not change or be destroyed while the entry, any copy of it,
+   *                or an RPacket holding it is in use. Only pass entries to requests sent synchronously, as RClient::assign does
+   * @return entry referring to exp
+   */
+  RPacketEntry_0103 RPacketEntry_0103::streaming(const REXP &exp){
+    RPacketEntry_0103 entry;
+    uint64_t bytelength = rexpDataLength(exp) + (exp.getType() & REXP::XT_LARGE ? 8:4);
+    entry.m_isLargeData = bytelength > 0x7fffff;
+    entry.m_iLength = bytelength + (entry.m_isLargeData ? 8:4);
+    entry.m_pStreamed = &exp;
+    return entry;
+  }
+
+
+  /** Writes the entry, including headers, to be sent over the network. Streaming entries are serialized as they are written.
+   * @param[out] writer receives the entry
+   */
+  void RPacketEntry_0103::writeTo(NetworkWriter &writer) const{
+    if(!m_pStreamed){
+      if(m_iLength > 0)
+        writer.write(getEntry(), m_iLength);
+      return;
+    }
+    unsigned char header[8];
+    writer.write(header, writeEntryHeader(header, DT_SEXP, m_iLength - getHeaderLength()));
+    streamREXP(writer, *m_pStreamed);
+  }
+
+  /** @return True if the entry is serialized while it is sent, so getEntry cannot be used
+   */
+  bool RPacketEntry_0103::isStreaming() const{
+    return m_pStreamed != NULL;
+  }
 
 
   /** Retrieves entry data prepared to be sent over the network
-   * @return vector of unsigned chars containing headers and contents of the data entry
+   * @return pointer to the headers and contents of the data entry, or NULL if the entry is empty or streaming
    */
-  const RVECTORTYPE<unsigned char> & RPacketEntry_0103::getEntry() const{
-    return m_aEntry;
+  const unsigned char * RPacketEntry_0103::getEntry() const{
+    if(!m_pBuffer || m_iLength == 0)
+      return NULL;
+    return m_pBuffer.get() + m_iOffset;
   }
 
   /** retrieves number of bytes in the entry, including headers
    * @return number of bytes in the RPacketEntry data, including headers
    */
-  uint32_t RPacketEntry_0103::getLength() const{
-    return m_aEntry.size();
+  size_t RPacketEntry_0103::getLength() const{
+    return m_iLength;
   }
 
   /** retrieves eDataType value of the entry, see RPacketEntry class for corresponding enums
    * @return eDataType enum corresponding to entry data type
    */
   uint32_t RPacketEntry_0103::getDataType() const{
-    return m_aEntry[0];
+    if(m_pStreamed)
+      return DT_SEXP | (m_isLargeData ? DT_LARGE : 0);
+    return getEntry()[0];
   }
 
   /** Retrieves size of the entry header.
@@ -468,19 +671,37 @@ namespace rclient{
    * @return pointer to REXP contained in this packet OR REXPNull if packet is not an REXP
    */
   RSHARED_PTR<const REXP> RPacketEntry_0103::toREXP() const{
+    return toREXP(RSHARED_PTR<RArena>());
+  }
+
+  /** converts entry contents into the appropriate REXP, allocating every REXP of the result from an arena
+   * @param[in] arena arena to allocate the REXPs from, null to allocate each separately
+   * @return pointer to REXP contained in this packet OR REXPNull if packet is not an REXP
+   */
+  RSHARED_PTR<const REXP> RPacketEntry_0103::toREXP(const RSHARED_PTR<RArena> &arena) const{
+    if(m_pStreamed){
+      // serialize the entry to parse a copy of the REXP
+      RVECTORTYPE<unsigned char> buffer;
+      rclient::BufferWriter writer(buffer);
+      writeTo(writer);
+      writer.flush();
+      return RPacketEntry_0103(buffer).toREXP(arena);
+    }
+
     // too small to be a rexp
-    if (m_aEntry.size() < 8)
+    if (m_iLength < 8)
       return RMAKE_SHARED<REXPNull>();
 
     // first, confirm that this entry is a REXP
-    uint32_t entry_type = m_aEntry[0];
+    const unsigned char *entry = getEntry();
+    uint32_t entry_type = entry[0];
     
     if((entry_type & DT_TYPE_MASK) != DT_SEXP){
       // entry is not a REXP
       return RMAKE_SHARED<REXPNull>();
     }
 
-    return parseREXP(m_aEntry, (m_isLargeData ? 8:4));
+    return parseREXP(entry, (m_isLargeData ? 8:4), arena);
   }
 
 } // close namespace
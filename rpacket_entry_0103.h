@@ -23,12 +23,19 @@
 
 namespace rclient{
 
+  class NetworkWriter;
+  class RArena;
+
   /** An entry in the data section of an RPacket
    * Contains a 4 byte header:
    *  - 1 byte:  parameter type
    *  - 3 bytes: length of entry
    * Except if the 7th bit is set in the Type:
    * In which case, length of entry becomes 7 bytes and the total header is 8 bytes.
+   * The entry is a view into a reference-counted buffer, which may be shared with the other entries of a received RPacket.
+   * A streaming entry has no buffer; it refers to a REXP and serializes it with writeTo when the entry is sent.
+   * It holds a plain pointer to the REXP, so it must only be used while the caller keeps the REXP alive and unchanged,
+   * i.e. for a request that is sent before the call that built it returns. Requests queued to be sent later must copy their REXPs.
    */
   class RCLIENT_API RPacketEntry_0103{
 
@@ -52,20 +59,30 @@ namespace rclient{
     RPacketEntry_0103();
     explicit RPacketEntry_0103(const REXP &expr);
     explicit RPacketEntry_0103(const RSTRINGTYPE &str);
-    explicit RPacketEntry_0103(const RVECTORTYPE<unsigned char> &data); //copy data, used by NetworkManager
+    explicit RPacketEntry_0103(const RVECTORTYPE<unsigned char> &data); //copy data
+    RPacketEntry_0103(const RSHARED_PTR<const unsigned char> &buffer, const size_t offset, const size_t length); // view data, used by NetworkManager
+    static RPacketEntry_0103 streaming(const REXP &expr); // refer to expr, serialized while sending. expr must outlive the entry and every copy of it
 
     // getters
-    const RVECTORTYPE<unsigned char> & getEntry() const;
-    uint32_t getLength() const;
+    const unsigned char * getEntry() const;
+    size_t getLength() const;
     uint32_t getDataType() const;
     uint32_t getHeaderLength() const;
+    bool isStreaming() const;
+
+    // write headers and contents for sending
+    void writeTo(NetworkWriter &writer) const;
 
     // Treat contents as REXP...
     RSHARED_PTR<const REXP> toREXP() const;
+    RSHARED_PTR<const REXP> toREXP(const RSHARED_PTR<RArena> &arena) const;
 
   private:
-    RVECTORTYPE<unsigned char> m_aEntry;
+    RSHARED_PTR<const unsigned char> m_pBuffer; // first byte of the buffer holding this entry
+    size_t m_iOffset; // position of the entry header within m_pBuffer
+    size_t m_iLength; // number of bytes in the entry, including header
     bool m_isLargeData;
+    const REXP *m_pStreamed; // REXP to serialize while sending, NULL unless the entry is streaming
   };
 
 } // close namespace
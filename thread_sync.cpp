@@ -0,0 +1,128 @@
+/*  Thread Sync: Mutex and condition variable wrappers around pthreads
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "thread_sync.h"
+
+#include <sys/time.h> // for gettimeofday
+
+namespace rclient{
+
+  /** constructor initializes a default (non-recursive) mutex
+   */
+  Mutex::Mutex(){
+    pthread_mutex_init(&m_mutex, NULL);
+  }
+
+  /** destructor. The mutex must not be locked
+   */
+  Mutex::~Mutex(){
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  /** blocks until the mutex is acquired
+   */
+  void Mutex::lock(){
+    pthread_mutex_lock(&m_mutex);
+  }
+
+  /** releases the mutex
+   */
+  void Mutex::unlock(){
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+
+  /** constructor locks the provided mutex
+   * @param[in] mutex Mutex to hold until the ScopedLock is destroyed
+   */
+  ScopedLock::ScopedLock(Mutex &mutex):m_mutex(mutex){
+    m_mutex.lock();
+  }
+
+  /** destructor unlocks the mutex
+   */
+  ScopedLock::~ScopedLock(){
+    m_mutex.unlock();
+  }
+
+
+  /** constructor
+   */
+  Condition::Condition(){
+    pthread_cond_init(&m_cond, NULL);
+  }
+
+  /** destructor. No thread may be waiting on the condition
+   */
+  Condition::~Condition(){
+    pthread_cond_destroy(&m_cond);
+  }
+
+  /** releases mutex and blocks until signalled. mutex is locked again before returning
+   * @param[in] mutex Mutex locked by the calling thread
+   */
+  void Condition::wait(Mutex &mutex){
+    pthread_cond_wait(&m_cond, &mutex.m_mutex);
+  }
+
+  /** Computes the deadline for timedWaitUntil that lies timeout_ms milliseconds from now. Loops that may wake up several
+   * times before their condition holds compute it once, so that the total wait stays within the timeout
+   * @param[in] timeout_ms number of milliseconds from now, negative values are treated as 0
+   * @return absolute time on the clock used by the condition, with tv_nsec in [0, 1e9)
+   */
+  struct timespec Condition::deadline(const long timeout_ms){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    const long timeout = (timeout_ms < 0 ? 0 : timeout_ms);
+    struct timespec deadline;
+    long nsec = now.tv_usec * 1000L + (timeout % 1000) * 1000000L;
+    deadline.tv_sec = now.tv_sec + timeout / 1000 + nsec / 1000000000L;
+    deadline.tv_nsec = nsec % 1000000000L;
+    return deadline;
+  }
+
+  /** releases mutex and blocks until signalled or until the timeout expires. mutex is locked again before returning
+   * @param[in] mutex Mutex locked by the calling thread
+   * @param[in] timeout_ms maximum number of milliseconds to wait, negative values are treated as 0
+   * @return False if the timeout expired or the wait failed, True otherwise
+   */
+  bool Condition::timedWait(Mutex &mutex, const long timeout_ms){
+    return timedWaitUntil(mutex, deadline(timeout_ms));
+  }
+
+  /** releases mutex and blocks until signalled or until the deadline passes. mutex is locked again before returning
+   * @param[in] mutex Mutex locked by the calling thread
+   * @param[in] deadline absolute time to stop waiting at, see Condition::deadline
+   * @return True if woken up, which may be spurious. False if the deadline passed or the wait failed
+   */
+  bool Condition::timedWaitUntil(Mutex &mutex, const struct timespec &deadline){
+    return pthread_cond_timedwait(&m_cond, &mutex.m_mutex, &deadline) == 0;
+  }
+
+  /** wakes one waiting thread
+   */
+  void Condition::signal(){
+    pthread_cond_signal(&m_cond);
+  }
+
+  /** wakes all waiting threads
+   */
+  void Condition::broadcast(){
+    pthread_cond_broadcast(&m_cond);
+  }
+
+} // close namespace
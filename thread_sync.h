@@ -0,0 +1,86 @@
+/*  Thread Sync: Mutex and condition variable wrappers around pthreads
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_THREAD_SYNC_H_INCLUDED
+#define RCLIENT_THREAD_SYNC_H_INCLUDED
+
+#include "config.h"
+#include <pthread.h>
+
+namespace rclient{
+
+  /** Non-recursive mutex
+   */
+  class RCLIENT_API Mutex{
+
+  public:
+    Mutex();
+    ~Mutex();
+
+    void lock();
+    void unlock();
+
+  private:
+    Mutex(const Mutex &no_copy); // non construction-copyable
+    Mutex& operator=(const Mutex&); // non-copyable
+
+    friend class Condition;
+    pthread_mutex_t m_mutex;
+  };
+
+
+  /** Locks a Mutex for the lifetime of the ScopedLock
+   */
+  class RCLIENT_API ScopedLock{
+
+  public:
+    explicit ScopedLock(Mutex &mutex);
+    ~ScopedLock();
+
+  private:
+    ScopedLock(const ScopedLock &no_copy); // non construction-copyable
+    ScopedLock& operator=(const ScopedLock&); // non-copyable
+
+    Mutex &m_mutex;
+  };
+
+
+  /** Condition variable used together with a locked Mutex
+   */
+  class RCLIENT_API Condition{
+
+  public:
+    Condition();
+    ~Condition();
+
+    static struct timespec deadline(const long timeout_ms);
+
+    void wait(Mutex &mutex);
+    bool timedWait(Mutex &mutex, const long timeout_ms);
+    bool timedWaitUntil(Mutex &mutex, const struct timespec &deadline);
+    void signal();
+    void broadcast();
+
+  private:
+    Condition(const Condition &no_copy); // non construction-copyable
+    Condition& operator=(const Condition&); // non-copyable
+
+    pthread_cond_t m_cond;
+  };
+
+} // close namespace
+
+#endif
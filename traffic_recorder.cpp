@@ -0,0 +1,143 @@
+/*  TrafficRecorder: Records the QAP1 frames exchanged with Rserve to a trace file.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "traffic_recorder.h"
+#include "network_writer.h"
+
+#include <sys/time.h> // for gettimeofday
+#include <stdexcept>
+
+namespace{
+
+  /** magic string at the start of a trace file
+   */
+  const char TraceMagic[] = "RCTRACE1";
+
+  /** @param[out] p buffer to hold value as a little-endian integer
+   * @param[in] value integer to write
+   * @param[in] length number of bytes to write
+   */
+  void writeLittleEndian(unsigned char *p, const uint64_t value, const size_t length){
+    for(size_t i = 0; i < length; ++i)
+      p[i] = (unsigned char) (value >> (i * 8));
+  }
+
+  /** NetworkWriter that appends everything written to a file
+   */
+  class FileWriter : public rclient::NetworkWriter{
+  public:
+    explicit FileWriter(FILE *file):NetworkWriter(65536), m_pFile(file){}
+  protected:
+    virtual void flushChunk(const unsigned char *data, const size_t length){
+      fwrite(data, 1, length, m_pFile);
+    }
+  private:
+    FILE *m_pFile;
+  };
+
+} // close namespace
+
+namespace rclient{
+
+  /** constructor creates the trace file, replacing any existing file
+   * Throws runtime_error if the file cannot be created
+   * @param[in] path path of the trace file
+   */
+  TrafficRecorder::TrafficRecorder(const RSTRINGTYPE &path):m_pFile(NULL), m_iNextConnection(1){
+    m_pFile = fopen(path.c_str(), "wb");
+    if(!m_pFile)
+      throw std::runtime_error("ERROR:: Failed to create trace file " + path + ".");
+    fwrite(TraceMagic, 1, sizeof(TraceMagic) - 1, m_pFile);
+  }
+
+  /** destructor writes any buffered records and closes the trace file
+   */
+  TrafficRecorder::~TrafficRecorder(){
+    fclose(m_pFile);
+  }
+
+
+  /** @return id to record a new connection under
+   */
+  uint32_t TrafficRecorder::nextConnection(){
+    ScopedLock lock(m_mutex);
+    return m_iNextConnection++;
+  }
+
+  /** Records a frame that is held in memory
+   * @param[in] connection id returned by nextConnection
+   * @param[in] kind kind of frame
+   * @param[in] header start of the frame, e.g. the QAP1 header
+   * @param[in] headerLength number of bytes in header
+   * @param[in] data rest of the frame, e.g. the data section. May be NULL if dataLength is 0
+   * @param[in] dataLength number of bytes in data
+   */
+  void TrafficRecorder::record(const uint32_t connection, const eKind kind, const unsigned char *header, const size_t headerLength,
+                               const unsigned char *data, const size_t dataLength){
+    ScopedLock lock(m_mutex);
+    write_record_header(connection, kind, headerLength + dataLength);
+    fwrite(header, 1, headerLength, m_pFile);
+    if(dataLength > 0)
+      fwrite(data, 1, dataLength, m_pFile);
+  }
+
+  /** Records a request, serializing streaming entries again
+   * @param[in] connection id returned by nextConnection
+   * @param[in] networkHeader QAP1 header of the request, as sent
+   * @param[in] request request whose entries follow the header
+   */
+  void TrafficRecorder::record(const uint32_t connection, const RVECTORTYPE<uint8_t> &networkHeader, const RPacket &request){
+    RSHARED_PTR<const RVECTORTYPE<RPacket::PacketEntry> > entries = request.getEntries();
+    uint64_t length = networkHeader.size();
+    for(size_t i = 0; i < entries->size(); ++i)
+      length += (*entries)[i].getLength();
+
+    ScopedLock lock(m_mutex);
+    write_record_header(connection, TR_REQUEST, length);
+    FileWriter writer(m_pFile);
+    writer.write(&networkHeader[0], networkHeader.size());
+    for(size_t i = 0; i < entries->size(); ++i)
+      (*entries)[i].writeTo(writer);
+    writer.flush();
+  }
+
+  /** Writes buffered records to the trace file
+   * Throws runtime_error if writing to the trace file failed since it was created
+   */
+  void TrafficRecorder::flush(){
+    ScopedLock lock(m_mutex);
+    if(fflush(m_pFile) != 0 || ferror(m_pFile))
+      throw std::runtime_error("ERROR:: Failed to write trace file.");
+  }
+
+
+  /** Writes the header of a record, timestamped with the current time
+   * @param[in] connection id returned by nextConnection
+   * @param[in] kind kind of frame
+   * @param[in] length number of bytes in the frame
+   */
+  void TrafficRecorder::write_record_header(const uint32_t connection, const eKind kind, const uint64_t length){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    unsigned char header[24];
+    writeLittleEndian(&header[0], kind, 4);
+    writeLittleEndian(&header[4], connection, 4);
+    writeLittleEndian(&header[8], (uint64_t) now.tv_sec * 1000000 + now.tv_usec, 8);
+    writeLittleEndian(&header[16], length, 8);
+    fwrite(header, 1, sizeof(header), m_pFile);
+  }
+
+} // close namespace
@@ -0,0 +1,73 @@
+/*  TrafficRecorder: Records the QAP1 frames exchanged with Rserve to a trace file.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_TRAFFIC_RECORDER_H_INCLUDED
+#define RCLIENT_TRAFFIC_RECORDER_H_INCLUDED
+
+#include "config.h"
+#include "rpacket.h"
+#include "thread_sync.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+namespace rclient{
+
+  /** Appends the frames exchanged with Rserve to a binary trace file, to be replayed with TrafficTrace.
+   * Set ConnectionOptions::recorder to record a connection. One recorder may be shared by any number of
+   * connections and threads; each connection is recorded under its own id.
+   *
+   * The file starts with the 8 byte magic "RCTRACE1", followed by one record per frame. Each record has a 24 byte header:
+   *  - 1 byte:  eKind
+   *  - 3 bytes: reserved, 0
+   *  - 4 bytes: connection id
+   *  - 8 bytes: microseconds since the epoch when the frame was sent or received
+   *  - 8 bytes: length of the frame
+   * followed by the frame itself: the ID string for TR_HELLO, otherwise the QAP1 header and data section.
+   * Integers are little-endian.
+   */
+  class RCLIENT_API TrafficRecorder{
+
+  public:
+    enum eKind {
+      TR_HELLO = 1,    // ID string sent by Rserve on connect
+      TR_REQUEST = 2,  // request sent to Rserve
+      TR_RESPONSE = 3  // response received from Rserve
+    };
+
+    explicit TrafficRecorder(const RSTRINGTYPE &path);
+    ~TrafficRecorder();
+
+    uint32_t nextConnection();
+    void record(const uint32_t connection, const eKind kind, const unsigned char *header, const size_t headerLength,
+                const unsigned char *data, const size_t dataLength);
+    void record(const uint32_t connection, const RVECTORTYPE<uint8_t> &networkHeader, const RPacket &request);
+    void flush();
+
+  private:
+    TrafficRecorder(const TrafficRecorder &no_copy); // non construction-copyable
+    TrafficRecorder& operator=(const TrafficRecorder&); // non-copyable
+
+    void write_record_header(const uint32_t connection, const eKind kind, const uint64_t length);
+
+    FILE *m_pFile; // trace file
+    Mutex m_mutex; // guards m_pFile and m_iNextConnection
+    uint32_t m_iNextConnection; // id of the next connection to be recorded
+  };
+
+} // close namespace
+
+#endif
@@ -0,0 +1,166 @@
+/*  TrafficTrace: Trace file written by TrafficRecorder, loaded for replay.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "traffic_trace.h"
+#include "qap1_header.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm> // for std::find
+#include <stdexcept>
+
+namespace{
+
+  /** magic string at the start of a trace file
+   */
+  const char TraceMagic[] = "RCTRACE1";
+
+  /** size of the QAP1 header at the start of requests and responses
+   */
+  const size_t QAP1HeaderLength = 16;
+
+  /** @param[in] p buffer holding a little-endian integer
+   * @param[in] length number of bytes in the integer
+   * @return the integer
+   */
+  uint64_t readLittleEndian(const unsigned char *p, const size_t length){
+    uint64_t value = 0;
+    for(size_t i = 0; i < length; ++i)
+      value |= (uint64_t) p[i] << (i * 8);
+    return value;
+  }
+
+  /** Closes a FILE when it goes out of scope
+   */
+  class FileCloser{
+  public:
+    explicit FileCloser(FILE *file):m_pFile(file){}
+    ~FileCloser(){ fclose(m_pFile); }
+  private:
+    FILE *m_pFile;
+  };
+
+} // close namespace
+
+namespace rclient{
+
+  /** constructor reads the whole trace file
+   * Throws runtime_error if the file cannot be read, is not a trace file, or ends in the middle of a record
+   * @param[in] path path of the trace file
+   */
+  TrafficTrace::TrafficTrace(const RSTRINGTYPE &path){
+    FILE *file = fopen(path.c_str(), "rb");
+    if(!file)
+      throw std::runtime_error("ERROR:: Failed to open trace file " + path + ".");
+    FileCloser closer(file);
+
+    // frame lengths are checked against what is left of the file, so a corrupt length cannot cause a huge allocation
+    long fileSize = -1;
+    if(fseek(file, 0, SEEK_END) == 0)
+      fileSize = ftell(file);
+    if(fileSize < 0 || fseek(file, 0, SEEK_SET) != 0)
+      throw std::runtime_error("ERROR:: Failed to read trace file " + path + ".");
+
+    char magic[sizeof(TraceMagic) - 1];
+    if(fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, TraceMagic, sizeof(magic)) != 0)
+      throw std::runtime_error("ERROR:: " + path + " is not a trace file.");
+    uint64_t remaining = (uint64_t) fileSize - sizeof(magic);
+
+    unsigned char header[24];
+    while(remaining > 0){
+      if(remaining < sizeof(header) || fread(header, 1, sizeof(header), file) != sizeof(header))
+        throw std::runtime_error("ERROR:: Trace file " + path + " is truncated or corrupt.");
+      remaining -= sizeof(header);
+
+      Record record;
+      record.kind = (TrafficRecorder::eKind) header[0];
+      record.connection = (uint32_t) readLittleEndian(&header[4], 4);
+      record.time = readLittleEndian(&header[8], 8);
+      const uint64_t length = readLittleEndian(&header[16], 8);
+      if(length > remaining)
+        throw std::runtime_error("ERROR:: Trace file " + path + " is truncated or corrupt.");
+      RSHARED_PTR<RVECTORTYPE<unsigned char> > frame = RMAKE_SHARED<RVECTORTYPE<unsigned char> >((size_t) length);
+      if(!frame->empty() && fread(&(*frame)[0], 1, frame->size(), file) != frame->size())
+        throw std::runtime_error("ERROR:: Failed to read trace file " + path + ".");
+      remaining -= length;
+      record.frame = frame;
+      m_vecRecords.push_back(record);
+    }
+  }
+
+  /** destructor
+   */
+  TrafficTrace::~TrafficTrace(){}
+
+
+  /** @return every record, in the order they were written
+   */
+  const RVECTORTYPE<TrafficTrace::Record>& TrafficTrace::getRecords() const{
+    return m_vecRecords;
+  }
+
+  /** @return ids of the recorded connections, in the order they were first recorded
+   */
+  RVECTORTYPE<uint32_t> TrafficTrace::getConnections() const{
+    RVECTORTYPE<uint32_t> connections;
+    for(size_t i = 0; i < m_vecRecords.size(); ++i)
+      if(std::find(connections.begin(), connections.end(), m_vecRecords[i].connection) == connections.end())
+        connections.push_back(m_vecRecords[i].connection);
+    return connections;
+  }
+
+  /** @param[in] connection connection id, see getConnections
+   * @param[in] kind kind of frame
+   * @return records of the connection that are of the given kind, in the order they were written
+   */
+  RVECTORTYPE<TrafficTrace::Record> TrafficTrace::getRecords(const uint32_t connection, const TrafficRecorder::eKind kind) const{
+    RVECTORTYPE<Record> records;
+    for(size_t i = 0; i < m_vecRecords.size(); ++i)
+      if(m_vecRecords[i].connection == connection && m_vecRecords[i].kind == kind)
+        records.push_back(m_vecRecords[i]);
+    return records;
+  }
+
+
+  /** Frames a recorded request or response into an RPacket, as NetworkManager does for a received response
+   * Throws runtime_error if the frame is malformed
+   * @param[in] record TR_REQUEST or TR_RESPONSE record
+   * @return packet whose entries are views into a copy of the frame's data section
+   */
+  RSHARED_PTR<const RPacket> TrafficTrace::toPacket(const Record &record){
+    const RVECTORTYPE<unsigned char> &frame = *record.frame;
+    if(record.kind == TrafficRecorder::TR_HELLO || frame.size() < QAP1HeaderLength)
+      throw std::runtime_error("ERROR:: Trace record is not a QAP1 frame.");
+
+    QAP1Header header(RVECTORTYPE<uint8_t>(frame.begin(), frame.begin() + QAP1HeaderLength));
+    RSHARED_PTR<RVECTORTYPE<unsigned char> > body = RMAKE_SHARED<RVECTORTYPE<unsigned char> >(frame.begin() + QAP1HeaderLength, frame.end());
+    const RSHARED_PTR<const unsigned char> data(body, body->empty() ? NULL : &(*body)[0]);
+    RSHARED_PTR<RVECTORTYPE<RPacket::PacketEntry> > entries = RMAKE_SHARED<RVECTORTYPE<RPacket::PacketEntry> >();
+    size_t pos = 0;
+    while(pos < body->size()){
+      const size_t header_length = ((*body)[pos] & RPacket::PacketEntry::DT_LARGE ? 8 : 4);
+      if(body->size() - pos < header_length)
+        throw std::runtime_error("ERROR:: Malformed entry in trace record.");
+      const uint64_t data_length = readLittleEndian(&(*body)[pos + 1], header_length - 1);
+      if(body->size() - pos - header_length < data_length)
+        throw std::runtime_error("ERROR:: Malformed entry in trace record.");
+      entries->push_back(RPacket::PacketEntry(data, pos, header_length + data_length));
+      pos += header_length + data_length;
+    }
+    return RMAKE_SHARED<RPacket>(header, data, entries);
+  }
+
+} // close namespace
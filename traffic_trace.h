@@ -0,0 +1,58 @@
+/*  TrafficTrace: Trace file written by TrafficRecorder, loaded for replay.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_TRAFFIC_TRACE_H_INCLUDED
+#define RCLIENT_TRAFFIC_TRACE_H_INCLUDED
+
+#include "config.h"
+#include "rpacket.h"
+#include "traffic_recorder.h"
+
+#include <inttypes.h>
+
+namespace rclient{
+
+  /** Loads a trace file written by TrafficRecorder into memory, so that its frames can be replayed:
+   * responses can be decoded again with toPacket, or served to clients with MockRserve::replay.
+   */
+  class RCLIENT_API TrafficTrace{
+
+  public:
+    /** one recorded frame
+     */
+    struct Record{
+      TrafficRecorder::eKind kind;
+      uint32_t connection; // connection id the frame was recorded under
+      uint64_t time; // microseconds since the epoch
+      RSHARED_PTR<const RVECTORTYPE<unsigned char> > frame; // frame as it was sent or received
+    };
+
+    explicit TrafficTrace(const RSTRINGTYPE &path);
+    ~TrafficTrace();
+
+    const RVECTORTYPE<Record>& getRecords() const;
+    RVECTORTYPE<uint32_t> getConnections() const;
+    RVECTORTYPE<Record> getRecords(const uint32_t connection, const TrafficRecorder::eKind kind) const;
+
+    static RSHARED_PTR<const RPacket> toPacket(const Record &record);
+
+  private:
+    RVECTORTYPE<Record> m_vecRecords; // every record, in the order they were written
+  };
+
+} // close namespace
+
+#endif
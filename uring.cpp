@@ -0,0 +1,403 @@
+/*  URing: Minimal io_uring submission and completion queue, used by the Reactor.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "uring.h"
+
+#include <string.h>
+#include <errno.h>
+#include <algorithm> // for std::max
+
+// io_uring is only available on Linux, and only used if the system headers know its system calls
+#if defined(__linux__) && !defined(RCLIENT_NO_IO_URING)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define RCLIENT_USE_IO_URING
+#endif
+#endif
+
+#ifdef RCLIENT_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace{
+
+  /** Checks that the kernel supports every operation URing prepares
+   * @param[in] fd io_uring instance
+   * @return False if an operation is missing, or the kernel is too old to tell
+   */
+  bool supportsOperations(const int fd){
+    const unsigned max_ops = 256;
+    RVECTORTYPE<unsigned char> buf(sizeof(struct io_uring_probe) + max_ops * sizeof(struct io_uring_probe_op));
+    struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe*>(&buf[0]);
+    if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, max_ops) != 0)
+      return false;
+
+    const unsigned required[] = {IORING_OP_SEND, IORING_OP_RECV, IORING_OP_READ_FIXED, IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL};
+    for(size_t i = 0; i < sizeof(required) / sizeof(required[0]); ++i){
+      if(required[i] > probe->last_op || !(probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED))
+        return false;
+    }
+    return true;
+  }
+
+} // close namespace
+#endif
+
+namespace rclient{
+
+  /** constructor. The ring is not usable until open succeeds
+   */
+  URing::URing():m_iFd(-1), m_pSqRing(NULL), m_iSqRingLength(0), m_pCqRing(NULL), m_iCqRingLength(0), m_pEntries(NULL), m_iEntriesLength(0),
+    m_pSqHead(NULL), m_pSqTail(NULL), m_pSqArray(NULL), m_iSqMask(0), m_iSqEntries(0), m_iSqTail(0),
+    m_pCqHead(NULL), m_pCqTail(NULL), m_pCompletions(NULL), m_iCqMask(0), m_iBufferSlots(0){
+    m_aTimeout[0] = m_aTimeout[1] = 0;
+  }
+
+  /** destructor closes the ring, which cancels any operation still in flight
+   */
+  URing::~URing(){
+    close();
+  }
+
+
+  /** Creates the io_uring instance and maps its queues
+   * @param[in] entries size of the submission queue. The kernel rounds it up to a power of 2
+   * @param[in] bufferSlots number of buffers that may be registered with registerBuffer. Registration is skipped if unsupported
+   * @return False if io_uring or one of the operations URing uses is not available
+   */
+  bool URing::open(const unsigned entries, const unsigned bufferSlots){
+#ifdef RCLIENT_USE_IO_URING
+    close();
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(fd < 0)
+      return false;
+    m_iFd = fd;
+
+    // completions must never be dropped, even when more operations are in flight than the completion queue holds
+    if(!(params.features & IORING_FEAT_NODROP) || !supportsOperations(fd)){
+      close();
+      return false;
+    }
+
+    m_iSqRingLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_iCqRingLength = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+      m_iSqRingLength = m_iCqRingLength = std::max(m_iSqRingLength, m_iCqRingLength);
+
+    void *sq_ring = mmap(NULL, m_iSqRingLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(sq_ring == MAP_FAILED){
+      close();
+      return false;
+    }
+    m_pSqRing = sq_ring;
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP){
+      m_pCqRing = m_pSqRing;
+    }
+    else{
+      void *cq_ring = mmap(NULL, m_iCqRingLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if(cq_ring == MAP_FAILED){
+        close();
+        return false;
+      }
+      m_pCqRing = cq_ring;
+    }
+
+    m_iEntriesLength = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, m_iEntriesLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED){
+      close();
+      return false;
+    }
+    m_pEntries = sqes;
+
+    unsigned char *sq = static_cast<unsigned char*>(m_pSqRing);
+    m_pSqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_pSqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_pSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_iSqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_iSqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    m_iSqTail = *m_pSqTail;
+
+    unsigned char *cq = static_cast<unsigned char*>(m_pCqRing);
+    m_pCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_pCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_pCompletions = cq + params.cq_off.cqes;
+    m_iCqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+    // registered buffers are optional, receives into other buffers are mapped by the kernel on every call
+    m_iBufferSlots = 0;
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    if(bufferSlots > 0){
+      struct io_uring_rsrc_register reg;
+      memset(&reg, 0, sizeof(reg));
+      reg.nr = bufferSlots;
+      reg.flags = IORING_RSRC_REGISTER_SPARSE;
+      if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0)
+        m_iBufferSlots = bufferSlots;
+    }
+#endif
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /** Closes the ring. The kernel cancels operations still in flight
+   */
+  void URing::close(){
+#ifdef RCLIENT_USE_IO_URING
+    if(m_pEntries)
+      munmap(m_pEntries, m_iEntriesLength);
+    if(m_pCqRing && m_pCqRing != m_pSqRing)
+      munmap(m_pCqRing, m_iCqRingLength);
+    if(m_pSqRing)
+      munmap(m_pSqRing, m_iSqRingLength);
+    if(m_iFd >= 0)
+      ::close(m_iFd);
+#endif
+    m_iFd = -1;
+    m_pSqRing = m_pCqRing = m_pEntries = NULL;
+    m_iBufferSlots = 0;
+  }
+
+  /** @return True if open succeeded and the ring has not been closed
+   */
+  bool URing::isOpen() const{
+    return m_iFd >= 0;
+  }
+
+
+  /** Registers a buffer in a slot, so receives into it skip mapping it on every call. Replaces any buffer already in the slot.
+   * @param[in] slot slot to register the buffer in, less than the bufferSlots passed to open
+   * @param[in] data buffer to register. Must stay allocated until the ring is closed or the slot is replaced
+   * @param[in] length size of data
+   * @return False if the buffer could not be registered, in which case prepareReceive must not use the slot
+   */
+  bool URing::registerBuffer(const unsigned slot, void *data, const size_t length){
+#if defined(RCLIENT_USE_IO_URING) && defined(IORING_RSRC_REGISTER_SPARSE)
+    if(m_iFd < 0 || slot >= m_iBufferSlots)
+      return false;
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = length;
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.data = (uintptr_t) &iov;
+    update.nr = 1;
+    return syscall(__NR_io_uring_register, m_iFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) == 1;
+#else
+    return false;
+#endif
+  }
+
+
+  /** Makes room for count entries in the submission queue, submitting the prepared entries first if there is not enough.
+   * Call it before preparing linked operations, so that the chain is not split by the submission next_entry makes when the
+   * queue fills up
+   * @param[in] count number of entries about to be prepared
+   * @return False if the queue does not have room for count entries
+   */
+  bool URing::reserve(const unsigned count){
+#ifdef RCLIENT_USE_IO_URING
+    if(m_iFd < 0 || count > m_iSqEntries)
+      return false;
+    if(m_iSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) + count > m_iSqEntries){
+      if(submit(0) < 0)
+        return false;
+    }
+    return m_iSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) + count <= m_iSqEntries;
+#else
+    return false;
+#endif
+  }
+
+  /** Prepares a send on a socket, without raising SIGPIPE. Short sends are retried by the kernel.
+   * @param[in] fd socket to send on
+   * @param[in] data data to send. Must stay valid until the send completes
+   * @param[in] length number of bytes in data
+   * @param[in] userData identifies the completion
+   * @param[in] linkNext if set, the next operation prepared starts only once this send has succeeded. Call reserve first, so
+   * that there is room for the next operation as well
+   * @return False if the submission queue is full
+   */
+  bool URing::prepareSend(const int fd, const void *data, const size_t length, const uint64_t userData, const bool linkNext){
+#ifdef RCLIENT_USE_IO_URING
+    struct io_uring_sqe *entry = static_cast<struct io_uring_sqe*>(next_entry());
+    if(!entry)
+      return false;
+    entry->opcode = IORING_OP_SEND;
+    entry->fd = fd;
+    entry->addr = (uintptr_t) data;
+    entry->len = length;
+    entry->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    entry->flags = (linkNext ? IOSQE_IO_LINK : 0);
+    entry->user_data = userData;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /** Prepares a receive of whatever data is available on a socket, waiting for at least one byte
+   * @param[in] fd socket to receive from
+   * @param[out] data buffer to receive into. Must stay valid until the receive completes
+   * @param[in] length size of data
+   * @param[in] bufferSlot slot data was registered in with registerBuffer, -1 if it is not registered
+   * @param[in] userData identifies the completion
+   * @return False if the submission queue is full
+   */
+  bool URing::prepareReceive(const int fd, void *data, const size_t length, const int bufferSlot, const uint64_t userData){
+#ifdef RCLIENT_USE_IO_URING
+    struct io_uring_sqe *entry = static_cast<struct io_uring_sqe*>(next_entry());
+    if(!entry)
+      return false;
+    if(bufferSlot >= 0 && (unsigned) bufferSlot < m_iBufferSlots){
+      entry->opcode = IORING_OP_READ_FIXED;
+      entry->buf_index = bufferSlot;
+    }
+    else{
+      entry->opcode = IORING_OP_RECV;
+    }
+    entry->fd = fd;
+    entry->addr = (uintptr_t) data;
+    entry->len = length;
+    entry->user_data = userData;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /** Prepares a timeout that completes once another operation completes, or when the time is up
+   * @param[in] timeout_ms longest time to wait in milliseconds
+   * @param[in] userData identifies the completion
+   * @return False if the submission queue is full
+   */
+  bool URing::prepareTimeout(const long timeout_ms, const uint64_t userData){
+#ifdef RCLIENT_USE_IO_URING
+    struct io_uring_sqe *entry = static_cast<struct io_uring_sqe*>(next_entry());
+    if(!entry)
+      return false;
+    // same layout as __kernel_timespec
+    m_aTimeout[0] = timeout_ms / 1000;
+    m_aTimeout[1] = (timeout_ms % 1000) * 1000000;
+    entry->opcode = IORING_OP_TIMEOUT;
+    entry->fd = -1;
+    entry->addr = (uintptr_t) m_aTimeout;
+    entry->len = 1;
+    entry->off = 1; // number of completions to wait for
+    entry->user_data = userData;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /** Prepares the cancellation of an operation in flight. The operation completes with -ECANCELED, unless it already completed
+   * @param[in] target userData of the operation to cancel
+   * @param[in] userData identifies the completion of the cancellation itself
+   * @return False if the submission queue is full
+   */
+  bool URing::prepareCancel(const uint64_t target, const uint64_t userData){
+#ifdef RCLIENT_USE_IO_URING
+    struct io_uring_sqe *entry = static_cast<struct io_uring_sqe*>(next_entry());
+    if(!entry)
+      return false;
+    entry->opcode = IORING_OP_ASYNC_CANCEL;
+    entry->fd = -1;
+    entry->addr = target;
+    entry->user_data = userData;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  /** Submits every prepared operation with a single system call, optionally waiting for completions
+   * @param[in] waitFor number of completions to wait for, 0 to return immediately
+   * @return number of operations submitted, or a negative errno (e.g. -EINTR if interrupted while waiting)
+   */
+  int URing::submit(const unsigned waitFor){
+#ifdef RCLIENT_USE_IO_URING
+    if(m_iFd < 0)
+      return -EBADF;
+    // publish the prepared entries before the kernel reads them
+    __atomic_store_n(m_pSqTail, m_iSqTail, __ATOMIC_RELEASE);
+    unsigned pending = m_iSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+    if(pending == 0 && waitFor == 0)
+      return 0;
+    int ret = syscall(__NR_io_uring_enter, m_iFd, pending, waitFor, (waitFor > 0 ? IORING_ENTER_GETEVENTS : 0), NULL, 0);
+    return (ret < 0 ? -errno : ret);
+#else
+    return -ENOSYS;
+#endif
+  }
+
+  /** Takes the next completion off the completion queue
+   * @param[out] userData userData of the operation that completed
+   * @param[out] result result of the operation: a byte count, or a negative errno
+   * @return False if no operation has completed
+   */
+  bool URing::nextCompletion(uint64_t &userData, int &result){
+#ifdef RCLIENT_USE_IO_URING
+    if(m_iFd < 0)
+      return false;
+    unsigned head = *m_pCqHead;
+    if(head == __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE))
+      return false;
+    const struct io_uring_cqe *completion = static_cast<const struct io_uring_cqe*>(m_pCompletions) + (head & m_iCqMask);
+    userData = completion->user_data;
+    result = completion->res;
+    // hand the slot back to the kernel
+    __atomic_store_n(m_pCqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  /** Returns a cleared submission queue entry, submitting the prepared entries first if the queue is full
+   * @return pointer to an io_uring_sqe, or NULL if the queue is still full
+   */
+  void* URing::next_entry(){
+#ifdef RCLIENT_USE_IO_URING
+    if(m_iFd < 0)
+      return NULL;
+    if(m_iSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) >= m_iSqEntries){
+      if(submit(0) < 0 || m_iSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) >= m_iSqEntries)
+        return NULL;
+    }
+    unsigned index = m_iSqTail & m_iSqMask;
+    struct io_uring_sqe *entry = static_cast<struct io_uring_sqe*>(m_pEntries) + index;
+    memset(entry, 0, sizeof(*entry));
+    m_pSqArray[index] = index;
+    ++m_iSqTail;
+    return entry;
+#else
+    return NULL;
+#endif
+  }
+
+} // close namespace
@@ -0,0 +1,85 @@
+/*  URing: Minimal io_uring submission and completion queue, used by the Reactor.
+ *  Copyright 2014 FactSet Research Systems Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RCLIENT_URING_H_INCLUDED
+#define RCLIENT_URING_H_INCLUDED
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace rclient{
+
+  /** Wraps a Linux io_uring instance through its system calls, without liburing.
+   * Operations are prepared in the submission queue, then submitted together by one call to submit,
+   * which can also wait for their completions.
+   * open() fails if io_uring is unavailable (other systems, older kernels, or disabled by the system), so callers can fall back
+   * to readiness-based I/O. Define RCLIENT_NO_IO_URING to leave io_uring out of the build.
+   */
+  class RCLIENT_API URing{
+
+  public:
+    URing();
+    ~URing();
+
+    bool open(const unsigned entries, const unsigned bufferSlots);
+    void close();
+    bool isOpen() const;
+
+    bool registerBuffer(const unsigned slot, void *data, const size_t length);
+
+    bool reserve(const unsigned count);
+    bool prepareSend(const int fd, const void *data, const size_t length, const uint64_t userData, const bool linkNext);
+    bool prepareReceive(const int fd, void *data, const size_t length, const int bufferSlot, const uint64_t userData);
+    bool prepareTimeout(const long timeout_ms, const uint64_t userData);
+    bool prepareCancel(const uint64_t target, const uint64_t userData);
+
+    int submit(const unsigned waitFor);
+    bool nextCompletion(uint64_t &userData, int &result);
+
+  private:
+    URing(const URing &no_copy); // non construction-copyable
+    URing& operator=(const URing&); // non-copyable
+
+    void* next_entry();
+
+    int m_iFd; // io_uring instance, -1 when not open
+    void *m_pSqRing; // mapped submission queue ring
+    size_t m_iSqRingLength;
+    void *m_pCqRing; // mapped completion queue ring, may be the same mapping as m_pSqRing
+    size_t m_iCqRingLength;
+    void *m_pEntries; // mapped submission queue entries
+    size_t m_iEntriesLength;
+
+    unsigned *m_pSqHead; // advanced by the kernel as it consumes entries
+    unsigned *m_pSqTail;
+    unsigned *m_pSqArray;
+    unsigned m_iSqMask;
+    unsigned m_iSqEntries;
+    unsigned m_iSqTail; // tail including entries prepared since the last submit
+    unsigned *m_pCqHead;
+    unsigned *m_pCqTail; // advanced by the kernel as operations complete
+    void *m_pCompletions;
+    unsigned m_iCqMask;
+
+    unsigned m_iBufferSlots; // number of registered buffer slots, 0 if buffers cannot be registered
+    long long m_aTimeout[2]; // seconds and nanoseconds of the last timeout prepared
+  };
+
+} // close namespace
+
+#endif